@@ -12,13 +12,49 @@ void initBluetooth();
 // Connection management
 void connectBluetooth();
 void resetPairing();
+void restartBluetooth();
+void abortBtCall();           // Supervisor task
+
+// Apply SPP open/close events to the connection state (call from loop)
+void serviceBtEvents();
+
+// SPP transport in use (BluetoothSerial, or raw esp_spp with -DBT_RAW_SPP) and
+// the heap the BT stack and transport took when started
+const char* btTransportName();
+long btStackHeapBytes();
 
 // Callbacks for ESP-IDF
 void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param);
 void btCallback(esp_spp_cb_event_t event, esp_spp_cb_param_t *param);
 
-// Command interface
-bool sendCommand(const String& cmd);
+// Outcome of sendCommand(); SEND_FAILED is 0, so the result tests like a bool
+enum SendResult : uint8_t {
+    SEND_FAILED = 0,
+    SEND_WRITTEN,
+    SEND_HELD                 // Link congested, serviceBtTx() writes it later
+};
+
+// Command interface; while the SPP link is congested frames are held (up to
+// BT_TX_QUEUE_FRAMES). A held frame's tag is passed to reportCommandSent()
+// once the frame is written, or as failed if the link drops first.
+SendResult sendCommand(const char* cmd, uint16_t tag = 0);
 YasStatus requestStatus();
 
+// SPP transmit path
+struct BtTxStats {
+    uint32_t congestions;     // ESP_SPP_CONG_EVT with cong set
+    uint32_t congestedMs;
+    uint32_t maxCongestedMs;
+    uint32_t held;            // Frames held back while congested
+    uint32_t released;
+    uint32_t dropped;         // TX queue full, or link lost with frames held
+    uint32_t maxDepth;
+};
+
+void serviceBtTx();           // Release held frames (call from loop)
+bool btTxReady();             // Not congested and nothing held
+size_t btTxDepth();
+bool btTxCongested();
+BtTxStats btTxStats();
+
 #endif
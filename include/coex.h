@@ -0,0 +1,60 @@
+#ifndef COEX_H
+#define COEX_H
+
+#include <Arduino.h>
+
+// WiFi / Bluetooth coexistence preference
+//
+// WiFi and BT Classic share one radio, and the coexistence arbiter decides who
+// gets it when both want it. By default the preference follows the traffic:
+// BT is favoured while commands are queued or being sent (including volume
+// ramps) and for COEX_BT_HOLD_MS after, WiFi during bulk MQTT publishing
+// (discovery), balanced otherwise. It can also be pinned to one mode with
+// /debug?coex= to compare them.
+//
+// BT status round trips and HTTP response times are accounted to the mode
+// that was active when they finished, so the cost of each mode can be read
+// from /debug or /metrics.
+
+enum CoexMode : uint8_t {
+    COEX_BALANCED,
+    COEX_PREFER_BT,
+    COEX_PREFER_WIFI,
+    COEX_MODE_COUNT
+};
+
+struct CoexModeStats {
+    uint32_t activeMs;        // Time spent in this mode
+    uint32_t entered;         // Switches into this mode
+    uint32_t btRttCount;
+    uint32_t btRttSumMs;
+    uint32_t btRttMaxMs;
+    uint32_t httpCount;
+    uint64_t httpSumUs;
+    uint32_t httpMaxUs;
+};
+
+// Apply the balanced preference (setup, after WiFi and BT are up)
+void initCoex();
+
+// Follow the command queue (call from loop)
+void serviceCoex();
+
+// Activity hints (loop task)
+void coexBtActivity();        // A command frame went out
+void coexWifiBurst();         // About to publish a lot at once
+
+// Measurements, accounted to the current mode (any task)
+void coexObserveBtRtt(uint32_t ms);
+void coexObserveHttp(uint32_t us);
+
+// Pin a mode, or return to following the traffic with automatic = true
+void setCoexMode(CoexMode mode, bool automatic);
+bool parseCoexMode(const String& name, CoexMode& mode, bool& automatic);
+
+CoexMode coexMode();
+bool coexAutomatic();
+const char* coexModeName(CoexMode mode);
+CoexModeStats coexModeStats(CoexMode mode);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef COMMAND_BATCH_H
+#define COMMAND_BATCH_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include <vector>
+
+// One command in a batch and when it actually went out
+struct BatchCommand {
+    String command;
+    unsigned long delayAfterMs = 0;   // Extra hold after this command, on top of the pacing
+    bool sent = false;
+    bool ok = false;                  // Full frame written to the link
+    unsigned long sentAt = 0;         // millis() when written
+};
+
+// Ordered command list sent back-to-back at a fixed pace
+struct CommandBatch {
+    uint16_t id = 0;
+    std::vector<BatchCommand> commands;
+    unsigned long paceMs = 0;         // Gap between frames
+    bool readStatus = false;          // Read status once after the last command
+    unsigned long startedAt = 0;
+    unsigned long finishedAt = 0;
+};
+
+// Parse {"commands":[...], "pace_ms":N, "status":bool}
+// Entries are a command name or {"command":name, "delay_ms":N}. Every name is
+// checked against COMMANDS before anything is sent.
+bool parseCommandBatch(JsonVariantConst json, CommandBatch& batch, String& error);
+
+// Called when a batch finishes; on success with readStatus lastSoundbarStatus holds the result
+typedef std::function<void(bool ok, const CommandBatch& batch)> BatchDoneCallback;
+
+// Queue a parsed batch at user priority, returns false if it can't be queued whole
+bool startCommandBatch(const CommandBatch& batch, BatchDoneCallback done, String& error);
+
+// Complete finished batches (call from loop)
+void serviceCommandBatches();
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+#include "yas_commands.h"
+#include "trace.h"
+
+// Priority classes, lower value is sent first
+enum CommandPriority : uint8_t {
+    PRIO_USER = 0,      // Interactive user command
+    PRIO_VOLUME,        // Volume/subwoofer stepping
+    PRIO_CONFIRM,       // State confirmation after a change
+    PRIO_POLL,          // Background status poll
+    PRIO_COUNT
+};
+
+// Command queue statistics
+struct CommandQueueStats {
+    unsigned long framesSent = 0;
+    unsigned long statusReads = 0;
+    unsigned long deduplicated = 0;
+    unsigned long preemptions = 0;
+    unsigned long dropped = 0;
+    unsigned long maxDepth = 0;
+    unsigned long statusReadAllocs = 0;   // Allocations during status reads (heaptrace env only)
+};
+
+extern CommandQueueStats cmdQueueStats;
+
+// Tags from CMD_TAG_INTERNAL up mark the bridge's own command groups, so one can
+// be cleared without touching others queued at the same priority. Lower non-zero
+// tags are batch ids and go to the sent handler.
+enum CommandTag : uint16_t {
+    CMD_TAG_NONE = 0,
+    CMD_TAG_INTERNAL = 0xFF00,
+    CMD_TAG_VOLUME = CMD_TAG_INTERNAL,    // Volume staircase
+    CMD_TAG_SUBWOOFER,                    // Subwoofer staircase
+    CMD_TAG_PLANNER,                      // Steps of the target state job
+};
+
+// Queue a command, delayAfterMs holds back the next frame (e.g. after power_on)
+// A batch id as tag reports the command to the sent handler when it goes out.
+bool queueCommand(const String& cmd, CommandPriority prio, unsigned long delayAfterMs = 0, uint16_t tag = 0);
+
+// Called once a tagged command was written to the link, or failed to be
+typedef void (*CommandSentHandler)(uint16_t tag, bool ok, unsigned long sentAt);
+void setCommandSentHandler(CommandSentHandler handler);
+
+// Pass a command's outcome to the sent handler if its tag is a batch id; the
+// BT layer calls this for frames it held and wrote (or dropped) later
+void reportCommandSent(uint16_t tag, bool ok, unsigned long sentAt);
+
+// Queue a status read, identical queued reads are merged at the highest priority.
+// The current trace waits for the read, which finishes it; with all
+// CMD_STATUS_TRACE_SLOTS taken the read is not traced.
+void queueStatusRequest(CommandPriority prio);
+
+// As above for work that finishes its own trace (the planner): the read is
+// recorded on trace and leaves it open
+void queueStatusRequest(CommandPriority prio, TraceId trace);
+
+// Drop queued commands of one priority class
+void clearQueuedCommands(CommandPriority prio);
+
+// Drop only the commands with one tag (e.g. a superseded volume staircase)
+void clearQueuedCommands(CommandPriority prio, uint16_t tag);
+
+// Drop everything (link lost)
+void clearCommandQueue();
+
+// Send at most one frame if the inter-frame gap has elapsed (call from loop)
+void processCommandQueue();
+
+// True when nothing at or above the given priority is waiting
+bool commandQueueIdle(CommandPriority upTo);
+
+// Read status immediately, ahead of anything queued, respecting the frame gap
+YasStatus queryStatusNow();
+
+// Number of queued frames (status read counts as one)
+size_t commandQueueDepth();
+
+// Free slots in one priority class
+size_t commandQueueFree(CommandPriority prio);
+
+#endif
@@ -6,6 +6,150 @@
 
 // HTTP Server Configuration
 #define HTTP_PORT 80
+#define HTTP_MAX_CONNECTIONS 6            // Concurrent keep-alive connections
+#define HTTP_KEEPALIVE_TIMEOUT_MS 5000    // Close idle or stalled connections after this
+#define HTTP_RX_BUFFER_SIZE 1536          // Per-connection request buffer (headers + body)
+#define HTTP_MAX_BODY_SIZE 1024
+#define HTTP_MAX_ARGS 8
+#define HTTP_MAX_HEADERS 10
+#define HTTP_MAX_ROUTES 16
+#define HTTP_TASK_STACK_SIZE 4096
+#define HTTP_TASK_PRIORITY 2
+#define HTTP_TASK_CORE 0                  // Keep socket work off the loop() core
+#define HTTP_TASK_POLL_MS 20              // select() timeout for timeouts and pipelined requests
+#define HTTP_INLINE_BODY_BYTES 1024       // Larger bodies are sent from the handler's buffer, not copied
+
+// Log levels
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_VERBOSE 5               // Per-frame hex dumps, unknown GAP events
+
+// Highest level compiled in per module, override with -DLOG_LEVEL_<MOD>=... in build_flags
+// Runtime levels (/debug?log=bt:debug or the log_level MQTT topic) can't exceed these.
+#ifndef LOG_LEVEL_DEFAULT
+#define LOG_LEVEL_DEFAULT LOG_LEVEL_VERBOSE
+#endif
+#ifndef LOG_LEVEL_SYS
+#define LOG_LEVEL_SYS LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_BT
+#define LOG_LEVEL_BT LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_MQTT
+#define LOG_LEVEL_MQTT LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_HTTP
+#define LOG_LEVEL_HTTP LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_CMD
+#define LOG_LEVEL_CMD LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_WIFI
+#define LOG_LEVEL_WIFI LOG_LEVEL_DEFAULT
+#endif
+
+// Logging - log lines go through a RAM ring drained to the UART by a low-priority task
+#define LOG_RING_SIZE 32                  // Lines buffered (power of two)
+#define LOG_MAX_ARGS 6                    // Arguments captured per line
+#define LOG_STRING_BYTES 128              // %s bytes copied per line
+#define LOG_LINE_BYTES 256                // Longest formatted line
+#define LOG_DRAIN_TASK_PRIORITY 1
+#define LOG_DRAIN_STACK_SIZE 3072
+#define LOG_DRAIN_INTERVAL_MS 10          // Drain task poll interval when idle
+#define LOG_HISTORY_BYTES 6144            // Recent lines kept for GET /logs
+#define LOG_HTTP_MAX_BYTES 4096           // Text returned per GET /logs
+
+// JSON documents and serialized payloads (loop task)
+#define JSON_ARENA_BYTES 6144             // Static arena for JsonDocument memory, heap beyond that
+#define JSON_OUTPUT_BYTES 3072            // Serialized HTTP/MQTT payloads, larger ones use a String
+
+// Prometheus metrics (/metrics) and the trace export (/debug/trace)
+#define TEXT_OUTPUT_BYTES 12288           // Static buffer both are written into
+#define METRICS_MAX_BUCKETS 14            // Histogram buckets, excluding +Inf
+
+// Heap telemetry (/debug/heap)
+#define HEAP_CHECK_INTERVAL_MS 10000      // Largest-block check and low-memory warning
+#define HEAP_SAMPLE_INTERVAL_MS (30UL * 60 * 1000)   // History sample every 30 min
+#define HEAP_HISTORY_SAMPLES 96           // 48 h of samples
+#define HEAP_LOW_BLOCK_WARN_BYTES 16384   // Warn when the largest free block drops below this
+#define HEAP_CALLER_SLOTS 64              // Call sites counted with HEAP_TRACK_CALLERS
+
+// Flight recorder (RTC slow memory, survives everything but a power cycle)
+#define FLIGHT_RECORDER_EVENTS 32         // Events kept across a reset
+#define FLIGHT_LOG_BYTES 1024             // Tail of warning/error log lines kept across a reset
+#define FLIGHT_CHECKPOINT_MS 1000         // Counter snapshot interval
+#define FLIGHT_LOOP_STALL_MS 1000         // Loop iterations this long are recorded
+#define FLIGHT_HEAP_STEP_BYTES 4096       // Record a new free-heap low every time it drops this much
+#define FLIGHT_MQTT_EVENTS 12             // Events included in the MQTT last-boot report
+
+// Power profiles (set with /debug?power=, kept in NVS)
+#define POWER_PROFILE_DEFAULT POWER_BALANCED
+#define POWER_LISTEN_INTERVAL 1           // Beacons between wakeups, latency and balanced
+#define POWER_ECO_LISTEN_INTERVAL 3       // Beacons between wakeups in eco (max modem sleep)
+#define POWER_IDLE_POLL_MS 15000          // Status poll interval while the soundbar is off and sniff allowed
+#define POWER_PROBE_INTERVAL_MS 30000     // Gateway ping measuring inbound latency
+
+// BT link policy
+#define LINK_KEEPAWAKE_MS 3000            // Read status after this long quiet while sniff is held off (0 = never)
+#define LINK_INTERACTIVE_MS 30000         // Hold sniff off this long after a user or volume command
+#define LINK_KEEPAWAKE_PROFILE 0          // 1: keep-awake reads also when only the power profile holds sniff off
+
+// BT link quality (RSSI delta to the controller's golden receive range, dB)
+#define BT_RSSI_INTERVAL_MS 10000         // Read RSSI this often while the link is idle
+#define BT_RSSI_IDLE_MS 1000              // Link quiet at least this long before a read
+#define BT_RSSI_TIMEOUT_MS 2000           // Give up on a read that got no answer
+#define BT_RSSI_AVG_SAMPLES 6             // Samples averaged for the sensor and weak link check
+#define BT_RSSI_WEAK_DELTA -8             // Weak link below this average
+#define BT_RSSI_HYSTERESIS 3              // Recovered this far above the weak threshold
+#define BT_RSSI_HISTORY 30                // Samples kept for /debug
+#define BT_LINK_EVENTS 16                 // Disconnects and round trip spikes kept for /debug
+#define BT_RTT_SPIKE_MS 500               // Status round trip logged as a spike
+
+// Idle-link keepalive (learned from disconnects, reset with /debug?keepalive=reset)
+#define KEEPALIVE_MIN_IDLE_MS 1000        // Drops after less quiet follow traffic, not an idle timeout
+#define KEEPALIVE_LEARN_SAMPLES 3         // Drops at about the same quiet time before a threshold is learned
+#define KEEPALIVE_TOLERANCE_PERCENT 20    // Spread of quiet times counted as the same timeout
+#define KEEPALIVE_LEAD_PERCENT 75         // Keepalive after this share of the threshold
+#define KEEPALIVE_MIN_INTERVAL_MS 2000    // Never more often than this
+#define KEEPALIVE_WHILE_OFF 1             // Keep the link up while the soundbar is off (power_on needs it)
+
+// WiFi/BT coexistence preference
+#define COEX_BT_HOLD_MS 2000              // Favour BT this long after the last command queued or sent
+#define COEX_WIFI_HOLD_MS 1000            // Favour WiFi this long after a bulk publish starts
+
+// Supervisor (subsystem heartbeats, soft recovery, then restart)
+#define SUPERVISOR_CHECK_MS 1000          // Check interval
+#define SUPERVISOR_LOOP_TIMEOUT_MS 30000  // loop() not coming round (outside supervised calls)
+#define SUPERVISOR_WIFI_TIMEOUT_MS 120000 // Not associated for this long
+#define SUPERVISOR_BT_SILENT_MS 60000     // Connected but no status reply for this long
+#define SUPERVISOR_BT_CALL_TIMEOUT_MS 90000   // BT call running this long (connect by name includes discovery)
+#define SUPERVISOR_MQTT_CALL_TIMEOUT_MS 30000 // PubSubClient call running this long
+#define SUPERVISOR_HTTP_TIMEOUT_MS 30000  // HTTP socket task not polling
+#define SUPERVISOR_RECOVERY_GRACE_MS 30000    // Restart if still unhealthy this long after soft recovery
+#define SUPERVISOR_TASK_STACK_SIZE 3072
+#define SUPERVISOR_TASK_PRIORITY 3        // Above loop() and the HTTP task
+#define SUPERVISOR_TASK_CORE 0
+
+// Task monitor (/debug/tasks) and MQTT diagnostics
+#define TASK_MONITOR_MAX_TASKS 32         // Tasks read per sample
+#define TASK_SAMPLE_INTERVAL_MS 10000     // CPU usage is averaged over this window
+#define MQTT_DIAGNOSTICS_INTERVAL_MS 60000   // Compact diagnostics message
+
+// Request tracing (/debug/trace)
+#define TRACE_BUFFER_EVENTS 128           // Events kept, oldest overwritten
+
+// UDP syslog - set SYSLOG_HOST (IP address) in secrets.h to enable
+#ifndef SYSLOG_HOST
+#define SYSLOG_HOST ""
+#endif
+#ifndef SYSLOG_PORT
+#define SYSLOG_PORT 514
+#endif
+#define SYSLOG_RATE_PER_SEC 20            // Sustained lines/s sent over UDP
+#define SYSLOG_BURST 40                   // Lines that may go out at once after a quiet period
 
 // Bluetooth device name (how this device appears to others)
 #define BT_DEVICE_NAME "YAS-Bridge"
@@ -13,20 +157,61 @@
 // Connection timing settings
 #define BT_RECONNECT_DELAY_MS 10000       // 10s between reconnect attempts
 #define STATUS_REQUEST_TIMEOUT_MS 3000    // 3s timeout for status responses
+#define BT_LINK_EVENT_QUEUE 8             // SPP open/close events waiting for loop()
+#define BT_LINK_CHECK_MS 1000             // Fallback SerialBT.connected() check
+#define BT_TX_QUEUE_FRAMES 8              // Frames held while the SPP link is congested
+#define BT_TX_FRAME_BYTES 32              // Largest frame that can be held
 #define WIFI_RECONNECT_DELAY_MS 5000      // 5s between WiFi reconnect attempts
 #define MQTT_RECONNECT_DELAY_MS 5000      // 5s between MQTT reconnect attempts
 
+// Raw esp_spp transport (-DBT_RAW_SPP)
+#define BT_RAW_FRAME_BYTES 64             // Largest received frame
+#define BT_RAW_RX_FRAMES 4                // Received frames waiting to be read
+#define BT_RAW_WAIT_SLICE_MS 10           // Reply wait between TX queue checks
+#define BT_RAW_CONNECT_TIMEOUT_MS 10000   // SDP discovery, then the SPP connect
+#define BT_RAW_INQUIRY_UNITS 8            // Connect by name: inquiry length, 1.28 s units
+
 // Status polling interval (for catching remote control changes)
 #define STATUS_POLL_INTERVAL_MS 5000      // Poll every 5 seconds
 
+// GET /status serves the polled snapshot if it is younger than this (override with ?max_age=)
+#define STATUS_CACHE_MAX_AGE_MS (2 * STATUS_POLL_INTERVAL_MS)
+
+// Server-Sent Events (/events)
+#define EVENTS_MAX_SUBSCRIBERS 4          // Concurrent stream subscribers
+#define EVENTS_CLIENT_BUFFER_SIZE 512     // Per-subscriber send buffer (one message)
+#define EVENTS_METRICS_INTERVAL_MS 10000  // Periodic metrics event
+#define EVENTS_KEEPALIVE_MS 15000         // Comment line when nothing else was sent
+
+// Command batches (state planner)
+#define BATCH_TIMEOUT_MS 10000            // Give up on a target state job that hasn't finished
+#define PLAN_POWER_ON_SETTLE_MS 1500      // Extra wait after power_on before next command
+
+// Command queue
+#define CMD_QUEUE_CAPACITY 64             // Frames per priority class
+#define CMD_MIN_FRAME_GAP_MS 50           // Minimum gap between frames on the BT link
+#define CMD_STATUS_SETTLE_MS 100          // Gap before a status read that follows a command
+#define CMD_STATUS_TRACE_SLOTS 4          // Traced requests one status read can confirm
+#define CMD_BATCH_MAX_COMMANDS 32         // Commands per POST /commands batch
+#define CMD_BATCH_MAX_ACTIVE 4            // Batches in flight at once
+#define CMD_BATCH_MAX_PACE_MS 2000        // Upper bound for pace_ms
+#define CMD_BATCH_MAX_DELAY_MS 10000      // Upper bound for a per-step delay_ms
+
 // MQTT Topics
 #define MQTT_BASE_TOPIC "homeassistant/soundbar"
 #define MQTT_STATE_TOPIC MQTT_BASE_TOPIC "/state"
 #define MQTT_COMMAND_TOPIC MQTT_BASE_TOPIC "/command"
 #define MQTT_VOLUME_TOPIC MQTT_BASE_TOPIC "/set_volume"
 #define MQTT_SUBWOOFER_TOPIC MQTT_BASE_TOPIC "/set_subwoofer"
+#define MQTT_SET_STATE_TOPIC MQTT_BASE_TOPIC "/set_state"
 #define MQTT_AVAILABLE_TOPIC MQTT_BASE_TOPIC "/available"
+#define MQTT_BT_STATUS_TOPIC MQTT_BASE_TOPIC "/bt_status"
+#define MQTT_TEMPERATURE_TOPIC MQTT_BASE_TOPIC "/temperature"
+#define MQTT_BT_RSSI_TOPIC MQTT_BASE_TOPIC "/bt_rssi"
+#define MQTT_DIAGNOSTICS_TOPIC MQTT_BASE_TOPIC "/diagnostics"
+#define MQTT_LASTBOOT_TOPIC MQTT_BASE_TOPIC "/last_boot"
 #define MQTT_RESTART_TOPIC MQTT_BASE_TOPIC "/restart"
 #define MQTT_RESET_PAIRING_TOPIC MQTT_BASE_TOPIC "/reset_pairing"
+#define MQTT_LOG_LEVEL_TOPIC MQTT_BASE_TOPIC "/log_level"
 
 #endif
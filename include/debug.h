@@ -2,31 +2,204 @@
 #define DEBUG_H
 
 #include <Arduino.h>
+#include <functional>
+#include <type_traits>
+#include "config.h"
+#include "hex_dump.h"
 
-// Timestamp helper
-inline String timestamp() {
-    unsigned long ms = millis();
-    unsigned long sec = ms / 1000;
-    unsigned long min = sec / 60;
-    char buf[16];
-    sprintf(buf, "[%02lu:%02lu.%03lu] ", min % 60, sec % 60, ms % 1000);
-    return String(buf);
-}
-
-// Debug print with timestamp
-#define DBG(fmt, ...) Serial.printf("%s" fmt "\n", timestamp().c_str(), ##__VA_ARGS__)
-
-// Convert bytes to hex string for logging
-inline String bytesToHex(const uint8_t* data, int len) {
-    String result;
-    result.reserve(len * 3);
-    for (int i = 0; i < len; i++) {
-        if (i > 0) result += ' ';
-        char buf[3];
-        sprintf(buf, "%02X", data[i]);
-        result += buf;
+// Deferred logging
+//
+// DBG() only copies a timestamp, the format pointer and the raw arguments into
+// a lock-free ring; a low-priority task formats and writes them to the UART.
+// Safe to call from any task, including the BT stack callbacks. When the ring
+// is full the line is dropped and counted instead of waiting.
+//
+// The format must be a string literal. %s arguments are copied at record time
+// (up to LOG_STRING_BYTES per line in total), so temporaries like
+// String::c_str() are fine.
+//
+// Formatted lines also go to a RAM history (GET /logs) and, if SYSLOG_HOST is
+// set, to a rate-limited UDP syslog stream.
+
+// Captured argument
+struct LogArg {
+    enum Type : uint8_t { INT, UINT, DOUBLE, STR, PTR };
+    Type type;
+    uint8_t size;                     // sizeof the original integer, for %x of negative values
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        uint16_t str;                 // Offset into the record's string area
+        const void* p;
+    };
+};
+
+// One log line in the ring
+struct LogRecord {
+    uint32_t timestamp;
+    const char* fmt;
+    uint8_t level;
+    uint8_t argCount;
+    uint16_t strUsed;
+    bool truncated;
+    LogArg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_BYTES];
+};
+
+// Logging statistics
+struct LogStats {
+    uint32_t recorded = 0;
+    uint32_t dropped = 0;             // Ring full
+    uint32_t truncated = 0;           // Too many arguments or string bytes
+    uint32_t maxUsed = 0;             // High-water mark of queued lines
+    uint32_t syslogSent = 0;
+    uint32_t syslogSuppressed = 0;    // Over the rate limit or socket busy
+};
+
+extern LogStats logStats;
+
+// Start the drain task (call first thing in setup, lines logged before are dropped)
+void initLogging();
+
+// Wait until queued lines are written, e.g. before a restart
+void logFlush(unsigned long timeoutMs = 500);
+
+// Visit retained lines with seq > since, oldest first (text without newline)
+// Return false from the visitor to stop. Returns the oldest retained seq.
+// The visitor runs without the history lock held, on copies of the lines.
+typedef std::function<bool(uint32_t seq, const char* text, size_t len)> LogLineVisitor;
+uint32_t logHistoryForEach(uint32_t since, LogLineVisitor visit);
+
+// Sequence number of the newest line in the history
+uint32_t logHistoryLastSeq();
+
+// Reserve a ring slot, nullptr if the ring is full
+LogRecord* logBegin(uint8_t level, const char* fmt);
+// Publish a filled slot to the drain task
+void logCommit(LogRecord* rec);
+
+inline void logCapture(LogRecord* rec, const char* s) {
+    if (rec->argCount >= LOG_MAX_ARGS) {
+        rec->truncated = true;
+        return;
+    }
+    LogArg& a = rec->args[rec->argCount++];
+    a.type = LogArg::STR;
+    a.str = rec->strUsed;
+    if (!s) s = "(null)";
+    size_t room = LOG_STRING_BYTES - rec->strUsed;
+    size_t n = strnlen(s, room > 0 ? room - 1 : 0);
+    if (room == 0 || s[n] != '\0') {
+        rec->truncated = true;
+    }
+    if (room > 0) {
+        memcpy(rec->strings + rec->strUsed, s, n);
+        rec->strings[rec->strUsed + n] = '\0';
+        rec->strUsed += n + 1;
+    } else {
+        a.str = LOG_STRING_BYTES - 1;   // Points at the terminator of the last string
     }
-    return result;
 }
 
+inline void logCapture(LogRecord* rec, char* s) {
+    logCapture(rec, (const char*)s);
+}
+
+// ESP-IDF hands names over as uint8_t arrays (e.g. device_name in GAP events);
+// they are printed with %s, so copy them as strings rather than pointers
+inline void logCapture(LogRecord* rec, const uint8_t* s) {
+    logCapture(rec, (const char*)s);
+}
+
+inline void logCapture(LogRecord* rec, uint8_t* s) {
+    logCapture(rec, (const char*)s);
+}
+
+// Integers (and enums) keep their signedness and size, everything else by kind
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+logSetValue(LogArg& a, T value) {
+    if (std::is_signed<T>::value || std::is_enum<T>::value) {
+        a.type = LogArg::INT;
+        a.i = (long long)value;
+    } else {
+        a.type = LogArg::UINT;
+        a.u = (unsigned long long)value;
+    }
+}
+
+template<typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+logSetValue(LogArg& a, T value) {
+    a.type = LogArg::DOUBLE;
+    a.d = value;
+}
+
+template<typename T>
+inline void logSetValue(LogArg& a, T* value) {
+    a.type = LogArg::PTR;
+    a.p = (const void*)value;
+}
+
+template<typename T>
+inline void logCapture(LogRecord* rec, T value) {
+    if (rec->argCount >= LOG_MAX_ARGS) {
+        rec->truncated = true;
+        return;
+    }
+    LogArg& a = rec->args[rec->argCount++];
+    a.size = sizeof(T);
+    logSetValue(a, value);
+}
+
+template<typename... Args>
+inline void logRecord(uint8_t level, const char* fmt, Args... args) {
+    LogRecord* rec = logBegin(level, fmt);
+    if (!rec) return;
+    int expand[] = {0, (logCapture(rec, args), 0)...};
+    (void)expand;
+    logCommit(rec);
+}
+
+// Log modules, each with its own compile-time and runtime level
+enum LogModule : uint8_t {
+    LOG_MOD_SYS = 0,
+    LOG_MOD_BT,
+    LOG_MOD_MQTT,
+    LOG_MOD_HTTP,
+    LOG_MOD_CMD,
+    LOG_MOD_WIFI,
+    LOG_MOD_COUNT
+};
+
+// Runtime levels, start at the compiled level and can only be lowered below it
+extern uint8_t logLevels[LOG_MOD_COUNT];
+
+const char* logModuleName(LogModule mod);
+const char* logLevelName(uint8_t level);
+
+// Apply "bt:debug,cmd:warn" (or "all:info"), returns false on an unknown module or level
+bool setLogLevels(const String& spec);
+
+// Log at a level for a module, e.g. LOG_I(BT, "BT: Connected in %lu ms", ms)
+// Levels above the module's LOG_LEVEL_<mod> are a constant false, so the call,
+// its arguments and its format string are dropped by the compiler.
+// The dead printf keeps the compiler's format checking; it is never executed.
+#define LOG_AT(mod, level, fmt, ...) do { \
+    if ((level) <= LOG_LEVEL_##mod && (level) <= logLevels[LOG_MOD_##mod]) { \
+        if (false) Serial.printf(fmt, ##__VA_ARGS__); \
+        logRecord(level, fmt, ##__VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_E(mod, fmt, ...) LOG_AT(mod, LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_W(mod, fmt, ...) LOG_AT(mod, LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_I(mod, fmt, ...) LOG_AT(mod, LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_D(mod, fmt, ...) LOG_AT(mod, LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_V(mod, fmt, ...) LOG_AT(mod, LOG_LEVEL_VERBOSE, fmt, ##__VA_ARGS__)
+
+// General debug print with timestamp
+#define DBG(fmt, ...) LOG_I(SYS, fmt, ##__VA_ARGS__)
+
 #endif
@@ -0,0 +1,29 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <Arduino.h>
+
+// Event stream statistics
+struct EventStreamStats {
+    unsigned long subscribersAccepted = 0;
+    unsigned long subscribersRejected = 0;
+    unsigned long eventsSent = 0;
+    unsigned long eventsCoalesced = 0;   // Intermediate states dropped under backpressure
+};
+
+extern EventStreamStats eventStats;
+
+// Take over a detached HTTP socket as a Server-Sent Events subscriber
+// If all slots are in use the client gets a 503 and the socket is closed.
+bool addEventSubscriber(int fd);
+
+// Change notifications (fed from the same change detection as MQTT publishing)
+void notifyStateChanged();
+void notifyBtStatusChanged();
+
+// Flush pending events, send periodic metrics and keepalives (call from loop)
+void serviceEventStreams();
+
+size_t eventSubscriberCount();
+
+#endif
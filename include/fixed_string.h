@@ -0,0 +1,76 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+#include <string.h>
+
+// Inline string with a fixed capacity of N - 1 characters
+//
+// For state that is reassigned in steady-state operation (status fields, BT
+// status) where a String would free and reallocate on every change. Copies are
+// a memcpy; assignments longer than the capacity are cut off.
+template<size_t N>
+class FixedString {
+    static_assert(N > 1 && N <= 256, "FixedString capacity must be 1-255 characters");
+
+public:
+    FixedString() {
+        _buf[0] = '\0';
+    }
+
+    FixedString(const char* s) {
+        assign(s);
+    }
+
+    FixedString& operator=(const char* s) {
+        assign(s);
+        return *this;
+    }
+
+    FixedString& operator=(const String& s) {
+        assign(s.c_str(), s.length());
+        return *this;
+    }
+
+    void assign(const char* s) {
+        assign(s, s ? strlen(s) : 0);
+    }
+
+    void assign(const char* s, size_t len) {
+        if (len > N - 1) len = N - 1;
+        if (len > 0) memmove(_buf, s, len);
+        _buf[len] = '\0';
+        _len = len;
+    }
+
+    const char* c_str() const { return _buf; }
+    size_t length() const { return _len; }
+    bool isEmpty() const { return _len == 0; }
+    static size_t capacity() { return N - 1; }
+
+    bool operator==(const char* s) const { return strcmp(_buf, s ? s : "") == 0; }
+    bool operator!=(const char* s) const { return !(*this == s); }
+    bool operator==(const String& s) const { return s == _buf; }
+    bool operator!=(const String& s) const { return !(*this == s); }
+
+    template<size_t M>
+    bool operator==(const FixedString<M>& other) const {
+        return _len == other.length() && memcmp(_buf, other.c_str(), _len) == 0;
+    }
+
+    template<size_t M>
+    bool operator!=(const FixedString<M>& other) const {
+        return !(*this == other);
+    }
+
+private:
+    char _buf[N];
+    uint8_t _len = 0;
+};
+
+template<size_t N>
+inline bool operator==(const String& a, const FixedString<N>& b) { return b == a; }
+template<size_t N>
+inline bool operator!=(const String& a, const FixedString<N>& b) { return b != a; }
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <Arduino.h>
+
+// Crash flight recorder (/debug/lastboot, MQTT_LASTBOOT_TOPIC)
+//
+// The last FLIGHT_RECORDER_EVENTS events (BT status changes, commands sent,
+// loop stalls, heap low-water marks, restarts), the most recent warning and
+// error log lines and a checkpoint of the counters are kept in RTC slow memory,
+// which is not cleared by a panic, watchdog or software reset. At boot the
+// previous boot's record is copied out and the recorder starts over, so after
+// a reset it shows what led up to it together with the reset reason.
+//
+// Nothing survives a power cycle; a brownout usually keeps RTC memory but the
+// record is only trusted if its header checks out.
+
+enum FlightEventType : uint8_t {
+    FLIGHT_BOOT = 1,          // value: reset reason (esp_reset_reason_t)
+    FLIGHT_BT_STATUS,         // text: new BT status
+    FLIGHT_COMMAND,           // text: command, value: 1 if written to the link
+    FLIGHT_LOOP_STALL,        // value: iteration time in ms
+    FLIGHT_HEAP_MIN,          // value: new lowest free heap
+    FLIGHT_HEAP_BLOCK,        // value: largest free block below the warning level
+    FLIGHT_WIFI,              // text: event, value: disconnect reason
+    FLIGHT_MQTT,              // text: event, value: client state
+    FLIGHT_RESTART,           // text: who asked for the restart
+    FLIGHT_SUPERVISOR,        // text: subsystem tripped, value: ms overdue
+};
+
+struct FlightEvent {
+    uint32_t timeMs;          // millis() when recorded
+    int32_t value;
+    uint8_t type;             // FlightEventType
+    char text[15];
+};
+
+// Counters copied every FLIGHT_CHECKPOINT_MS; uptimeMs is when the boot was last seen alive
+struct FlightCounters {
+    uint32_t uptimeMs;
+    uint32_t btConnectAttempts;
+    uint32_t btConnectFailures;
+    uint32_t btDisconnects;
+    uint32_t btBytesSent;
+    uint32_t btBytesReceived;
+    uint32_t framesSent;
+    uint32_t mqttConnects;
+    uint32_t minFreeHeap;
+    uint32_t loopMaxMs;       // Longest loop iteration
+};
+
+// Call first thing in setup(), before initLogging()
+void initFlightRecorder();
+
+// Append an event; text is cut to 14 characters. Safe from any task.
+void flightRecord(FlightEventType type, const char* text = nullptr, int32_t value = 0);
+
+// Record one loop iteration and checkpoint the counters when due (call from loop)
+void flightLoop(unsigned long loopUs);
+
+// Keep a formatted log line (called by the log drain task for warnings and errors)
+void flightRecordLogLine(const char* line, size_t len);
+
+const char* flightEventName(uint8_t type);
+
+// This boot: sequence number and why the previous one ended
+uint32_t flightBootCount();
+const char* flightResetReason();
+
+// The previous boot, as it was when this one started
+bool lastBootAvailable();
+const FlightCounters& lastBootCounters();
+size_t lastBootEventCount();
+const FlightEvent& lastBootEventAt(size_t i);   // Oldest first
+const char* lastBootLog(size_t& length);          // Newline-separated, oldest first
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Heap telemetry (/debug/heap)
+//
+// Free heap, largest free block and fragmentation are checked every
+// HEAP_CHECK_INTERVAL_MS and sampled into a RAM history every
+// HEAP_SAMPLE_INTERVAL_MS, so slow fragmentation over long uptimes shows up as
+// a trend rather than a crash.
+//
+// Allocation counts come from link-time wrappers around malloc/free, built only
+// in the esp32-heaptrace env (HEAP_TRACK_ALLOCS). With HEAP_TRACK_CALLERS also defined,
+// allocations are additionally counted per calling address; resolve those with
+// xtensa-esp32-elf-addr2line -e firmware.elf <addr>.
+
+// Point-in-time heap state (internal 8-bit capable RAM)
+struct HeapSnapshot {
+    uint32_t freeBytes;
+    uint32_t minFreeBytes;            // Lowest free heap since boot
+    uint32_t largestBlock;
+    uint32_t minLargestBlock;         // Lowest largest-block seen by the periodic check
+    uint8_t fragmentationPct;         // 100 - largest block as a share of free heap
+};
+
+// Allocator call counts since boot (all zero without HEAP_TRACK_ALLOCS)
+struct HeapCounters {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t reallocs;
+    uint32_t failed;                  // Allocations that returned NULL
+};
+
+// One history entry
+struct HeapSample {
+    uint32_t uptimeS;
+    uint32_t freeBytes;
+    uint32_t minFreeBytes;
+    uint32_t largestBlock;
+    uint32_t allocs;
+    uint32_t frees;
+};
+
+// Take the first sample (call from setup)
+void initHeapMonitor();
+
+// Periodic check and history sampling (call from loop)
+void serviceHeapMonitor();
+
+HeapSnapshot heapSnapshot();
+HeapCounters heapCounters();
+bool heapAllocTracking();
+bool heapCallerTracking();
+
+// Count the allocations the calling task makes until heapWatchEnd(), which
+// returns them (always 0 without HEAP_TRACK_ALLOCS). One watch at a time.
+void heapWatchBegin();
+uint32_t heapWatchEnd();
+
+// History, oldest first
+size_t heapHistoryCount();
+const HeapSample& heapHistoryAt(size_t i);
+
+// Visit call sites by address; returns allocations not attributed (table full)
+typedef std::function<void(uint32_t pc, uint32_t count, uint32_t bytes)> HeapCallerVisitor;
+uint32_t heapCallersForEach(HeapCallerVisitor visit);
+
+#endif
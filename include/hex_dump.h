@@ -0,0 +1,20 @@
+#ifndef HEX_DUMP_H
+#define HEX_DUMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frame hex dumps for the per-frame verbose logs
+//
+// Formats into a caller buffer (on the stack at the call sites), so logging a
+// frame never touches the heap. No Arduino dependencies, the native test env
+// builds it.
+
+// Buffer size for a dump of n bytes: "AA BB CC" plus the terminator
+#define HEX_DUMP_SIZE(n) ((n) * 3)
+
+// "AA BB CC" into out, cut off at whole bytes if it doesn't fit. Returns out,
+// so the call can be a log argument and only runs when the level is enabled.
+const char* bytesToHex(const uint8_t* data, size_t len, char* out, size_t size);
+
+#endif
@@ -4,11 +4,23 @@
 // Initialize HTTP server routes
 void initHttpServer();
 
+// Complete deferred requests whose soundbar work has finished (call from loop)
+void serviceHttpRequests();
+
 // HTTP handlers
 void handleRoot();
 void handleStatus();
 void handleSendCommand();
+void handleSetState();
+void handleCommandBatch();
 void handleDebug();
+void handleTrace();
+void handleHeap();
+void handleTasks();
+void handleLastBoot();
+void handleMetrics();
+void handleEvents();
+void handleLogs();
 void handleResetPairing();
 void handleReconnect();
 void handleNotFound();
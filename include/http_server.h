@@ -0,0 +1,140 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "config.h"
+
+// Event-driven HTTP/1.1 server
+//
+// A socket task accepts connections, reads and parses requests for up to
+// HTTP_MAX_CONNECTIONS keep-alive clients at once, and hands complete requests
+// to loop() through a queue. Handlers run on the loop task with the same
+// arg()/header()/send() interface as the Arduino WebServer, so they can touch
+// firmware state without locking. A handler may defer() and complete the
+// request later with sendDeferred() once the soundbar has answered.
+
+enum HttpMethod : uint8_t {
+    HTTP_METHOD_ANY = 0,
+    HTTP_METHOD_GET,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_OTHER
+};
+
+typedef std::function<void(void)> HttpHandler;
+
+// Time from a request being read to its response being written, in microseconds
+typedef void (*HttpResponseTimeObserver)(uint32_t us);
+
+// Identifies a deferred request; stale once the connection moves on
+typedef uint32_t HttpRequestId;
+#define HTTP_REQUEST_NONE 0
+
+// Server statistics
+struct HttpServerStats {
+    unsigned long connectionsAccepted = 0;
+    unsigned long connectionsRejected = 0;   // All slots busy
+    unsigned long requests = 0;
+    unsigned long keepAliveReuses = 0;       // Requests on an already used connection
+    unsigned long parseErrors = 0;
+    unsigned long writeTimeouts = 0;         // Response stalled, client not reading
+    unsigned long deferred = 0;
+    unsigned long deferredExpired = 0;       // Connection gone before the answer
+    unsigned long unmatched = 0;             // No route for the path or method
+    unsigned long maxConcurrent = 0;
+};
+
+class AsyncHttpServer {
+public:
+    explicit AsyncHttpServer(uint16_t port);
+
+    // Register routes before begin()
+    void on(const char* path, HttpMethod method, HttpHandler handler);
+    void onNotFound(HttpHandler handler);
+
+    // Called for every finished response, from whichever task finished it
+    void onResponseTime(HttpResponseTimeObserver observer) { _responseTimeObserver = observer; }
+
+    // Open the listening socket and start the socket task
+    void begin();
+
+    // Run handlers for requests parsed since the last call (call from loop)
+    void handleClient();
+
+    // Current request (valid inside a handler)
+    HttpMethod method() const;
+    const String& uri() const;
+    bool hasArg(const String& name) const;
+    String arg(const String& name) const;      // "plain" is the raw body
+    bool hasHeader(const String& name) const;
+    String header(const String& name) const;
+
+    // Respond to the current request
+    void sendHeader(const String& name, const String& value);
+    void send(int code, const char* contentType = nullptr, const String& content = String());
+    // Body from a caller-owned buffer, copied straight into the connection's send buffer
+    void send(int code, const char* contentType, const char* content, size_t length);
+
+    // Keep the current request open and answer it later from loop()
+    HttpRequestId defer();
+    // extraHeaders is preformatted "Name: value\r\n" lines
+    bool sendDeferred(HttpRequestId id, int code, const char* contentType, const String& content,
+                      const String& extraHeaders = String());
+    bool sendDeferred(HttpRequestId id, int code, const char* contentType, const char* content, size_t length,
+                      const String& extraHeaders = String());
+    bool isPending(HttpRequestId id) const;
+
+    // Hand the current connection's socket to the caller (e.g. an event stream)
+    // The response headers are the caller's job; returns -1 on failure.
+    int detachClient();
+
+    size_t activeConnections() const;
+
+    // Registered routes and the requests dispatched to each
+    size_t routeCount() const;
+    const char* routePath(size_t i) const;
+    HttpMethod routeMethod(size_t i) const;
+    unsigned long routeRequests(size_t i) const;
+
+    HttpServerStats stats;
+
+private:
+    struct Route {
+        String path;
+        HttpMethod method;
+        HttpHandler handler;
+        unsigned long requests;
+    };
+
+    struct Connection;
+
+    static void taskEntry(void* arg);
+    void taskLoop();
+    void acceptClients();
+    void readClient(int slot);
+    bool parseRequest(int slot);
+    void writeClient(int slot);
+    void finishResponse(int slot);
+    void closeClient(int slot);
+    void rejectRequest(int slot, int code);
+    void queueResponse(int slot, int code, const char* contentType, const char* content, size_t length,
+                       const String& extraHeaders);
+    void dispatch(int slot);
+
+    uint16_t _port;
+    int _listenFd = -1;
+    QueueHandle_t _readyQueue = nullptr;
+    Route _routes[HTTP_MAX_ROUTES];
+    size_t _routeCount = 0;
+    HttpHandler _notFound;
+    HttpResponseTimeObserver _responseTimeObserver = nullptr;
+    Connection* _conns = nullptr;
+    int _current = -1;                        // Slot whose handler is running
+    bool _handled = false;                    // Current request answered, deferred or detached
+    String _extraHeaders;                     // sendHeader() for the current request
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef IDLE_LEARNER_H
+#define IDLE_LEARNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Idle timeout learning from disconnect timing
+//
+// Plain arithmetic with no Arduino dependencies, so the native test env can
+// build it; keepalive.cpp feeds it with the values from config.h.
+//
+// Every disconnect after at least minIdleMs of quiet is kept in a short
+// history. A soundbar that closes idle links does so after about the same
+// quiet time every time, whether or not polls run in between, while drops
+// from RF trouble land anywhere between two frames. The threshold is the
+// shortest sample of the largest group lying within tolerancePercent of its
+// own shortest member, once that group has minCluster samples and holds more
+// than half of the history. Until then (and when no group qualifies later on)
+// the previous threshold stays.
+
+#define IDLE_LEARNER_HISTORY 8
+
+struct IdleLearnerParams {
+    uint32_t minIdleMs;           // Drops after less quiet are not idle timeouts
+    uint8_t minCluster;           // Drops at about the same quiet time before one is learned
+    uint8_t tolerancePercent;     // Spread allowed within a group
+};
+
+struct IdleLearner {
+    uint32_t samples[IDLE_LEARNER_HISTORY];
+    size_t count;
+    size_t next;
+    uint32_t thresholdMs;         // Learned idle timeout, 0 if none
+};
+
+// Empty history, keeping a threshold restored from NVS (0 to forget it)
+void idleLearnerReset(IdleLearner& learner, uint32_t thresholdMs);
+
+// Record the quiet time before a disconnect; true when the threshold changed
+bool idleLearnerAdd(IdleLearner& learner, const IdleLearnerParams& params, uint32_t idleMs);
+
+// Size of the largest group of samples and its shortest member (0 if empty)
+size_t idleLearnerCluster(const IdleLearner& learner, const IdleLearnerParams& params, uint32_t& shortestMs);
+
+// Quiet time after which a keepalive goes out, 0 without a threshold:
+// leadPercent of the threshold, at least minIntervalMs, always short of it
+uint32_t idleKeepaliveInterval(uint32_t thresholdMs, uint8_t leadPercent, uint32_t minIntervalMs);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+// Static memory for JSON work
+//
+// ArduinoJson documents allocate their pools and strings from a bump arena in
+// a static buffer instead of the heap. Each ArenaJsonDocument gives back what
+// it used when it goes out of scope, so a request or publish never leaves
+// fragments behind. Serialized output goes to a shared static buffer and from
+// there straight to the HTTP connection or MQTT client.
+//
+// Loop task only (handlers, MQTT callback, publishing, event streams). A
+// document that outgrows the arena continues on the heap rather than failing.
+
+struct JsonArenaStats {
+    size_t peak = 0;                      // Most arena bytes in use at once
+    unsigned long heapFallbacks = 0;      // Allocations that didn't fit the arena
+    unsigned long outputOverflows = 0;    // Payloads too big for the output buffer
+};
+
+extern JsonArenaStats jsonArenaStats;
+
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override;
+    void deallocate(void* ptr) override;
+    void* reallocate(void* ptr, size_t newSize) override;
+
+    // Scopes: everything allocated after mark() is dropped by release()
+    size_t mark() const { return _top; }
+    void release(size_t mark);
+
+    size_t used() const { return _top; }
+
+private:
+    bool owns(const void* ptr) const;
+
+    alignas(4) uint8_t _buf[JSON_ARENA_BYTES];
+    size_t _top = 0;
+};
+
+extern JsonArena jsonArena;
+
+// Releases the arena back to where it was when constructed
+class JsonArenaScope {
+public:
+    JsonArenaScope() : _mark(jsonArena.mark()) {}
+    ~JsonArenaScope() { jsonArena.release(_mark); }
+
+private:
+    JsonArenaScope(const JsonArenaScope&);
+    JsonArenaScope& operator=(const JsonArenaScope&);
+    size_t _mark;
+};
+
+// JsonDocument backed by the arena; use as a local so documents are released in
+// reverse order of creation
+class ArenaJsonDocument : private JsonArenaScope, public JsonDocument {
+public:
+    ArenaJsonDocument() : JsonArenaScope(), JsonDocument(&jsonArena) {}
+};
+
+// Serialize into the shared output buffer (valid until the next call)
+// Returns nullptr if the payload doesn't fit; fall back to a String then.
+const char* serializeJsonOutput(const JsonDocument& doc, size_t& length);
+
+#endif
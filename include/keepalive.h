@@ -0,0 +1,50 @@
+#ifndef KEEPALIVE_H
+#define KEEPALIVE_H
+
+#include <Arduino.h>
+
+// Idle-link keepalive
+//
+// Some soundbars close the SPP link after a fixed idle time. Each disconnect
+// records how long the link had been quiet (BtStats.lastDisconnectIdleMs).
+// Drops after at least KEEPALIVE_MIN_IDLE_MS of quiet go to the learner
+// (idle_learner.h): once KEEPALIVE_LEARN_SAMPLES of the recent ones came
+// after about the same quiet time (within KEEPALIVE_TOLERANCE_PERCENT), the
+// shortest of them is the learned threshold, kept in NVS. Polls don't have to
+// stop for this; a timeout shorter than the poll interval shows up the same way.
+//
+// From then on the status poll interval is capped to KEEPALIVE_LEAD_PERCENT of
+// the threshold, and a status read (the only query the soundbar answers, 2
+// bytes out) is queued when the link has been quiet that long anyway, e.g.
+// while polling is held back. Commands count as traffic.
+//
+// YAS soundbars are switched on over this link, so by default the keepalive
+// also runs while the soundbar is off (KEEPALIVE_WHILE_OFF).
+
+struct KeepaliveStats {
+    uint32_t thresholdMs;     // Learned idle timeout, 0 if not learned yet
+    uint32_t intervalMs;      // Keepalive after this much quiet, 0 if inactive
+    uint32_t idleDisconnects;
+    uint32_t sent;
+    bool suspended;           // Soundbar off and KEEPALIVE_WHILE_OFF is 0
+};
+
+// Load the learned threshold (setup, after prefs opened)
+void initKeepalive();
+
+// The link dropped after idleMs of quiet (loop task)
+void keepaliveDisconnected(uint32_t idleMs);
+
+// Queue a keepalive when due (call from loop)
+void serviceKeepalive();
+
+// Forget the learned threshold
+void resetKeepalive();
+
+KeepaliveStats keepaliveStats();
+
+// Quiet time after which the keepalive goes out, 0 if not learned or suspended;
+// the status poll interval is capped to it
+uint32_t keepaliveIntervalMs();
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef LINK_POLICY_H
+#define LINK_POLICY_H
+
+#include <Arduino.h>
+#include <esp_gap_bt_api.h>
+
+// Bluetooth link mode tracking and sniff policy
+//
+// An idle SPP link is put into sniff by the BT stack. In sniff the soundbar
+// only listens every sniff interval, so the first frame after a quiet spell
+// waits for the link to come back to active. IDF 4.4 has no call to set the
+// link policy, so sniff is controlled through traffic:
+//
+//   - Sniff is held off while the power profile asks for it, and for
+//     LINK_INTERACTIVE_MS after a user or volume command is queued, since more
+//     are likely to follow. During that window a status read is queued
+//     whenever the link has been quiet for LINK_KEEPAWAKE_MS, before the
+//     stack's idle timer would put it into sniff. When only the profile holds
+//     sniff off, the regular status poll is the only traffic unless
+//     LINK_KEEPAWAKE_PROFILE is set.
+//   - Otherwise the link is left alone, and the next frame wakes it.
+//
+// Mode changes come from ESP_BT_GAP_MODE_CHG_EVT. The time spent in each mode
+// and the delay between a frame sent in sniff and the link becoming active
+// again are kept for /debug and /metrics.
+
+enum LinkMode : uint8_t {
+    LINK_ACTIVE,      // esp_bt_pm_mode_t order
+    LINK_HOLD,
+    LINK_SNIFF,
+    LINK_PARK,
+    LINK_MODE_COUNT
+};
+
+struct LinkModeStats {
+    uint32_t timeMs;          // Connected time spent in this mode
+    uint32_t entered;
+};
+
+struct LinkWakeStats {
+    uint32_t count;           // Frames sent while in sniff or hold
+    uint32_t sumMs;           // Until the mode change back to active
+    uint32_t maxMs;
+};
+
+// BT stack events (BT task)
+void linkOpened();
+void linkClosed();
+void linkModeChanged(esp_bt_pm_mode_t mode);
+
+// Traffic hints (loop task)
+void linkTrafficQueued(bool interactive);
+void linkFrameSending();
+
+// Keep the link awake while sniff is held off (call from loop)
+void serviceLinkPolicy();
+
+LinkMode linkMode();
+bool linkUp();
+uint32_t linkQuietMs();       // Since the last frame was sent
+bool linkSniffAllowed();
+bool linkInteractive();
+const char* linkModeName(LinkMode mode);
+LinkModeStats linkModeStats(LinkMode mode);
+LinkWakeStats linkWakeStats();
+uint32_t linkKeepAwakeReads();
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <Arduino.h>
+#include <esp_gap_bt_api.h>
+
+// Bluetooth link quality
+//
+// While the link is idle (nothing queued, quiet for BT_RSSI_IDLE_MS) the RSSI
+// of the soundbar link is read every BT_RSSI_INTERVAL_MS. The controller
+// reports it as a delta to its golden receive range: 0 inside the range,
+// negative below it. Each sample is kept with the last status round trip,
+// and disconnects and round trip spikes are logged with the RSSI average at
+// that moment, so a weak link can be told apart from a soundbar that hung up.
+//
+// The link counts as weak when the average of the last BT_RSSI_AVG_SAMPLES
+// drops below BT_RSSI_WEAK_DELTA, and recovers BT_RSSI_HYSTERESIS above it.
+
+struct LinkQualitySample {
+    uint32_t uptimeS;
+    int8_t rssiDelta;
+    uint16_t rttMs;           // Last status round trip before the sample, 0 if none
+};
+
+enum LinkQualityEventType : uint8_t {
+    LQ_DISCONNECT,            // value: seconds connected
+    LQ_RTT_SPIKE,             // value: round trip, ms
+    LQ_WEAK,                  // value: samples averaged
+    LQ_RECOVERED,
+};
+
+struct LinkQualityEvent {
+    uint32_t uptimeS;
+    uint16_t value;
+    int8_t rssiAvg;           // INT8_MIN: no samples yet
+    LinkQualityEventType type;
+};
+
+// BT stack events (BT task)
+void linkQualityPeer(const esp_bd_addr_t bda);
+void linkQualityRssiResult(esp_bt_status_t stat, int8_t rssiDelta);
+
+// Observations (loop task)
+void linkQualityObserveRtt(uint32_t ms);
+void linkQualityDisconnected(uint32_t connectedMs);
+
+// Read RSSI when the link is idle, publish the sensor (call from loop)
+void serviceLinkQuality();
+
+bool linkQualityValid();      // At least one sample since connecting
+int8_t linkQualityRssi();     // Last sample
+float linkQualityRssiAvg();
+bool linkQualityWeak();
+uint32_t linkQualityWeakCount();
+
+size_t linkQualitySampleCount();
+LinkQualitySample linkQualitySampleAt(size_t i);    // Oldest first
+size_t linkQualityEventCount();
+LinkQualityEvent linkQualityEventAt(size_t i);      // Oldest first
+const char* linkQualityEventName(LinkQualityEventType type);
+
+#endif
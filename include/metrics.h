@@ -0,0 +1,35 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Prometheus metrics (GET /metrics)
+//
+// Counters live in the modules that own them (btStats, cmdQueueStats,
+// mqttStats, ...). renderMetrics() writes them in text exposition format
+// straight into a caller-supplied buffer, so a scrape builds no document and
+// allocates nothing.
+
+// Fixed-bucket histogram, observe() is a short scan and two adds
+struct Histogram {
+    Histogram(const uint32_t* bounds, uint8_t boundCount, uint32_t unitsPerSecond);
+
+    void observe(uint32_t value);
+
+    const uint32_t* bounds;           // Bucket upper bounds, ascending, in the observed unit
+    uint8_t boundCount;
+    uint32_t unitsPerSecond;          // Exported in seconds: 1000 for ms, 1000000 for us
+    uint32_t buckets[METRICS_MAX_BUCKETS + 1];   // Per bucket (not cumulative), last is +Inf
+    uint64_t sum = 0;
+    uint32_t count = 0;
+};
+
+extern Histogram loopTimeHistogram;   // loop() iteration, us
+extern Histogram btRttHistogram;      // Status request to last reply byte, ms
+
+// Text exposition of all metrics, returns the length written
+// Metric families that don't fit are left out whole.
+size_t renderMetrics(char* buf, size_t size);
+
+#endif
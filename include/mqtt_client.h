@@ -2,21 +2,62 @@
 #define MQTT_CLIENT_H
 
 #include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "yas_commands.h"
 
+// MQTT statistics
+struct MqttStats {
+    unsigned long published = 0;
+    unsigned long dropped = 0;        // Not connected or the client refused the message
+    unsigned long received = 0;
+    unsigned long connects = 0;
+};
+
+extern MqttStats mqttStats;
+
+// Broker socket the supervisor task can shut down under a stuck PubSubClient
+// call. The descriptor is recorded after connect and forgotten before the
+// socket is closed, both under a lock, and abort() only shuts down the one on
+// record; a descriptor closed on the loop task and reused by lwIP for another
+// socket is never touched. A connect in progress is left to its own timeout.
+class MqttSocket : public WiFiClient {
+public:
+    MqttSocket();
+
+    using WiFiClient::connect;
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    void stop() override;
+
+    // Any task: shut the recorded socket down so blocked reads and writes return
+    void abort();
+
+private:
+    void record(int fd);
+
+    SemaphoreHandle_t _lock;
+    int _fd = -1;
+};
+
 // Initialize MQTT client
 void initMqtt();
 
 // Connection management
 void connectMqtt();
+void abortMqttSocket();       // Supervisor task
+void resetMqttConnection();
 
 // MQTT callback
 void mqttCallback(char* topic, byte* payload, unsigned int length);
 
 // Publishing
+bool mqttPublish(const char* topic, const char* payload, bool retained);
 void publishBtStatus();
 void publishStatus(const YasStatus& status);
 void publishDiscovery();
+void publishDiagnostics();
 
 // Volume/Subwoofer control (called from MQTT)
 void setVolume(int targetVolume);
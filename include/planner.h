@@ -0,0 +1,53 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include <vector>
+#include "yas_commands.h"
+
+// Desired partial state - only fields with has* set are applied
+struct TargetState {
+    bool hasPower = false;
+    bool power = false;
+    bool hasInput = false;
+    String input;
+    bool hasSurround = false;
+    String surround;
+    bool hasMuted = false;
+    bool muted = false;
+    bool hasVolume = false;
+    int volume = 0;
+    bool hasSubwoofer = false;
+    int subwoofer = 0;
+    bool hasBassExt = false;
+    bool bassExt = false;
+    bool hasClearVoice = false;
+    bool clearVoice = false;
+};
+
+// One command in a batch, with an optional extra settle delay after it
+struct PlanStep {
+    String command;
+    unsigned long delayAfterMs;
+};
+
+// Parse a JSON target state, returns false and sets error on invalid input
+bool parseTargetState(JsonVariantConst json, TargetState& target, String& error);
+
+// Diff target against current status and produce the shortest command list
+std::vector<PlanStep> planCommands(const YasStatus& current, const TargetState& target);
+
+// Called when a target state job finishes; on success lastSoundbarStatus holds the confirmed state
+typedef std::function<void(bool ok, const std::vector<PlanStep>& steps)> PlanDoneCallback;
+
+// Start moving to a target state without blocking: read current status, plan,
+// queue the steps back-to-back at user priority, then read status once.
+// Returns false if another job is still running.
+bool startTargetState(const TargetState& target, PlanDoneCallback done = nullptr);
+
+// Advance the running job (call from loop)
+void servicePlanner();
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+#include <esp_wifi_types.h>
+
+// Power profiles: WiFi power save, BT sniff and status polling
+//
+//   latency   WiFi min modem sleep, BT sniff held off, always
+//   balanced  as latency while the soundbar is on; sniff and slower polling
+//             allowed while it is off or unreachable
+//   eco       WiFi max modem sleep (long listen interval) and sniff allowed
+//
+// WiFi power save cannot be switched off while BT Classic runs: coexistence
+// needs modem sleep, and esp_wifi_set_ps(WIFI_PS_NONE) is rejected. Min modem
+// sleep wakes for every DTIM beacon and is the floor. Modem sleep makes the
+// access point hold inbound frames until the station wakes, which delays MQTT
+// commands and HTTP requests by up to a DTIM period (or listen interval). The delay
+// is on the inbound leg, before the frame reaches us, so it is measured with a
+// periodic ping to the gateway and accounted to the power save mode in use.
+//
+// Whether sniff is allowed is applied by the link policy (link_policy.h).
+//
+// The profile is kept in NVS and set with /debug?power=.
+
+enum PowerProfile : uint8_t {
+    POWER_LATENCY,
+    POWER_BALANCED,
+    POWER_ECO,
+    POWER_PROFILE_COUNT
+};
+
+struct LatencyStats {
+    uint32_t count;
+    uint32_t sumMs;
+    uint32_t maxMs;
+    uint32_t timeouts;
+};
+
+// Load and apply the saved profile (setup, after WiFi is up and prefs opened)
+void initPowerProfile();
+
+// Follow the soundbar power state for the balanced profile (call from loop)
+void servicePowerProfile();
+
+void setPowerProfile(PowerProfile profile);
+bool parsePowerProfile(const String& name, PowerProfile& profile);
+PowerProfile powerProfile();
+const char* powerProfileName(PowerProfile profile);
+
+// Current policy; the power save mode is the one WiFi reports, not the one requested
+wifi_ps_type_t wifiPowerSave();
+const char* wifiPowerSaveName(wifi_ps_type_t ps);
+bool btSniffAllowed();
+unsigned long statusPollIntervalMs();
+
+// Gateway round trips, by the WiFi power save mode they were measured under
+#define WIFI_PS_MODES 3               // WIFI_PS_NONE, _MIN_MODEM, _MAX_MODEM
+LatencyStats inboundLatency(wifi_ps_type_t ps);
+
+#endif
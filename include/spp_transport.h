@@ -0,0 +1,99 @@
+#ifndef SPP_TRANSPORT_H
+#define SPP_TRANSPORT_H
+
+#include <Arduino.h>
+#include <esp_gap_bt_api.h>
+#include <esp_spp_api.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/semphr.h>
+#include "config.h"
+
+// SPP transport on esp_spp_* directly (build with -DBT_RAW_SPP)
+//
+// BluetoothSerial runs its own TX/RX tasks and queues, copies every byte into
+// a ringbuffer and hands them out one read() at a time; the bridge only ever
+// exchanges frames of a few bytes. This transport keeps the subset of the
+// BluetoothSerial interface the bridge uses, but:
+//   - the controller runs in Classic-only mode with the BLE memory released,
+//   - there are no tasks of its own; writes go straight to esp_spp_write()
+//     and received data is framed (cc aa len ... checksum) in the SPP
+//     callback into a few fixed frame slots,
+//   - readFrame() blocks on a semaphore the callback gives when a frame is
+//     complete, instead of polling for bytes.
+//
+// Connecting and SSP are unchanged: initBluetooth() registers the GAP callback
+// and IO capability as before, and connect() by address or name goes through
+// SDP discovery and esp_spp_connect() with authentication and encryption.
+
+class SppTransport {
+public:
+    bool begin(const char* name, bool master);
+    void end();
+
+    bool connect(uint8_t addr[6]);
+    bool connect(const char* name);
+    bool connected(int timeoutMs = 0);
+    bool hasClient();
+    bool disconnect();
+
+    // SSP is set up by initBluetooth() through the GAP API
+    void enableSSP() {}
+    esp_err_t register_callback(esp_spp_cb_t callback);
+
+    size_t write(const uint8_t* data, size_t len);
+
+    // Bytes of received frames, for draining stale data
+    int available();
+    int read();
+
+    // Wait up to timeoutMs for the next whole frame; returns its length, 0 on timeout.
+    // receivedAt is when the callback completed the frame.
+    size_t readFrame(uint8_t* buffer, size_t size, uint32_t timeoutMs, unsigned long& receivedAt);
+
+    // Called from the GAP callback: inquiry results for connect by name
+    void onGapEvent(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t* param);
+
+    // Frames dropped because all slots were full, bytes outside any frame
+    uint32_t rxOverflows() const { return _rxOverflows; }
+    uint32_t rxDiscarded() const { return _rxDiscarded; }
+
+    // Static buffers held by the transport
+    static size_t bufferBytes();
+
+private:
+    static void sppCallback(esp_spp_cb_event_t event, esp_spp_cb_param_t* param);
+    void handleEvent(esp_spp_cb_event_t event, esp_spp_cb_param_t* param);
+    void receive(const uint8_t* data, size_t len);
+    bool waitFor(EventBits_t bits, uint32_t timeoutMs);
+
+    struct RxFrame {
+        uint8_t data[BT_RAW_FRAME_BYTES];
+        uint8_t len;
+        unsigned long receivedAt;
+    };
+
+    EventGroupHandle_t _events = nullptr;
+    SemaphoreHandle_t _frameReady = nullptr;
+    portMUX_TYPE _rxMux = portMUX_INITIALIZER_UNLOCKED;
+    esp_spp_cb_t _callback = nullptr;
+
+    volatile uint32_t _handle = 0;
+    uint8_t _scn = 0;
+    esp_bd_addr_t _found;         // Inquiry match for connect by name
+    const char* _wantedName = nullptr;
+
+    // Frame being assembled in the callback
+    uint8_t _partial[BT_RAW_FRAME_BYTES];
+    size_t _partialLen = 0;
+
+    RxFrame _frames[BT_RAW_RX_FRAMES];
+    size_t _frameHead = 0;
+    size_t _frameCount = 0;
+    size_t _readOffset = 0;       // Into the head frame, for read()
+
+    uint32_t _rxOverflows = 0;
+    uint32_t _rxDiscarded = 0;
+};
+
+#endif
@@ -2,11 +2,20 @@
 #define STATE_H
 
 #include <Arduino.h>
+#include <WiFi.h>
+#ifdef BT_RAW_SPP
+#include "spp_transport.h"
+typedef SppTransport BtTransport;
+#else
 #include <BluetoothSerial.h>
+typedef BluetoothSerial BtTransport;
+#endif
 #include <PubSubClient.h>
-#include <WebServer.h>
 #include <Preferences.h>
 #include "yas_commands.h"
+#include "fixed_string.h"
+#include "http_server.h"
+#include "mqtt_client.h"
 
 // Bluetooth statistics
 struct BtStats {
@@ -17,14 +26,19 @@ struct BtStats {
     unsigned long lastConnectDuration = 0;
     unsigned long totalConnectedTime = 0;
     unsigned long connectedSince = 0;
+    unsigned long lastDisconnectIdleMs = 0;   // Link quiet time when it last dropped
     unsigned long bytesSent = 0;
     unsigned long bytesReceived = 0;
-    String lastError;
+    FixedString<32> lastError;
 };
 
+// BT status name ("connected", "connect_failed", ...)
+typedef FixedString<24> BtStatusName;
+
 // Global objects (defined in main.cpp)
-extern BluetoothSerial SerialBT;
-extern WebServer server;
+extern BtTransport SerialBT;
+extern AsyncHttpServer server;
+extern MqttSocket wifiClient;
 extern PubSubClient mqtt;
 extern Preferences prefs;
 
@@ -36,11 +50,19 @@ extern unsigned long lastBtConnectAttempt;
 extern unsigned long reconnectHoldOffUntil;
 
 // Status tracking (defined in main.cpp)
-extern String lastBtStatus;
-extern String lastPublishedBtStatus;
+extern BtStatusName lastBtStatus;
+extern BtStatusName lastPublishedBtStatus;
 extern YasStatus lastSoundbarStatus;
+extern unsigned long statusVersion;       // Bumped whenever lastSoundbarStatus changes
+extern unsigned long lastStatusUpdate;    // millis() of the last successful status read
 
 // Status helper
-void setBtStatus(const String& status, const String& detail = "");
+void setBtStatus(const char* status, const char* detail = nullptr);
+
+// Restart WiFi from scratch (supervisor soft recovery)
+void resetWifi();
+
+// Record a fresh soundbar status read, publishes if anything changed
+void updateSoundbarStatus(const YasStatus& status);
 
 #endif
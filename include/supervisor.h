@@ -0,0 +1,60 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <Arduino.h>
+
+// Subsystem supervisor
+//
+// Subsystems report progress with supervisorBeat() and wrap calls that can
+// block (BT connect, MQTT I/O) in a SupervisedCall. A separate task checks
+// them every SUPERVISOR_CHECK_MS. A call stuck past its limit is first made to
+// return from the supervisor task (BT link closed, MQTT socket shut down). A
+// subsystem that has gone quiet, or was stuck, then gets a soft recovery on the
+// loop task: the BT stack is dropped and reinitialised, the MQTT socket closed,
+// or WiFi restarted. If it is still unhealthy SUPERVISOR_RECOVERY_GRACE_MS
+// later, the bridge restarts. Both steps are logged and kept by the flight
+// recorder.
+
+enum Subsystem : uint8_t {
+    SUB_LOOP,                 // loop() itself
+    SUB_WIFI,                 // Beats while associated
+    SUB_BT,                   // Beats on status replies, and while disconnected
+    SUB_MQTT,                 // Calls into PubSubClient
+    SUB_HTTP,                 // HTTP socket task
+    SUB_COUNT
+};
+
+struct SubsystemHealth {
+    const char* name;
+    uint32_t beatAgeMs;       // Since the last heartbeat
+    uint32_t callMs;          // Time in the current supervised call, 0 if none
+    bool recovering;          // Soft recovery done, waiting to see it work
+    uint32_t trips;
+    uint32_t recoveries;      // Trips that ended without a restart
+};
+
+// Start the supervisor task (end of setup)
+void initSupervisor();
+
+// Progress from a subsystem; safe from any task
+void supervisorBeat(Subsystem sub);
+
+// Run soft recoveries the supervisor asked for (call from loop)
+void serviceSupervisor();
+
+SubsystemHealth subsystemHealth(Subsystem sub);
+const char* subsystemName(Subsystem sub);
+
+// Marks a blocking call on the loop task; nests
+class SupervisedCall {
+public:
+    explicit SupervisedCall(Subsystem sub);
+    ~SupervisedCall();
+
+private:
+    SupervisedCall(const SupervisedCall&);
+    SupervisedCall& operator=(const SupervisedCall&);
+    Subsystem _sub;
+};
+
+#endif
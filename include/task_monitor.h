@@ -0,0 +1,39 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+// Per-task CPU usage and stack headroom (/debug/tasks, MQTT diagnostics)
+//
+// Every TASK_SAMPLE_INTERVAL_MS the FreeRTOS task list is read and CPU usage is
+// computed from the run-time counters over that interval, so the numbers show
+// what is busy now rather than averages since boot. CPU figures need
+// configGENERATE_RUN_TIME_STATS; without it only stacks and priorities are
+// reported.
+
+struct TaskInfo {
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t priority;
+    int8_t core;                      // -1 if not pinned (or unknown)
+    char state;                       // R(unning) r(eady) B(locked) S(uspended) D(eleted)
+    uint32_t stackFreeBytes;          // Lowest free stack ever (high-water mark)
+    uint16_t cpuPermille;             // Share of one core over the last interval
+};
+
+// Sample the task list when due (call from loop)
+void serviceTaskMonitor();
+
+bool taskCpuStatsAvailable();
+
+// Tasks from the last sample
+size_t taskCount();
+const TaskInfo& taskAt(size_t i);
+
+// Load per core over the last interval, permille (idle time subtracted)
+uint16_t coreLoadPermille(int core);
+
+// Length of the interval the CPU figures cover
+unsigned long taskSampleIntervalMs();
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+
+// Request lifecycle tracing
+//
+// Each MQTT/HTTP request that drives the soundbar gets a trace ID. Its stages
+// (handler, queue wait, BT TX, status read, publish) are recorded as
+// timestamped events in a fixed-size ring and exported as Chrome trace-event
+// JSON from /debug/trace. Stages running on the loop task are begin/end pairs
+// on the request's own track; queue waits overlap each other, so they are
+// async spans with their own IDs.
+
+typedef uint16_t TraceId;
+#define TRACE_NONE 0
+
+// Start a request: opens its top-level span and makes it the current trace
+TraceId traceStart(const char* name);
+// Close the top-level span of a request
+void traceFinish(TraceId id);
+
+// Trace the queue, status reads etc. attach to (TRACE_NONE if none)
+TraceId traceCurrent();
+void traceSetCurrent(TraceId id);
+// Current trace, marked as handed on to queued work so the handler scope won't finish it
+TraceId traceClaimCurrent();
+
+// Synchronous stage on the request's track
+void traceBegin(TraceId id, const char* name);
+void traceEnd(TraceId id, const char* name);
+
+// Overlapping stage (queue wait), returns the async span ID to end it with
+uint16_t traceAsyncBegin(TraceId id, const char* name);
+void traceAsyncEnd(TraceId id, uint16_t asyncId, const char* name);
+
+// Handler scope: starts a trace, and finishes it on exit unless queued work claimed it
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+    TraceId id;
+};
+
+// Chrome trace-event JSON of the buffer, written into buf; when it doesn't fit
+// the oldest events are left out. Returns the length (buf is terminated).
+size_t traceExport(char* buf, size_t size);
+void traceClear();
+
+size_t traceEventCount();
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <map>
+#include "fixed_string.h"
 
 // Command payloads (without framing)
 const std::map<String, String> COMMANDS = {
@@ -74,60 +75,79 @@ inline bool isValidCommand(const String& cmd) {
     return COMMANDS.find(cmd) != COMMANDS.end();
 }
 
-// Encode a command with framing
-// Format: ccaa <length> <payload> <checksum>
-inline String encodeCommand(const String& cmd) {
-    auto it = COMMANDS.find(cmd);
-    if (it == COMMANDS.end()) {
-        return "";
+// Value of two hex digits
+inline uint8_t hexByte(const char* hex) {
+    uint8_t value = 0;
+    for (int i = 0; i < 2; i++) {
+        char c = hex[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
     }
+    return value;
+}
 
-    String payload = it->second;
-    int payloadLen = payload.length() / 2;
+// Payload for a command name, nullptr if unknown. Compares in place rather than
+// through COMMANDS.find(), which would build a String from cmd on every send.
+inline const String* commandPayload(const char* cmd) {
+    for (const auto& entry : COMMANDS) {
+        if (strcmp(entry.first.c_str(), cmd) == 0) {
+            return &entry.second;
+        }
+    }
+    return nullptr;
+}
 
-    // Calculate checksum
-    int sum = payloadLen;
-    for (size_t i = 0; i < payload.length(); i += 2) {
-        sum += strtol(payload.substring(i, i + 2).c_str(), NULL, 16);
+// Encode a command with framing into frame, returns the frame length (0 if unknown)
+// Format: ccaa <length> <payload> <checksum>
+inline int encodeCommand(const char* cmd, uint8_t* frame, int maxLen) {
+    const String* found = commandPayload(cmd);
+    if (!found) {
+        return 0;
     }
-    int checksum = (-sum) & 0xFF;
 
-    // Build framed command
-    char result[32];
-    snprintf(result, sizeof(result), "ccaa%02x%s%02x", payloadLen, payload.c_str(), checksum);
-    return String(result);
-}
+    const String& payload = *found;
+    int payloadLen = payload.length() / 2;
+    if (payloadLen + 4 > maxLen) {
+        return 0;
+    }
 
-// Convert hex string to byte array
-inline int hexStringToBytes(const String& hex, uint8_t* buffer, int maxLen) {
-    int len = hex.length() / 2;
-    if (len > maxLen) len = maxLen;
+    frame[0] = 0xcc;
+    frame[1] = 0xaa;
+    frame[2] = payloadLen;
 
-    for (int i = 0; i < len; i++) {
-        buffer[i] = strtol(hex.substring(i * 2, i * 2 + 2).c_str(), NULL, 16);
+    // Checksum covers the length byte and the payload
+    int sum = payloadLen;
+    for (int i = 0; i < payloadLen; i++) {
+        frame[3 + i] = hexByte(payload.c_str() + i * 2);
+        sum += frame[3 + i];
     }
-    return len;
+    frame[3 + payloadLen] = (-sum) & 0xFF;
+    return payloadLen + 4;
 }
 
-// Convert byte array to hex string
-inline String bytesToHexString(const uint8_t* buffer, int len) {
-    String result = "";
-    for (int i = 0; i < len; i++) {
-        char hex[3];
-        snprintf(hex, sizeof(hex), "%02x", buffer[i]);
-        result += hex;
+// Name for a hex code in a decode table, "unknown" if it isn't listed
+inline const char* lookupName(const std::map<String, String>& names, const char* code) {
+    for (const auto& entry : names) {
+        if (entry.first == code) {
+            return entry.second.c_str();
+        }
     }
-    return result;
+    return "unknown";
 }
 
+// Decoded input/surround name, held inline so status copies don't allocate
+typedef FixedString<12> YasName;
+
 // Status structure
 struct YasStatus {
     bool power;
-    String input;
+    YasName input;
     bool muted;
     int volume;
     int subwoofer;
-    String surround;
+    YasName surround;
     bool bass_ext;
     bool clear_voice;
     bool valid;
@@ -135,37 +155,35 @@ struct YasStatus {
 
 // Decode status response
 // Format: ccaa 0d 05 00 <power> <input> <muted> <volume> <subwoofer> 20 20 00 <surround 2B> <be+cv>
-inline YasStatus decodeStatus(const String& hex) {
+inline YasStatus decodeStatus(const uint8_t* frame, int len) {
     YasStatus status = {false, "unknown", false, 0, 0, "unknown", false, false, false};
 
-    if (hex.length() < 32) {
+    if (len < 16) {
         return status;
     }
 
     // Check if this is a status message (type = 05)
-    if (hex.substring(6, 8) != "05") {
+    if (frame[3] != 0x05) {
         return status;
     }
 
     status.valid = true;
-    status.power = hex.substring(10, 12) == "01";
+    status.power = frame[5] == 0x01;
 
-    String inputBit = hex.substring(12, 14);
-    auto inputIt = INPUT_NAMES.find(inputBit);
-    status.input = (inputIt != INPUT_NAMES.end()) ? inputIt->second : "unknown";
+    char code[5];
+    snprintf(code, sizeof(code), "%02x", frame[6]);
+    status.input = lookupName(INPUT_NAMES, code);
 
-    status.muted = hex.substring(14, 16) == "01";
-    status.volume = strtol(hex.substring(16, 18).c_str(), NULL, 16);
-    status.subwoofer = strtol(hex.substring(18, 20).c_str(), NULL, 16);
+    status.muted = frame[7] == 0x01;
+    status.volume = frame[8];
+    status.subwoofer = frame[9];
 
-    String surroundBit = hex.substring(26, 30);
-    auto surroundIt = SURROUND_NAMES.find(surroundBit);
-    status.surround = (surroundIt != SURROUND_NAMES.end()) ? surroundIt->second : "unknown";
+    snprintf(code, sizeof(code), "%02x%02x", frame[13], frame[14]);
+    status.surround = lookupName(SURROUND_NAMES, code);
 
-    // Bass extension: check if high nibble of byte at position 30 is 0x2X
-    // Clear voice: check if low nibble of byte at position 30 is 0xX4
-    status.bass_ext = hex.substring(30, 31) == "2";
-    status.clear_voice = hex.substring(31, 32) == "4";
+    // Bass extension: high nibble 0x2X, clear voice: low nibble 0xX4
+    status.bass_ext = (frame[15] >> 4) == 0x2;
+    status.clear_voice = (frame[15] & 0x0F) == 0x4;
 
     return status;
 }
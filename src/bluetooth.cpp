@@ -3,43 +3,108 @@
 #include "config.h"
 #include "debug.h"
 #include "yas_commands.h"
+#include "mqtt_client.h"
+#include "metrics.h"
+#include "flight_recorder.h"
+#include "supervisor.h"
+#include "command_queue.h"
+#include "coex.h"
+#include "link_policy.h"
+#include "link_quality.h"
+#include "keepalive.h"
 
 #include <esp_bt.h>
 #include <esp_bt_main.h>
 #include <esp_bt_device.h>
 #include <esp_gap_bt_api.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+// SPP open/close events, handed from the BT task to loop()
+struct BtLinkEvent {
+    bool open;
+    uint32_t handle;
+    unsigned long at;
+};
+
+static QueueHandle_t linkEvents = nullptr;
+static volatile bool sppOpen = false;             // Fails in-flight requests as soon as the link closes
+static volatile uint32_t sppHandle = 0;
+static volatile bool connectAborted = false;      // Set by the supervisor, ends a connect attempt early
+static unsigned long lastLinkCheck = 0;
+static long stackHeapBytes = 0;
+
+// SPP congestion (set by the BT task) and the frames held while it lasts
+struct HeldFrame {
+    uint8_t data[BT_TX_FRAME_BYTES];
+    uint8_t len;
+    uint16_t tag;             // Command queue tag, reported when the frame goes out
+};
+
+static volatile bool congested = false;
+static uint32_t congestedSince = 0;
+static portMUX_TYPE txMux = portMUX_INITIALIZER_UNLOCKED;
+static BtTxStats txStats;
+static HeldFrame heldFrames[BT_TX_QUEUE_FRAMES];
+static size_t heldHead = 0;
+static size_t heldCount = 0;
+static unsigned long lastRelease = 0;
+
+// BT task
+static void setCongested(bool cong) {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&txMux);
+    if (cong && !congested) {
+        congested = true;
+        congestedSince = now;
+        txStats.congestions++;
+    } else if (!cong && congested) {
+        congested = false;
+        uint32_t ms = now - congestedSince;
+        txStats.congestedMs += ms;
+        if (ms > txStats.maxCongestedMs) txStats.maxCongestedMs = ms;
+    }
+    portEXIT_CRITICAL(&txMux);
+}
 
 // GAP callback for SSP (Secure Simple Pairing) events
 void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param) {
+#ifdef BT_RAW_SPP
+    // Inquiry results for connect by name
+    SerialBT.onGapEvent(event, param);
+#endif
     switch (event) {
         case ESP_BT_GAP_AUTH_CMPL_EVT:
             if (param->auth_cmpl.stat == ESP_BT_STATUS_SUCCESS) {
-                DBG("BT GAP: Authentication SUCCESS! Device: %s", param->auth_cmpl.device_name);
-                DBG("BT GAP: Link key stored, fast reconnect should work now");
+                LOG_I(BT, "BT GAP: Authentication SUCCESS! Device: %s", param->auth_cmpl.device_name);
+                LOG_I(BT, "BT GAP: Link key stored, fast reconnect should work now");
             } else {
-                DBG("BT GAP: Authentication FAILED, status: %d", param->auth_cmpl.stat);
+                LOG_E(BT, "BT GAP: Authentication FAILED, status: %d", param->auth_cmpl.stat);
             }
             break;
         case ESP_BT_GAP_PIN_REQ_EVT:
-            DBG("BT GAP: Legacy PIN request - responding with 1234");
+            LOG_I(BT, "BT GAP: Legacy PIN request - responding with 1234");
             {
                 esp_bt_pin_code_t pin = {'1', '2', '3', '4'};
                 esp_bt_gap_pin_reply(param->pin_req.bda, true, 4, pin);
             }
             break;
         case ESP_BT_GAP_CFM_REQ_EVT:
-            DBG("BT GAP: SSP User Confirmation request, passkey: %06d", param->cfm_req.num_val);
-            DBG("BT GAP: Auto-confirming for Just Works mode...");
+            LOG_I(BT, "BT GAP: SSP User Confirmation request, passkey: %06d", param->cfm_req.num_val);
+            LOG_I(BT, "BT GAP: Auto-confirming for Just Works mode...");
             esp_bt_gap_ssp_confirm_reply(param->cfm_req.bda, true);
             break;
         case ESP_BT_GAP_KEY_NOTIF_EVT:
-            DBG("BT GAP: Passkey notification: %06d", param->key_notif.passkey);
+            LOG_I(BT, "BT GAP: Passkey notification: %06d", param->key_notif.passkey);
             break;
         case ESP_BT_GAP_KEY_REQ_EVT:
-            DBG("BT GAP: Passkey request");
+            LOG_I(BT, "BT GAP: Passkey request");
+            break;
+        case ESP_BT_GAP_READ_RSSI_DELTA_EVT:
+            linkQualityRssiResult(param->read_rssi_delta.stat, param->read_rssi_delta.rssi_delta);
             break;
         case ESP_BT_GAP_MODE_CHG_EVT:
-            DBG("BT GAP: Mode change, mode: %d", param->mode_chg.mode);
+            linkModeChanged(param->mode_chg.mode);
             break;
         case ESP_BT_GAP_DISC_RES_EVT:
             {
@@ -56,29 +121,56 @@ void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param) {
                         break;
                     }
                 }
-                DBG("BT GAP: Discovered: %s [%s]", dev_name, bda_str);
+                LOG_V(BT, "BT GAP: Discovered: %s [%s]", dev_name, bda_str);
             }
             break;
         case ESP_BT_GAP_DISC_STATE_CHANGED_EVT:
-            DBG("BT GAP: Discovery %s", param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STARTED ? "STARTED" : "STOPPED");
+            LOG_I(BT, "BT GAP: Discovery %s", param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STARTED ? "STARTED" : "STOPPED");
             break;
         default:
-            DBG("BT GAP: Event %d", event);
+            LOG_V(BT, "BT GAP: Event %d", event);
             break;
     }
 }
 
+static void queueLinkEvent(bool open, uint32_t handle) {
+    BtLinkEvent ev = {open, handle, millis()};
+    if (!linkEvents || xQueueSend(linkEvents, &ev, 0) != pdTRUE) {
+        LOG_W(BT, "BT SPP: Event queue full, %s left to the link check", open ? "open" : "close");
+    }
+}
+
 // SPP callback for connection events (minimal logging - key events only)
 void btCallback(esp_spp_cb_event_t event, esp_spp_cb_param_t *param) {
     switch (event) {
         case ESP_SPP_INIT_EVT:
-            DBG("BT SPP: Initialized");
+            LOG_I(BT, "BT SPP: Initialized");
             break;
         case ESP_SPP_OPEN_EVT:
-            DBG("BT SPP: Connected (handle=%d)", param->open.handle);
+            LOG_I(BT, "BT SPP: Connected (handle=%d)", param->open.handle);
+            sppHandle = param->open.handle;
+            sppOpen = true;
+            linkOpened();
+            linkQualityPeer(param->open.rem_bda);
+            queueLinkEvent(true, param->open.handle);
             break;
         case ESP_SPP_CLOSE_EVT:
-            DBG("BT SPP: Disconnected");
+            LOG_I(BT, "BT SPP: Disconnected (handle=%d)", param->close.handle);
+            // A stale link closing while the next one opens must not fail the new one
+            if (param->close.handle == sppHandle) {
+                sppOpen = false;
+                linkClosed();
+            }
+            queueLinkEvent(false, param->close.handle);
+            setCongested(false);
+            break;
+        case ESP_SPP_CONG_EVT:
+            setCongested(param->cong.cong);
+            break;
+        case ESP_SPP_WRITE_EVT:
+            if (param->write.cong) {
+                setCongested(true);
+            }
             break;
         default:
             break;
@@ -87,41 +179,51 @@ void btCallback(esp_spp_cb_event_t event, esp_spp_cb_param_t *param) {
 
 // Initialize Bluetooth with SSP
 void initBluetooth() {
-    DBG("BT: Initializing BluetoothSerial as master...");
+    LOG_I(BT, "BT: Initializing BluetoothSerial as master...");
 
+    if (!linkEvents) {
+        linkEvents = xQueueCreate(BT_LINK_EVENT_QUEUE, sizeof(BtLinkEvent));
+    }
+    sppOpen = false;
+
+    long heapBefore = ESP.getFreeHeap();
     if (!SerialBT.begin(BT_DEVICE_NAME, true)) {
-        DBG("BT: Initialization FAILED!");
+        LOG_E(BT, "BT: Initialization FAILED!");
+        flightRecord(FLIGHT_RESTART, "bt_init");
+        logFlush();
         delay(1000);
         ESP.restart();
     }
-    DBG("BT: Initialized as '%s'", BT_DEVICE_NAME);
+    stackHeapBytes = heapBefore - (long)ESP.getFreeHeap();
+    LOG_I(BT, "BT: Initialized as '%s' (%s, stack took %ld bytes of heap)", BT_DEVICE_NAME,
+        btTransportName(), stackHeapBytes);
 
     // Register GAP callback for SSP events
     esp_bt_gap_register_callback(gapCallback);
-    DBG("BT: GAP callback registered");
+    LOG_D(BT, "BT: GAP callback registered");
 
     // Set IO capability to NoInputNoOutput for "Just Works" pairing
     esp_bt_io_cap_t iocap = ESP_BT_IO_CAP_NONE;
     esp_bt_gap_set_security_param(ESP_BT_SP_IOCAP_MODE, &iocap, sizeof(iocap));
-    DBG("BT: IO capability set to NoInputNoOutput (Just Works)");
+    LOG_D(BT, "BT: IO capability set to NoInputNoOutput (Just Works)");
 
     // Enable Secure Simple Pairing
     SerialBT.enableSSP();
-    DBG("BT: SSP enabled");
+    LOG_D(BT, "BT: SSP enabled");
 
     // Register SPP callback
     SerialBT.register_callback(btCallback);
-    DBG("BT: Callback registered");
+    LOG_D(BT, "BT: Callback registered");
 
     // Check for existing bonded devices
     int bondedCount = esp_bt_gap_get_bond_device_num();
-    DBG("BT: Bonded devices in NVS: %d", bondedCount);
+    LOG_I(BT, "BT: Bonded devices in NVS: %d", bondedCount);
 
     if (bondedCount > 0) {
         esp_bd_addr_t *bondedList = (esp_bd_addr_t *)malloc(bondedCount * sizeof(esp_bd_addr_t));
         if (bondedList && esp_bt_gap_get_bond_device_list(&bondedCount, bondedList) == ESP_OK) {
             for (int i = 0; i < bondedCount; i++) {
-                DBG("BT: Bonded[%d]: %02x:%02x:%02x:%02x:%02x:%02x", i,
+                LOG_D(BT, "BT: Bonded[%d]: %02x:%02x:%02x:%02x:%02x:%02x", i,
                     bondedList[i][0], bondedList[i][1], bondedList[i][2],
                     bondedList[i][3], bondedList[i][4], bondedList[i][5]);
             }
@@ -129,13 +231,13 @@ void initBluetooth() {
         }
     }
 
-    DBG("BT: Target soundbar: %s", SOUNDBAR_NAME);
-    DBG("BT: Target address: %s", SOUNDBAR_ADDRESS);
+    LOG_I(BT, "BT: Target soundbar: %s", SOUNDBAR_NAME);
+    LOG_I(BT, "BT: Target address: %s", SOUNDBAR_ADDRESS);
 }
 
 // Reset Bluetooth pairing - clears bond and prepares for fresh SSP handshake
 void resetPairing() {
-    DBG("BT: Resetting pairing...");
+    LOG_I(BT, "BT: Resetting pairing...");
 
     // Clear pairing state from NVS
     isPaired = false;
@@ -146,40 +248,68 @@ void resetPairing() {
     if (sscanf(SOUNDBAR_ADDRESS, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
                &addr[0], &addr[1], &addr[2], &addr[3], &addr[4], &addr[5]) == 6) {
         esp_err_t err = esp_bt_gap_remove_bond_device(addr);
-        DBG("BT: Removed bond device, result: %s", esp_err_to_name(err));
+        LOG_I(BT, "BT: Removed bond device, result: %s", esp_err_to_name(err));
     }
 
     // Disconnect if connected
     if (btConnected) {
         SerialBT.disconnect();
         btConnected = false;
+        sppOpen = false;
     }
 
     // Hold off reconnection for 30 seconds
     reconnectHoldOffUntil = millis() + 30000;
     setBtStatus("pairing_reset");
-    DBG("BT: Pairing reset - will reconnect in 30 seconds");
+    LOG_I(BT, "BT: Pairing reset - will reconnect in 30 seconds");
+}
+
+// Supervisor task: make a stuck BT call return. Closing the link fails a status
+// request at once; a connect stops after the attempt in progress, and an inquiry
+// for connect by name is cancelled. Only calls that post to the BT task are used.
+void abortBtCall() {
+    connectAborted = true;
+    if (sppOpen) {
+        sppOpen = false;
+        esp_spp_disconnect(sppHandle);
+    }
+    esp_bt_gap_cancel_discovery();
+}
+
+// Drop and reinitialise the BT stack (supervisor soft recovery); loop() notices
+// the lost connection and reconnects as usual
+void restartBluetooth() {
+    LOG_W(BT, "BT: Restarting Bluetooth stack");
+    clearCommandQueue();
+    sppOpen = false;
+    SerialBT.disconnect();
+    SerialBT.end();
+    initBluetooth();
+    lastBtConnectAttempt = millis();
 }
 
 // Connect to soundbar
 void connectBluetooth() {
+    SupervisedCall call(SUB_BT);
     lastBtConnectAttempt = millis();
     btStats.connectAttempts++;
+    connectAborted = false;
 
     if (SerialBT.connected()) {
-        DBG("BT: Already connected");
+        LOG_I(BT, "BT: Already connected");
         btConnected = true;
+        sppOpen = true;
         return;
     }
 
-    DBG("========================================");
-    DBG("BT: Connection attempt #%lu", btStats.connectAttempts);
-    DBG("BT: Target: \"%s\"", SOUNDBAR_NAME);
-    DBG("BT: Free heap: %d bytes", ESP.getFreeHeap());
+    LOG_I(BT, "========================================");
+    LOG_I(BT, "BT: Connection attempt #%lu", btStats.connectAttempts);
+    LOG_I(BT, "BT: Target: \"%s\"", SOUNDBAR_NAME);
+    LOG_I(BT, "BT: Free heap: %d bytes", ESP.getFreeHeap());
 
     // Ensure we're fully disconnected before trying
     if (SerialBT.hasClient()) {
-        DBG("BT: Has stale client, disconnecting...");
+        LOG_I(BT, "BT: Has stale client, disconnecting...");
         SerialBT.disconnect();
         delay(500);
     }
@@ -196,26 +326,26 @@ void connectBluetooth() {
                    &addr[0], &addr[1], &addr[2], &addr[3], &addr[4], &addr[5]) == 6) {
 
             // Try up to 3 rapid attempts - some devices need a "wake up" connection
-            for (int attempt = 1; attempt <= 3 && !connected; attempt++) {
-                DBG("BT: MAC connect attempt %d/3: %s", attempt, SOUNDBAR_ADDRESS);
+            for (int attempt = 1; attempt <= 3 && !connected && !connectAborted; attempt++) {
+                LOG_D(BT, "BT: MAC connect attempt %d/3: %s", attempt, SOUNDBAR_ADDRESS);
                 connected = SerialBT.connect(addr);
                 if (connected) {
-                    DBG("BT: MAC connect succeeded on attempt %d!", attempt);
-                } else if (attempt < 3) {
-                    DBG("BT: Attempt %d failed, retrying in 2s...", attempt);
+                    LOG_I(BT, "BT: MAC connect succeeded on attempt %d!", attempt);
+                } else if (attempt < 3 && !connectAborted) {
+                    LOG_W(BT, "BT: Attempt %d failed, retrying in 2s...", attempt);
                     delay(2000);
                 }
             }
 
-            if (!connected) {
-                DBG("BT: All MAC connect attempts failed, trying by name...");
+            if (!connected && !connectAborted) {
+                LOG_W(BT, "BT: All MAC connect attempts failed, trying by name...");
             }
         }
     }
 
     // If not connected yet, try by name
-    if (!connected) {
-        DBG("BT: Connecting by name: \"%s\"", SOUNDBAR_NAME);
+    if (!connected && !connectAborted) {
+        LOG_I(BT, "BT: Connecting by name: \"%s\"", SOUNDBAR_NAME);
         connected = SerialBT.connect(SOUNDBAR_NAME);
     }
 
@@ -226,9 +356,11 @@ void connectBluetooth() {
         btStats.connectSuccesses++;
         btStats.connectedSince = millis();
         btConnected = true;
+        sppOpen = true;
 
-        DBG("BT: SUCCESS! Connected in %lu ms", connectDuration);
-        DBG("BT: Success rate: %lu/%lu (%.1f%%)",
+        supervisorBeat(SUB_BT);
+        LOG_I(BT, "BT: SUCCESS! Connected in %lu ms", connectDuration);
+        LOG_I(BT, "BT: Success rate: %lu/%lu (%.1f%%)",
             btStats.connectSuccesses, btStats.connectAttempts,
             100.0 * btStats.connectSuccesses / btStats.connectAttempts);
 
@@ -236,60 +368,264 @@ void connectBluetooth() {
         if (!isPaired) {
             isPaired = true;
             prefs.putBool("paired", true);
-            DBG("BT: Saved paired state to NVS");
+            LOG_I(BT, "BT: Saved paired state to NVS");
         }
 
         setBtStatus("connected");
 
         if (mqtt.connected()) {
-            mqtt.publish(MQTT_AVAILABLE_TOPIC, "online", true);
+            mqttPublish(MQTT_AVAILABLE_TOPIC, "online", true);
         }
     } else {
         btStats.connectFailures++;
         btConnected = false;
 
-        DBG("BT: FAILED after %lu ms", connectDuration);
-        DBG("BT: Failure rate: %lu/%lu (%.1f%%)",
+        LOG_W(BT, "BT: FAILED after %lu ms", connectDuration);
+        LOG_W(BT, "BT: Failure rate: %lu/%lu (%.1f%%)",
             btStats.connectFailures, btStats.connectAttempts,
             100.0 * btStats.connectFailures / btStats.connectAttempts);
 
-        setBtStatus("connect_failed", String("attempt_") + String(btStats.connectAttempts));
+        char detail[24];
+        snprintf(detail, sizeof(detail), "attempt_%lu", btStats.connectAttempts);
+        setBtStatus("connect_failed", detail);
 
         if (mqtt.connected()) {
-            mqtt.publish(MQTT_AVAILABLE_TOPIC, "offline", true);
+            mqttPublish(MQTT_AVAILABLE_TOPIC, "offline", true);
         }
     }
 
-    DBG("BT: Next attempt in %d ms", BT_RECONNECT_DELAY_MS);
-    DBG("----------------------------------------");
+    LOG_I(BT, "BT: Next attempt in %d ms", BT_RECONNECT_DELAY_MS);
+    LOG_I(BT, "----------------------------------------");
 }
 
-// Send command to soundbar
-bool sendCommand(const String& cmd) {
-    String encoded = encodeCommand(cmd);
-    if (encoded.length() == 0) {
-        DBG("CMD: Unknown command: %s", cmd.c_str());
-        return false;
+// Frames that can no longer go out (link lost)
+static void clearHeldFrames() {
+    if (heldCount > 0) {
+        LOG_W(CMD, "CMD: Link lost with %d held frames", (int)heldCount);
+        txStats.dropped += heldCount;
+    }
+    for (size_t i = 0; i < heldCount; i++) {
+        reportCommandSent(heldFrames[(heldHead + i) % BT_TX_QUEUE_FRAMES].tag, false, millis());
     }
+    heldHead = 0;
+    heldCount = 0;
+    setCongested(false);
+}
 
-    uint8_t buffer[32];
-    int len = hexStringToBytes(encoded, buffer, sizeof(buffer));
+// The link dropped at the given time
+static void onBtDisconnected(unsigned long at) {
+    unsigned long connectedDuration = at - btStats.connectedSince;
+    btStats.totalConnectedTime += connectedDuration;
+    btStats.disconnects++;
+    unsigned long sinceClose = millis() - at;
+    unsigned long quiet = linkQuietMs();
+    unsigned long idle = quiet > sinceClose ? quiet - sinceClose : 0;
+    btStats.lastDisconnectIdleMs = idle < connectedDuration ? idle : connectedDuration;
+
+    LOG_W(BT, "BT: Connection LOST after %lu ms, idle %lu ms (total disconnects: %lu)",
+        connectedDuration, btStats.lastDisconnectIdleMs, btStats.disconnects);
+
+    setBtStatus("disconnected");
+    btConnected = false;
+    clearHeldFrames();
+    linkQualityDisconnected(connectedDuration);
+    keepaliveDisconnected(btStats.lastDisconnectIdleMs);
+    clearCommandQueue();
+
+    if (mqtt.connected()) {
+        mqttPublish(MQTT_AVAILABLE_TOPIC, "offline", true);
+        publishBtStatus();
+    }
+}
 
-    DBG("CMD TX: %s -> [%s] (%d bytes)", cmd.c_str(), bytesToHex(buffer, len).c_str(), len);
+// A link came up outside connectBluetooth() (e.g. a late open after a timed out connect)
+static void onBtConnected() {
+    btConnected = true;
+    sppOpen = true;
+    btStats.connectedSince = millis();
 
+    LOG_I(BT, "BT: Connection ESTABLISHED");
+    setBtStatus("connected");
+
+    if (mqtt.connected()) {
+        mqttPublish(MQTT_AVAILABLE_TOPIC, "online", true);
+        publishBtStatus();
+    }
+}
+
+// Apply queued SPP events; the periodic connected() check catches anything
+// without an event (stack restarted, queue overflow)
+void serviceBtEvents() {
+    BtLinkEvent ev;
+    while (linkEvents && xQueueReceive(linkEvents, &ev, 0) == pdTRUE) {
+        if (ev.open) {
+            if (!btConnected) {
+                onBtConnected();
+            }
+        } else if (btConnected && ev.handle == sppHandle) {
+            onBtDisconnected(ev.at);
+        }
+    }
+
+    if (millis() - lastLinkCheck < BT_LINK_CHECK_MS) {
+        return;
+    }
+    lastLinkCheck = millis();
+    bool isConnected = SerialBT.connected();
+    if (!isConnected && btConnected) {
+        LOG_W(BT, "BT: Link lost without a close event");
+        sppOpen = false;
+        linkClosed();
+        onBtDisconnected(millis());
+    } else if (isConnected && !btConnected) {
+        onBtConnected();
+    }
+}
+
+static bool writeFrame(const uint8_t* buffer, int len) {
+    linkFrameSending();
     size_t written = SerialBT.write(buffer, len);
     btStats.bytesSent += written;
 
     if (written != len) {
-        DBG("CMD: Write failed, sent %d of %d bytes", written, len);
+        LOG_E(CMD, "CMD: Write failed, sent %d of %d bytes", written, len);
         return false;
     }
-
     return true;
 }
 
+// Send command to soundbar
+SendResult sendCommand(const char* cmd, uint16_t tag) {
+    SupervisedCall call(SUB_BT);
+    uint8_t buffer[32];
+    int len = encodeCommand(cmd, buffer, sizeof(buffer));
+    if (len == 0) {
+        LOG_W(CMD, "CMD: Unknown command: %s", cmd);
+        return SEND_FAILED;
+    }
+
+    char hex[HEX_DUMP_SIZE(sizeof(buffer))];
+    LOG_V(CMD, "CMD TX: %s -> [%s] (%d bytes)", cmd, bytesToHex(buffer, len, hex, sizeof(hex)), len);
+
+    if (!sppOpen) {
+        LOG_W(CMD, "CMD: Link closed, not sending %s", cmd);
+        return SEND_FAILED;
+    }
+
+    // Behind frames already held, so the order on the link is kept
+    if (congested || heldCount > 0) {
+        if (heldCount >= BT_TX_QUEUE_FRAMES || len > BT_TX_FRAME_BYTES) {
+            txStats.dropped++;
+            LOG_E(CMD, "CMD: Link congested and TX queue full, dropping %s", cmd);
+            return SEND_FAILED;
+        }
+        HeldFrame& frame = heldFrames[(heldHead + heldCount) % BT_TX_QUEUE_FRAMES];
+        memcpy(frame.data, buffer, len);
+        frame.len = len;
+        frame.tag = tag;
+        heldCount++;
+        txStats.held++;
+        if (heldCount > txStats.maxDepth) txStats.maxDepth = heldCount;
+        LOG_D(CMD, "CMD: Link congested, holding %s (%d held)", cmd, (int)heldCount);
+        return SEND_HELD;
+    }
+
+    return writeFrame(buffer, len) ? SEND_WRITTEN : SEND_FAILED;
+}
+
+// Release held frames once congestion clears, one per frame gap
+void serviceBtTx() {
+    if (heldCount == 0 || congested || !sppOpen) {
+        return;
+    }
+    if (lastRelease != 0 && millis() - lastRelease < CMD_MIN_FRAME_GAP_MS) {
+        return;
+    }
+
+    const HeldFrame& frame = heldFrames[heldHead];
+    heldHead = (heldHead + 1) % BT_TX_QUEUE_FRAMES;
+    heldCount--;
+    lastRelease = millis();
+    txStats.released++;
+    bool ok = writeFrame(frame.data, frame.len);
+    reportCommandSent(frame.tag, ok, lastRelease);
+}
+
+const char* btTransportName() {
+#ifdef BT_RAW_SPP
+    return "raw_spp";
+#else
+    return "bluetooth_serial";
+#endif
+}
+
+long btStackHeapBytes() {
+    return stackHeapBytes;
+}
+
+bool btTxReady() {
+    return !congested && heldCount == 0;
+}
+
+size_t btTxDepth() {
+    return heldCount;
+}
+
+bool btTxCongested() {
+    return congested;
+}
+
+BtTxStats btTxStats() {
+    portENTER_CRITICAL(&txMux);
+    BtTxStats s = txStats;
+    if (congested) {
+        s.congestedMs += millis() - congestedSince;
+    }
+    portEXIT_CRITICAL(&txMux);
+    return s;
+}
+
+#ifdef BT_RAW_SPP
+// The transport hands over whole frames as the SPP callback completes them
+static int receiveReply(uint8_t* buffer, size_t size, unsigned long requestStart, unsigned long& lastByteTime) {
+    while (millis() - requestStart < STATUS_REQUEST_TIMEOUT_MS) {
+        if (!sppOpen) {
+            return -1;
+        }
+        serviceBtTx();
+        size_t len = SerialBT.readFrame(buffer, size, BT_RAW_WAIT_SLICE_MS, lastByteTime);
+        if (len > 0) {
+            btStats.bytesReceived += len;
+            return len;
+        }
+    }
+    return 0;
+}
+#else
+// Bytes until the line has been quiet for 100 ms; -1 if the link closed meanwhile
+static int receiveReply(uint8_t* buffer, size_t size, unsigned long requestStart, unsigned long& lastByteTime) {
+    int len = 0;
+    while (millis() - requestStart < STATUS_REQUEST_TIMEOUT_MS && len < (int)size) {
+        if (!sppOpen) {
+            return -1;
+        }
+        serviceBtTx();
+        if (SerialBT.available()) {
+            buffer[len++] = SerialBT.read();
+            lastByteTime = millis();
+            btStats.bytesReceived++;
+        } else if (len > 0 && millis() - lastByteTime > 100) {
+            break;
+        }
+        delay(1);
+    }
+    return len;
+}
+#endif
+
 // Request and parse status from soundbar
 YasStatus requestStatus() {
+    SupervisedCall call(SUB_BT);
     YasStatus status = {false, "unknown", false, 0, 0, "unknown", false, false, false};
 
     // Flush any stale data
@@ -299,11 +635,12 @@ YasStatus requestStatus() {
         flushed++;
     }
     if (flushed > 0) {
-        DBG("STATUS: Flushed %d stale bytes", flushed);
+        LOG_D(CMD, "STATUS: Flushed %d stale bytes", flushed);
     }
 
+    unsigned long sendStart = millis();
     if (!sendCommand("report_status")) {
-        DBG("STATUS: Failed to send request");
+        LOG_W(CMD, "STATUS: Failed to send request");
         return status;
     }
 
@@ -311,38 +648,35 @@ YasStatus requestStatus() {
     unsigned long requestStart = millis();
     unsigned long lastByteTime = millis();
     uint8_t buffer[64];
-    int len = 0;
-
-    while (millis() - requestStart < STATUS_REQUEST_TIMEOUT_MS && len < (int)sizeof(buffer)) {
-        if (SerialBT.available()) {
-            buffer[len++] = SerialBT.read();
-            lastByteTime = millis();
-            btStats.bytesReceived++;
-        } else if (len > 0 && millis() - lastByteTime > 100) {
-            break;
-        }
-        delay(1);
+    int len = receiveReply(buffer, sizeof(buffer), requestStart, lastByteTime);
+    if (len < 0) {
+        LOG_W(CMD, "STATUS: Link closed after %lu ms, request failed", millis() - requestStart);
+        return status;
     }
 
     if (len > 0) {
-        DBG("STATUS RX: [%s] (%d bytes in %lu ms)",
-            bytesToHex(buffer, len).c_str(), len, millis() - requestStart);
+        char hex[HEX_DUMP_SIZE(sizeof(buffer))];
+        LOG_V(CMD, "STATUS RX: [%s] (%d bytes in %lu ms)",
+            bytesToHex(buffer, len, hex, sizeof(hex)), len, millis() - requestStart);
 
-        String response = bytesToHexString(buffer, len);
-        status = decodeStatus(response);
+        status = decodeStatus(buffer, len);
 
         if (status.valid) {
-            DBG("STATUS: power=%s input=%s vol=%d mute=%s surround=%s",
+            supervisorBeat(SUB_BT);
+            btRttHistogram.observe(lastByteTime - sendStart);
+            coexObserveBtRtt(lastByteTime - sendStart);
+            linkQualityObserveRtt(lastByteTime - sendStart);
+            LOG_D(CMD, "STATUS: power=%s input=%s vol=%d mute=%s surround=%s",
                 status.power ? "ON" : "OFF",
                 status.input.c_str(),
                 status.volume,
                 status.muted ? "ON" : "OFF",
                 status.surround.c_str());
         } else {
-            DBG("STATUS: Failed to decode response");
+            LOG_W(CMD, "STATUS: Failed to decode response");
         }
     } else {
-        DBG("STATUS: No response (timeout after %lu ms)", millis() - requestStart);
+        LOG_W(CMD, "STATUS: No response (timeout after %lu ms)", millis() - requestStart);
     }
 
     return status;
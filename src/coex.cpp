@@ -0,0 +1,145 @@
+#include "coex.h"
+#include "config.h"
+#include "debug.h"
+
+#include <esp_coexist.h>
+#include <freertos/FreeRTOS.h>
+
+static const char* const modeNames[COEX_MODE_COUNT] = {"balanced", "bt", "wifi"};
+static const esp_coex_prefer_t preferences[COEX_MODE_COUNT] = {
+    ESP_COEX_PREFER_BALANCE, ESP_COEX_PREFER_BT, ESP_COEX_PREFER_WIFI
+};
+
+static CoexModeStats modeStats[COEX_MODE_COUNT];
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile CoexMode currentMode = COEX_BALANCED;
+static unsigned long modeSince = 0;
+static bool automatic = true;
+static bool initialized = false;
+
+// Preference holds, millis() deadlines; BT wins when both are active
+static unsigned long btUntil = 0;
+static unsigned long wifiUntil = 0;
+
+const char* coexModeName(CoexMode mode) {
+    return mode < COEX_MODE_COUNT ? modeNames[mode] : "?";
+}
+
+static void applyMode(CoexMode mode) {
+    if (!initialized || mode == currentMode) {
+        return;
+    }
+
+    esp_err_t err = esp_coex_preference_set(preferences[mode]);
+    if (err != ESP_OK) {
+        LOG_W(SYS, "COEX: Setting preference %s failed: %s", modeNames[mode], esp_err_to_name(err));
+        return;
+    }
+
+    unsigned long now = millis();
+    portENTER_CRITICAL(&statsMux);
+    modeStats[currentMode].activeMs += now - modeSince;
+    modeStats[mode].entered++;
+    currentMode = mode;
+    portEXIT_CRITICAL(&statsMux);
+    modeSince = now;
+    LOG_D(SYS, "COEX: Preference %s", modeNames[mode]);
+}
+
+static CoexMode wantedMode() {
+    unsigned long now = millis();
+    if ((long)(btUntil - now) > 0) return COEX_PREFER_BT;
+    if ((long)(wifiUntil - now) > 0) return COEX_PREFER_WIFI;
+    return COEX_BALANCED;
+}
+
+void initCoex() {
+    esp_err_t err = esp_coex_preference_set(ESP_COEX_PREFER_BALANCE);
+    if (err != ESP_OK) {
+        LOG_W(SYS, "COEX: Preference not supported: %s", esp_err_to_name(err));
+        return;
+    }
+    initialized = true;
+    currentMode = COEX_BALANCED;
+    modeSince = millis();
+    modeStats[COEX_BALANCED].entered = 1;
+}
+
+void serviceCoex() {
+    if (automatic) {
+        applyMode(wantedMode());
+    }
+}
+
+void coexBtActivity() {
+    btUntil = millis() + COEX_BT_HOLD_MS;
+    if (automatic) {
+        applyMode(COEX_PREFER_BT);
+    }
+}
+
+void coexWifiBurst() {
+    wifiUntil = millis() + COEX_WIFI_HOLD_MS;
+    if (automatic) {
+        applyMode(wantedMode());
+    }
+}
+
+void coexObserveBtRtt(uint32_t ms) {
+    portENTER_CRITICAL(&statsMux);
+    CoexModeStats& s = modeStats[currentMode];
+    s.btRttCount++;
+    s.btRttSumMs += ms;
+    if (ms > s.btRttMaxMs) s.btRttMaxMs = ms;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void coexObserveHttp(uint32_t us) {
+    portENTER_CRITICAL(&statsMux);
+    CoexModeStats& s = modeStats[currentMode];
+    s.httpCount++;
+    s.httpSumUs += us;
+    if (us > s.httpMaxUs) s.httpMaxUs = us;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void setCoexMode(CoexMode mode, bool automaticMode) {
+    automatic = automaticMode;
+    applyMode(automatic ? wantedMode() : mode);
+    LOG_I(SYS, "COEX: %s", automatic ? "Following traffic" : modeNames[mode]);
+}
+
+bool parseCoexMode(const String& name, CoexMode& mode, bool& automaticMode) {
+    automaticMode = name.equalsIgnoreCase("auto");
+    if (automaticMode) {
+        mode = COEX_BALANCED;
+        return true;
+    }
+    for (int m = 0; m < COEX_MODE_COUNT; m++) {
+        if (name.equalsIgnoreCase(modeNames[m])) {
+            mode = (CoexMode)m;
+            return true;
+        }
+    }
+    return false;
+}
+
+CoexMode coexMode() {
+    return currentMode;
+}
+
+bool coexAutomatic() {
+    return automatic;
+}
+
+CoexModeStats coexModeStats(CoexMode mode) {
+    CoexModeStats s;
+    portENTER_CRITICAL(&statsMux);
+    s = modeStats[mode < COEX_MODE_COUNT ? mode : COEX_BALANCED];
+    if (initialized && mode == currentMode) {
+        s.activeMs += millis() - modeSince;
+    }
+    portEXIT_CRITICAL(&statsMux);
+    return s;
+}
@@ -0,0 +1,196 @@
+#include "command_batch.h"
+#include "command_queue.h"
+#include "state.h"
+#include "config.h"
+#include "debug.h"
+#include "yas_commands.h"
+
+// Batch in flight, advanced by the sent handler and serviceCommandBatches()
+struct ActiveBatch {
+    bool active = false;
+    CommandBatch batch;
+    BatchDoneCallback done;
+    size_t sentCount = 0;
+    unsigned long deadline = 0;
+    unsigned long readMark = 0;       // cmdQueueStats.statusReads after the last command went out
+};
+
+static ActiveBatch batches[CMD_BATCH_MAX_ACTIVE];
+static uint16_t nextBatchId = 1;
+
+bool parseCommandBatch(JsonVariantConst json, CommandBatch& batch, String& error) {
+    JsonArrayConst list = json["commands"].as<JsonArrayConst>();
+    if (list.isNull() || list.size() == 0) {
+        error = "Expected a non-empty commands array";
+        return false;
+    }
+    if (list.size() > CMD_BATCH_MAX_COMMANDS) {
+        error = "Too many commands (max " + String(CMD_BATCH_MAX_COMMANDS) + ")";
+        return false;
+    }
+
+    batch.commands.clear();
+    for (JsonVariantConst entry : list) {
+        BatchCommand cmd;
+        if (entry.is<const char*>()) {
+            cmd.command = entry.as<String>();
+        } else if (entry["command"].is<const char*>()) {
+            cmd.command = entry["command"].as<String>();
+            if (!entry["delay_ms"].isNull()) {
+                long delayMs = entry["delay_ms"].as<long>();
+                if (!entry["delay_ms"].is<long>() || delayMs < 0 || delayMs > CMD_BATCH_MAX_DELAY_MS) {
+                    error = "Invalid delay_ms for " + cmd.command;
+                    return false;
+                }
+                cmd.delayAfterMs = delayMs;
+            }
+        } else {
+            error = "Invalid entry in commands";
+            return false;
+        }
+
+        // Status reads have their own flag; a raw report_status would leave a reply nobody reads
+        if (COMMANDS.find(cmd.command) == COMMANDS.end() || cmd.command == "report_status") {
+            error = "Unknown command: " + cmd.command;
+            return false;
+        }
+        batch.commands.push_back(cmd);
+    }
+
+    batch.paceMs = CMD_MIN_FRAME_GAP_MS;
+    if (!json["pace_ms"].isNull()) {
+        long pace = json["pace_ms"].as<long>();
+        if (!json["pace_ms"].is<long>() || pace < CMD_MIN_FRAME_GAP_MS || pace > CMD_BATCH_MAX_PACE_MS) {
+            error = "Invalid pace_ms (" + String(CMD_MIN_FRAME_GAP_MS) + "-" + String(CMD_BATCH_MAX_PACE_MS) + ")";
+            return false;
+        }
+        batch.paceMs = pace;
+    }
+
+    batch.readStatus = json["status"] | false;
+    return true;
+}
+
+static ActiveBatch* findBatch(uint16_t id) {
+    for (ActiveBatch& b : batches) {
+        if (b.active && b.batch.id == id) {
+            return &b;
+        }
+    }
+    return nullptr;
+}
+
+// Record the TX time of each batch command as the queue sends it
+static void onCommandSent(uint16_t tag, bool ok, unsigned long sentAt) {
+    ActiveBatch* b = findBatch(tag);
+    if (!b || b->sentCount >= b->batch.commands.size()) {
+        return;
+    }
+
+    BatchCommand& cmd = b->batch.commands[b->sentCount++];
+    cmd.sent = true;
+    cmd.ok = ok;
+    cmd.sentAt = sentAt;
+    if (b->sentCount == b->batch.commands.size()) {
+        b->readMark = cmdQueueStats.statusReads;
+    }
+}
+
+static void finishBatch(ActiveBatch& b, bool ok) {
+    b.batch.finishedAt = millis();
+    unsigned long elapsed = b.batch.finishedAt - b.batch.startedAt;
+    if (ok) {
+        LOG_I(CMD, "BATCH: #%u Done (%d commands, %lu ms)", b.batch.id, (int)b.sentCount, elapsed);
+    } else {
+        LOG_W(CMD, "BATCH: #%u Failed (%d/%d sent, %lu ms)", b.batch.id,
+            (int)b.sentCount, (int)b.batch.commands.size(), elapsed);
+    }
+
+    b.active = false;
+    BatchDoneCallback done = b.done;
+    b.done = nullptr;
+    if (done) {
+        done(ok, b.batch);
+    }
+}
+
+bool startCommandBatch(const CommandBatch& batch, BatchDoneCallback done, String& error) {
+    if (!btConnected) {
+        error = "Bluetooth not connected";
+        return false;
+    }
+
+    ActiveBatch* slot = nullptr;
+    for (ActiveBatch& b : batches) {
+        if (!b.active) {
+            slot = &b;
+            break;
+        }
+    }
+    if (!slot) {
+        error = "Too many batches in progress";
+        return false;
+    }
+
+    // All or nothing - a half-queued batch would be worse than none
+    if (commandQueueFree(PRIO_USER) < batch.commands.size()) {
+        error = "Command queue full";
+        return false;
+    }
+
+    setCommandSentHandler(onCommandSent);
+
+    slot->active = true;
+    slot->batch = batch;
+    slot->batch.id = nextBatchId++;
+    if (nextBatchId >= CMD_TAG_INTERNAL) nextBatchId = 1;
+    slot->batch.startedAt = millis();
+    slot->done = done;
+    slot->sentCount = 0;
+
+    // Pacing is expressed as extra hold on top of the queue's minimum frame gap
+    unsigned long expectedMs = 0;
+    for (const BatchCommand& cmd : slot->batch.commands) {
+        unsigned long hold = (slot->batch.paceMs - CMD_MIN_FRAME_GAP_MS) + cmd.delayAfterMs;
+        queueCommand(cmd.command, PRIO_USER, hold, slot->batch.id);
+        expectedMs += slot->batch.paceMs + cmd.delayAfterMs;
+    }
+    // At user priority the read goes out right after the last command
+    queueStatusRequest(slot->batch.readStatus ? PRIO_USER : PRIO_CONFIRM);
+    slot->deadline = slot->batch.startedAt + expectedMs + BATCH_TIMEOUT_MS;
+
+    LOG_D(CMD, "BATCH: #%u queued %d commands, pace %lu ms", slot->batch.id,
+        (int)slot->batch.commands.size(), slot->batch.paceMs);
+    return true;
+}
+
+void serviceCommandBatches() {
+    for (ActiveBatch& b : batches) {
+        if (!b.active) {
+            continue;
+        }
+
+        // Queue is cleared on disconnect, so unsent commands will never go out
+        if (!btConnected || (long)(millis() - b.deadline) > 0) {
+            finishBatch(b, false);
+            continue;
+        }
+
+        if (b.sentCount < b.batch.commands.size()) {
+            continue;
+        }
+
+        bool allOk = true;
+        for (const BatchCommand& cmd : b.batch.commands) {
+            allOk = allOk && cmd.ok;
+        }
+
+        if (!b.batch.readStatus) {
+            finishBatch(b, allOk);
+        } else if (cmdQueueStats.statusReads > b.readMark) {
+            bool readOk = lastSoundbarStatus.valid &&
+                (long)(lastStatusUpdate - b.batch.commands.back().sentAt) >= 0;
+            finishBatch(b, allOk && readOk);
+        }
+    }
+}
@@ -0,0 +1,336 @@
+#include "command_queue.h"
+#include "state.h"
+#include "config.h"
+#include "debug.h"
+#include "bluetooth.h"
+#include "trace.h"
+#include "flight_recorder.h"
+#include "coex.h"
+#include "link_policy.h"
+#include "heap_monitor.h"
+
+CommandQueueStats cmdQueueStats;
+
+// Queued frame - cmd points at the key in COMMANDS, so no allocation per entry
+struct QueuedCommand {
+    const char* cmd;
+    unsigned long delayAfterMs;
+    uint16_t tag;
+    TraceId trace;
+    uint16_t traceWait;       // Async span covering the time in the queue
+};
+
+// One FIFO ring per priority class
+struct CommandRing {
+    QueuedCommand items[CMD_QUEUE_CAPACITY];
+    size_t head = 0;
+    size_t count = 0;
+};
+
+static CommandRing rings[PRIO_COUNT];
+static CommandPriority pendingStatusPrio = PRIO_COUNT;   // PRIO_COUNT = none queued
+static unsigned long lastFrameTime = 0;
+static unsigned long holdUntil = 0;
+static bool lastFrameWasCommand = false;
+static CommandSentHandler sentHandler = nullptr;
+
+// Traces waiting for the pending status read to confirm them
+struct StatusTrace {
+    TraceId trace;
+    uint16_t wait;
+    bool finish;              // The read completes the request
+};
+static StatusTrace statusTraces[CMD_STATUS_TRACE_SLOTS];
+static size_t statusTraceCount = 0;
+
+size_t commandQueueDepth() {
+    size_t depth = (pendingStatusPrio < PRIO_COUNT) ? 1 : 0;
+    for (int p = 0; p < PRIO_COUNT; p++) {
+        depth += rings[p].count;
+    }
+    return depth;
+}
+
+size_t commandQueueFree(CommandPriority prio) {
+    return prio < PRIO_COUNT ? CMD_QUEUE_CAPACITY - rings[prio].count : 0;
+}
+
+void setCommandSentHandler(CommandSentHandler handler) {
+    sentHandler = handler;
+}
+
+void reportCommandSent(uint16_t tag, bool ok, unsigned long sentAt) {
+    if (tag != CMD_TAG_NONE && tag < CMD_TAG_INTERNAL && sentHandler) {
+        sentHandler(tag, ok, sentAt);
+    }
+}
+
+static void trackDepth() {
+    size_t depth = commandQueueDepth();
+    if (depth > cmdQueueStats.maxDepth) {
+        cmdQueueStats.maxDepth = depth;
+    }
+}
+
+// Queue a command
+bool queueCommand(const String& cmd, CommandPriority prio, unsigned long delayAfterMs, uint16_t tag) {
+    auto it = COMMANDS.find(cmd);
+    if (it == COMMANDS.end() || prio >= PRIO_COUNT) {
+        LOG_W(CMD, "QUEUE: Unknown command: %s", cmd.c_str());
+        return false;
+    }
+
+    CommandRing& ring = rings[prio];
+    if (ring.count >= CMD_QUEUE_CAPACITY) {
+        cmdQueueStats.dropped++;
+        LOG_W(CMD, "QUEUE: Full at priority %d, dropping %s", prio, cmd.c_str());
+        return false;
+    }
+
+    TraceId trace = traceClaimCurrent();
+    uint16_t wait = traceAsyncBegin(trace, "queue wait");
+    ring.items[(ring.head + ring.count) % CMD_QUEUE_CAPACITY] = {it->first.c_str(), delayAfterMs, tag, trace, wait};
+    ring.count++;
+    trackDepth();
+    coexBtActivity();
+    linkTrafficQueued(prio <= PRIO_VOLUME);
+    return true;
+}
+
+static void queueStatusRead(CommandPriority prio) {
+    if (pendingStatusPrio < PRIO_COUNT) {
+        cmdQueueStats.deduplicated++;
+        if (prio < pendingStatusPrio) {
+            pendingStatusPrio = prio;
+        }
+        return;
+    }
+    pendingStatusPrio = prio;
+    trackDepth();
+}
+
+// Queue a status read
+void queueStatusRequest(CommandPriority prio) {
+    // Only claimed with a slot to wait in; otherwise the handler scope finishes it
+    if (traceCurrent() != TRACE_NONE && statusTraceCount < CMD_STATUS_TRACE_SLOTS) {
+        TraceId trace = traceClaimCurrent();
+        statusTraces[statusTraceCount++] = {trace, traceAsyncBegin(trace, "status wait"), true};
+    }
+    queueStatusRead(prio);
+}
+
+void queueStatusRequest(CommandPriority prio, TraceId trace) {
+    if (trace != TRACE_NONE && statusTraceCount < CMD_STATUS_TRACE_SLOTS) {
+        statusTraces[statusTraceCount++] = {trace, traceAsyncBegin(trace, "status wait"), false};
+    }
+    queueStatusRead(prio);
+}
+
+void clearQueuedCommands(CommandPriority prio) {
+    if (prio >= PRIO_COUNT) {
+        return;
+    }
+    CommandRing& ring = rings[prio];
+    for (size_t i = 0; i < ring.count; i++) {
+        const QueuedCommand& item = ring.items[(ring.head + i) % CMD_QUEUE_CAPACITY];
+        traceAsyncEnd(item.trace, item.traceWait, "queue wait");
+    }
+    ring.head = 0;
+    ring.count = 0;
+}
+
+void clearQueuedCommands(CommandPriority prio, uint16_t tag) {
+    if (prio >= PRIO_COUNT) {
+        return;
+    }
+    // Compact the ring in place, keeping the order of what stays
+    CommandRing& ring = rings[prio];
+    size_t kept = 0;
+    for (size_t i = 0; i < ring.count; i++) {
+        const QueuedCommand& item = ring.items[(ring.head + i) % CMD_QUEUE_CAPACITY];
+        if (item.tag == tag) {
+            traceAsyncEnd(item.trace, item.traceWait, "queue wait");
+            continue;
+        }
+        ring.items[(ring.head + kept) % CMD_QUEUE_CAPACITY] = item;
+        kept++;
+    }
+    ring.count = kept;
+}
+
+// The pending read is gone (done or dropped); its traces are complete
+static void finishStatusTraces() {
+    for (size_t i = 0; i < statusTraceCount; i++) {
+        if (statusTraces[i].finish) traceFinish(statusTraces[i].trace);
+    }
+    statusTraceCount = 0;
+}
+
+void clearCommandQueue() {
+    for (int p = 0; p < PRIO_COUNT; p++) {
+        clearQueuedCommands((CommandPriority)p);
+    }
+    pendingStatusPrio = PRIO_COUNT;
+    holdUntil = 0;
+    for (size_t i = 0; i < statusTraceCount; i++) {
+        traceAsyncEnd(statusTraces[i].trace, statusTraces[i].wait, "status wait");
+    }
+    finishStatusTraces();
+}
+
+// Earliest time the next frame may go out
+static unsigned long nextFrameTime(bool isStatusRead) {
+    unsigned long gap = CMD_MIN_FRAME_GAP_MS;
+    if (isStatusRead && lastFrameWasCommand) {
+        gap = CMD_STATUS_SETTLE_MS;   // Let the soundbar apply the last command first
+    }
+    unsigned long next = lastFrameTime + gap;
+    return ((long)(holdUntil - next) > 0) ? holdUntil : next;
+}
+
+static void waitForFrameSlot(bool isStatusRead) {
+    unsigned long next = nextFrameTime(isStatusRead);
+    long wait = (long)(next - millis());
+    if (lastFrameTime != 0 && wait > 0) {
+        delay(wait);
+    }
+}
+
+// servesPending: this read is the queued one, so it completes the traces waiting on it
+static YasStatus doStatusRead(bool servesPending) {
+    TraceId traces[CMD_STATUS_TRACE_SLOTS + 1];
+    size_t traceCount = 0;
+    if (servesPending) {
+        for (size_t i = 0; i < statusTraceCount; i++) {
+            traceAsyncEnd(statusTraces[i].trace, statusTraces[i].wait, "status wait");
+            traces[traceCount++] = statusTraces[i].trace;
+        }
+    } else if (traceCurrent() != TRACE_NONE) {
+        traces[traceCount++] = traceCurrent();
+    }
+
+    // The steady-state poll is meant to stay off the heap; the heaptrace env checks it
+    heapWatchBegin();
+    for (size_t i = 0; i < traceCount; i++) traceBegin(traces[i], "status read");
+    YasStatus status = requestStatus();
+    for (size_t i = 0; i < traceCount; i++) traceEnd(traces[i], "status read");
+
+    lastFrameTime = millis();
+    lastFrameWasCommand = false;
+    holdUntil = 0;
+    cmdQueueStats.statusReads++;
+    if (status.valid) {
+        for (size_t i = 0; i < traceCount; i++) traceBegin(traces[i], "publish");
+        updateSoundbarStatus(status);
+        for (size_t i = 0; i < traceCount; i++) traceEnd(traces[i], "publish");
+    }
+    uint32_t allocs = heapWatchEnd();
+    if (allocs > 0) {
+        if (cmdQueueStats.statusReadAllocs == 0) {
+            LOG_W(CMD, "STATUS: Poll allocated %u times, see /debug/heap callers", (unsigned)allocs);
+        }
+        cmdQueueStats.statusReadAllocs += allocs;
+    }
+
+    if (servesPending) {
+        finishStatusTraces();
+    }
+    return status;
+}
+
+// Send at most one frame
+void processCommandQueue() {
+    // Under SPP congestion frames wait here rather than in the small TX hold queue
+    if (!btConnected || !btTxReady()) {
+        return;
+    }
+
+    // Highest non-empty command class
+    int best = PRIO_COUNT;
+    for (int p = 0; p < PRIO_COUNT; p++) {
+        if (rings[p].count > 0) {
+            best = p;
+            break;
+        }
+    }
+
+    // Within the same class, commands go before the read so it confirms them
+    bool statusFirst = pendingStatusPrio < best;
+    if (best == PRIO_COUNT && !statusFirst) {
+        return;
+    }
+
+    if (lastFrameTime != 0 && (long)(millis() - nextFrameTime(statusFirst)) < 0) {
+        return;
+    }
+
+    // A frame jumping ahead of lower-priority work that was queued first
+    int lowest = (int)pendingStatusPrio < PRIO_COUNT ? (int)pendingStatusPrio : -1;
+    for (int p = PRIO_COUNT - 1; p >= 0; p--) {
+        if (rings[p].count > 0) {
+            if (p > lowest) lowest = p;
+            break;
+        }
+    }
+    int sending = statusFirst ? (int)pendingStatusPrio : best;
+    if (lowest > sending) {
+        cmdQueueStats.preemptions++;
+    }
+
+    if (statusFirst) {
+        pendingStatusPrio = PRIO_COUNT;
+        doStatusRead(true);
+        return;
+    }
+
+    CommandRing& ring = rings[best];
+    QueuedCommand item = ring.items[ring.head];
+    ring.head = (ring.head + 1) % CMD_QUEUE_CAPACITY;
+    ring.count--;
+
+    traceAsyncEnd(item.trace, item.traceWait, "queue wait");
+    traceBegin(item.trace, item.cmd);
+    SendResult result = sendCommand(item.cmd, item.tag);
+    bool ok = result != SEND_FAILED;
+    traceEnd(item.trace, item.cmd);
+    flightRecord(FLIGHT_COMMAND, item.cmd, ok);
+    coexBtActivity();
+    lastFrameTime = millis();
+    lastFrameWasCommand = true;
+    holdUntil = item.delayAfterMs > 0 ? lastFrameTime + CMD_MIN_FRAME_GAP_MS + item.delayAfterMs : 0;
+    cmdQueueStats.framesSent++;
+
+    // A held frame is reported by the BT layer once it actually goes out
+    if (result != SEND_HELD) {
+        reportCommandSent(item.tag, ok, lastFrameTime);
+    }
+}
+
+// True when nothing at or above the given priority is waiting
+bool commandQueueIdle(CommandPriority upTo) {
+    if (pendingStatusPrio <= upTo) {
+        return false;
+    }
+    for (int p = 0; p <= upTo; p++) {
+        if (rings[p].count > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read status immediately, ahead of anything queued
+YasStatus queryStatusNow() {
+    traceBegin(traceCurrent(), "frame gap");
+    waitForFrameSlot(true);
+    traceEnd(traceCurrent(), "frame gap");
+
+    bool servesPending = false;
+    if (pendingStatusPrio < PRIO_COUNT && commandQueueDepth() == 1) {
+        // This read satisfies the queued one too (unless it is meant to confirm queued commands)
+        pendingStatusPrio = PRIO_COUNT;
+        cmdQueueStats.deduplicated++;
+        servesPending = true;
+    }
+    return doStatusRead(servesPending);
+}
@@ -0,0 +1,482 @@
+#include "debug.h"
+#include "flight_recorder.h"
+
+#include <atomic>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+// Bounded multi-producer / single-consumer ring (Vyukov). Each slot carries a
+// sequence number: seq == pos means free for the producer claiming pos,
+// seq == pos + 1 means filled and ready for the drain task.
+
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+static_assert((LOG_RING_SIZE & LOG_RING_MASK) == 0, "LOG_RING_SIZE must be a power of two");
+
+LogStats logStats;
+
+// Indexed by LogModule
+uint8_t logLevels[LOG_MOD_COUNT] = {
+    LOG_LEVEL_SYS, LOG_LEVEL_BT, LOG_LEVEL_MQTT, LOG_LEVEL_HTTP, LOG_LEVEL_CMD, LOG_LEVEL_WIFI
+};
+static const uint8_t compiledLevels[LOG_MOD_COUNT] = {
+    LOG_LEVEL_SYS, LOG_LEVEL_BT, LOG_LEVEL_MQTT, LOG_LEVEL_HTTP, LOG_LEVEL_CMD, LOG_LEVEL_WIFI
+};
+static const char* const moduleNames[LOG_MOD_COUNT] = {"sys", "bt", "mqtt", "http", "cmd", "wifi"};
+static const char* const levelNames[] = {"none", "error", "warn", "info", "debug", "verbose"};
+
+static LogRecord records[LOG_RING_SIZE];
+static std::atomic<uint32_t> seqs[LOG_RING_SIZE];
+static std::atomic<uint32_t> enqueuePos{0};
+static uint32_t dequeuePos = 0;                   // Drain task only
+static std::atomic<uint32_t> droppedCount{0};
+static std::atomic<uint32_t> truncatedCount{0};
+static TaskHandle_t drainTask = nullptr;
+
+LogRecord* logBegin(uint8_t level, const char* fmt) {
+    if (!drainTask) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        uint32_t seq = seqs[pos & LOG_RING_MASK].load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Drain task hasn't caught up - never wait for the UART
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    LogRecord* rec = &records[pos & LOG_RING_MASK];
+    rec->timestamp = millis();
+    rec->fmt = fmt;
+    rec->level = level;
+    rec->argCount = 0;
+    rec->strUsed = 0;
+    rec->truncated = false;
+    return rec;
+}
+
+void logCommit(LogRecord* rec) {
+    if (rec->truncated) {
+        truncatedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::atomic<uint32_t>& seq = seqs[rec - records];
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Expand one record into line, printf-style, one conversion at a time
+static size_t formatRecord(const LogRecord& rec, char* line, size_t size) {
+    unsigned long ms = rec.timestamp;
+    unsigned long sec = ms / 1000;
+    unsigned long min = sec / 60;
+    size_t len = snprintf(line, size, "[%02lu:%02lu.%03lu] ", min % 60, sec % 60, ms % 1000);
+
+    uint8_t argIndex = 0;
+    const char* p = rec.fmt;
+    while (*p && len < size - 1) {
+        if (*p != '%') {
+            line[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            line[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // Copy flags, width and precision; drop length modifiers, we know the real type
+        char spec[16];
+        size_t specLen = 0;
+        spec[specLen++] = *p++;
+        while (*p && strchr("-+ #0123456789.", *p) && specLen < sizeof(spec) - 4) {
+            spec[specLen++] = *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            p++;
+        }
+        char conv = *p ? *p++ : 's';
+
+        if (argIndex >= rec.argCount) {
+            break;
+        }
+        const LogArg& a = rec.args[argIndex++];
+        size_t room = size - len;
+        int n = 0;
+
+        switch (conv) {
+            case 'c': {
+                spec[specLen++] = 'c';
+                spec[specLen] = '\0';
+                n = snprintf(line + len, room, spec, (int)a.i);
+                break;
+            }
+            case 'd': case 'i': {
+                spec[specLen++] = 'l';
+                spec[specLen++] = 'l';
+                spec[specLen++] = 'd';
+                spec[specLen] = '\0';
+                long long v = a.type == LogArg::DOUBLE ? (long long)a.d : a.i;
+                n = snprintf(line + len, room, spec, v);
+                break;
+            }
+            case 'u': case 'x': case 'X': case 'o': {
+                spec[specLen++] = 'l';
+                spec[specLen++] = 'l';
+                spec[specLen++] = conv;
+                spec[specLen] = '\0';
+                unsigned long long v = a.type == LogArg::DOUBLE ? (unsigned long long)a.d : a.u;
+                if (a.type == LogArg::INT && a.size < sizeof(v)) {
+                    v &= (1ULL << (a.size * 8)) - 1;   // -1 as %x prints ffffffff, not 16 f's
+                }
+                n = snprintf(line + len, room, spec, v);
+                break;
+            }
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+                spec[specLen++] = conv;
+                spec[specLen] = '\0';
+                double v = a.type == LogArg::DOUBLE ? a.d : a.type == LogArg::INT ? (double)a.i : (double)a.u;
+                n = snprintf(line + len, room, spec, v);
+                break;
+            }
+            case 's': {
+                spec[specLen++] = 's';
+                spec[specLen] = '\0';
+                n = snprintf(line + len, room, spec, a.type == LogArg::STR ? rec.strings + a.str : "?");
+                break;
+            }
+            case 'p': {
+                n = snprintf(line + len, room, "%p", a.p);
+                break;
+            }
+            default:
+                n = snprintf(line + len, room, "<%%%c?>", conv);
+                break;
+        }
+        if (n > 0) {
+            len += ((size_t)n < room) ? n : room - 1;
+        }
+    }
+
+    if (rec.truncated && len + 4 < size) {
+        memcpy(line + len, " ...", 4);
+        len += 4;
+    }
+    if (len > size - 2) {
+        len = size - 2;
+    }
+    line[len++] = '\n';
+    line[len] = '\0';
+    return len;
+}
+
+// ----------------------------------------------------------------------------
+// History - formatted lines in a byte ring, each stored as [seq:4][len:2][text]
+// Written by the drain task, read by HTTP handlers; the mutex covers both.
+// ----------------------------------------------------------------------------
+
+#define HISTORY_ENTRY_HEADER 6
+
+static char history[LOG_HISTORY_BYTES];
+static size_t historyHead = 0;        // Next write offset
+static size_t historyTail = 0;        // Oldest entry
+static size_t historyUsed = 0;
+static uint32_t historySeq = 0;       // Seq of the newest line
+static SemaphoreHandle_t historyMutex = nullptr;
+
+static void historyCopyIn(size_t offset, const void* data, size_t len) {
+    const char* src = (const char*)data;
+    for (size_t i = 0; i < len; i++) {
+        history[(offset + i) % LOG_HISTORY_BYTES] = src[i];
+    }
+}
+
+static void historyCopyOut(size_t offset, void* data, size_t len) {
+    char* dst = (char*)data;
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = history[(offset + i) % LOG_HISTORY_BYTES];
+    }
+}
+
+static void historyAppend(const char* text, size_t len) {
+    if (len > 0 && text[len - 1] == '\n') len--;
+    uint16_t len16 = len;
+    size_t needed = HISTORY_ENTRY_HEADER + len;
+    if (needed > LOG_HISTORY_BYTES) return;
+
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    while (LOG_HISTORY_BYTES - historyUsed < needed) {
+        uint16_t oldLen;
+        historyCopyOut(historyTail + 4, &oldLen, sizeof(oldLen));
+        size_t oldSize = HISTORY_ENTRY_HEADER + oldLen;
+        historyTail = (historyTail + oldSize) % LOG_HISTORY_BYTES;
+        historyUsed -= oldSize;
+    }
+    historySeq++;
+    historyCopyIn(historyHead, &historySeq, 4);
+    historyCopyIn(historyHead + 4, &len16, 2);
+    historyCopyIn(historyHead + HISTORY_ENTRY_HEADER, text, len);
+    historyHead = (historyHead + needed) % LOG_HISTORY_BYTES;
+    historyUsed += needed;
+    xSemaphoreGive(historyMutex);
+}
+
+// Lines are copied out a few at a time and visited with the mutex released, so
+// a visitor building JSON never holds up the drain task
+uint32_t logHistoryForEach(uint32_t since, LogLineVisitor visit) {
+    if (!historyMutex) return 0;
+
+    struct CopiedLine {
+        uint32_t seq;
+        uint16_t len;
+        uint16_t at;
+    };
+    char text[2 * LOG_LINE_BYTES];
+    CopiedLine copied[16];
+    uint32_t first = 0;
+    uint32_t cursor = since;
+
+    for (;;) {
+        size_t count = 0;
+        size_t used = 0;
+        xSemaphoreTake(historyMutex, portMAX_DELAY);
+        size_t offset = historyTail;
+        size_t remaining = historyUsed;
+        while (remaining > 0 && count < sizeof(copied) / sizeof(copied[0])) {
+            uint32_t seq;
+            uint16_t len;
+            historyCopyOut(offset, &seq, 4);
+            historyCopyOut(offset + 4, &len, 2);
+            if (first == 0) first = seq;
+
+            if (seq > cursor) {
+                size_t n = len < LOG_LINE_BYTES ? len : LOG_LINE_BYTES - 1;
+                if (used + n + 1 > sizeof(text)) break;
+                historyCopyOut(offset + HISTORY_ENTRY_HEADER, text + used, n);
+                text[used + n] = '\0';
+                copied[count++] = {seq, (uint16_t)n, (uint16_t)used};
+                used += n + 1;
+            }
+            offset = (offset + HISTORY_ENTRY_HEADER + len) % LOG_HISTORY_BYTES;
+            remaining -= HISTORY_ENTRY_HEADER + len;
+        }
+        xSemaphoreGive(historyMutex);
+
+        if (count == 0) return first;
+        for (size_t i = 0; i < count; i++) {
+            if (!visit(copied[i].seq, text + copied[i].at, copied[i].len)) return first;
+            cursor = copied[i].seq;
+        }
+    }
+}
+
+uint32_t logHistoryLastSeq() {
+    return historySeq;
+}
+
+// ----------------------------------------------------------------------------
+// UDP syslog - non-blocking sendto, token bucket so a failure loop can't flood WiFi
+// ----------------------------------------------------------------------------
+
+static int syslogFd = -1;
+static struct sockaddr_in syslogAddr;
+static uint32_t syslogTokens = SYSLOG_BURST * 1000;   // In 1/1000 lines
+static unsigned long syslogLastRefill = 0;
+static uint32_t syslogSuppressedReported = 0;
+
+static bool syslogInit() {
+    if (syslogFd >= 0) return true;
+    if (strlen(SYSLOG_HOST) == 0 || !WiFi.isConnected()) return false;
+
+    memset(&syslogAddr, 0, sizeof(syslogAddr));
+    syslogAddr.sin_family = AF_INET;
+    syslogAddr.sin_port = htons(SYSLOG_PORT);
+    if (inet_aton(SYSLOG_HOST, &syslogAddr.sin_addr) == 0) return false;
+
+    syslogFd = socket(AF_INET, SOCK_DGRAM, 0);
+    return syslogFd >= 0;
+}
+
+static bool syslogTake() {
+    unsigned long now = millis();
+    syslogTokens += (now - syslogLastRefill) * SYSLOG_RATE_PER_SEC;
+    syslogLastRefill = now;
+    if (syslogTokens > SYSLOG_BURST * 1000) {
+        syslogTokens = SYSLOG_BURST * 1000;
+    }
+    if (syslogTokens < 1000) return false;
+    syslogTokens -= 1000;
+    return true;
+}
+
+static void syslogSend(uint8_t level, const char* text, size_t len) {
+    if (!syslogInit()) return;
+
+    // RFC 3164 style, facility local0; the text already carries our uptime stamp
+    static const uint8_t severity[] = {7, 3, 4, 6, 7, 7};
+    char packet[LOG_LINE_BYTES + 32];
+    int n;
+
+    // The summary is a packet like any other and takes a token of its own
+    uint32_t suppressed = logStats.syslogSuppressed - syslogSuppressedReported;
+    if (suppressed > 0 && syslogTake()) {
+        n = snprintf(packet, sizeof(packet), "<%u>%s: [log] %lu lines suppressed by rate limit",
+                     16 * 8 + 4, BT_DEVICE_NAME, (unsigned long)suppressed);
+        sendto(syslogFd, packet, n, MSG_DONTWAIT, (struct sockaddr*)&syslogAddr, sizeof(syslogAddr));
+        syslogSuppressedReported = logStats.syslogSuppressed;
+    }
+
+    if (!syslogTake()) {
+        logStats.syslogSuppressed++;
+        return;
+    }
+
+    if (len > 0 && text[len - 1] == '\n') len--;
+    n = snprintf(packet, sizeof(packet), "<%u>%s: %.*s", 16 * 8 + severity[level <= LOG_LEVEL_VERBOSE ? level : 0],
+                 BT_DEVICE_NAME, (int)len, text);
+    if (sendto(syslogFd, packet, n, MSG_DONTWAIT, (struct sockaddr*)&syslogAddr, sizeof(syslogAddr)) < 0) {
+        logStats.syslogSuppressed++;   // No buffer space - drop rather than wait
+        return;
+    }
+    logStats.syslogSent++;
+}
+
+// Every formatted line goes to the UART, the history and syslog; warnings and
+// errors are also kept by the flight recorder
+static void emitLine(uint8_t level, const char* line, size_t len) {
+    // Only this task blocks on the UART
+    Serial.write((const uint8_t*)line, len);
+    historyAppend(line, len);
+    syslogSend(level, line, len);
+    if (level != LOG_LEVEL_NONE && level <= LOG_LEVEL_WARN) {
+        flightRecordLogLine(line, len);
+    }
+}
+
+static void drainLog(void*) {
+    char line[LOG_LINE_BYTES];
+    uint32_t reportedDrops = 0;
+
+    for (;;) {
+        bool wrote = false;
+        for (;;) {
+            uint32_t index = dequeuePos & LOG_RING_MASK;
+            if (seqs[index].load(std::memory_order_acquire) != dequeuePos + 1) {
+                break;
+            }
+            LogRecord& rec = records[index];
+
+            uint32_t used = enqueuePos.load(std::memory_order_relaxed) - dequeuePos;
+            if (used > logStats.maxUsed) {
+                logStats.maxUsed = used;
+            }
+
+            size_t len = formatRecord(rec, line, sizeof(line));
+            uint8_t level = rec.level;
+            seqs[index].store(dequeuePos + LOG_RING_SIZE, std::memory_order_release);
+            dequeuePos++;
+            logStats.recorded++;
+
+            emitLine(level, line, len);
+            wrote = true;
+        }
+
+        uint32_t dropped = droppedCount.load(std::memory_order_relaxed);
+        logStats.dropped = dropped;
+        logStats.truncated = truncatedCount.load(std::memory_order_relaxed);
+        if (dropped != reportedDrops) {
+            int len = snprintf(line, sizeof(line), "[log] %lu lines dropped (ring full)\n",
+                               (unsigned long)(dropped - reportedDrops));
+            emitLine(LOG_LEVEL_WARN, line, len);
+            reportedDrops = dropped;
+        }
+
+        if (!wrote) {
+            vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+        }
+    }
+}
+
+void initLogging() {
+    if (drainTask) {
+        return;
+    }
+    for (uint32_t i = 0; i < LOG_RING_SIZE; i++) {
+        seqs[i].store(i, std::memory_order_relaxed);
+    }
+    historyMutex = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(drainLog, "log", LOG_DRAIN_STACK_SIZE, nullptr,
+                            LOG_DRAIN_TASK_PRIORITY, &drainTask, tskNO_AFFINITY);
+}
+
+void logFlush(unsigned long timeoutMs) {
+    unsigned long start = millis();
+    while (drainTask && millis() - start < timeoutMs) {
+        if (seqs[dequeuePos & LOG_RING_MASK].load(std::memory_order_acquire) != dequeuePos + 1) {
+            Serial.flush();
+            return;
+        }
+        delay(5);
+    }
+}
+
+const char* logModuleName(LogModule mod) {
+    return mod < LOG_MOD_COUNT ? moduleNames[mod] : "?";
+}
+
+const char* logLevelName(uint8_t level) {
+    return level <= LOG_LEVEL_VERBOSE ? levelNames[level] : "?";
+}
+
+static int parseLogLevel(const String& name) {
+    for (int i = 0; i <= LOG_LEVEL_VERBOSE; i++) {
+        if (name.equalsIgnoreCase(levelNames[i])) return i;
+    }
+    return -1;
+}
+
+// "bt:debug,cmd:warn" - all entries are checked before any is applied
+bool setLogLevels(const String& spec) {
+    uint8_t levels[LOG_MOD_COUNT];
+    memcpy(levels, logLevels, sizeof(levels));
+
+    int start = 0;
+    while (start < (int)spec.length()) {
+        int end = spec.indexOf(',', start);
+        if (end < 0) end = spec.length();
+        String entry = spec.substring(start, end);
+        entry.trim();
+        start = end + 1;
+        if (entry.length() == 0) continue;
+
+        int colon = entry.indexOf(':');
+        if (colon < 0) return false;
+        String modName = entry.substring(0, colon);
+        int level = parseLogLevel(entry.substring(colon + 1));
+        if (level < 0) return false;
+
+        bool matched = false;
+        for (int m = 0; m < LOG_MOD_COUNT; m++) {
+            if (modName.equalsIgnoreCase("all") || modName.equalsIgnoreCase(moduleNames[m])) {
+                // Can't raise above what was compiled in
+                levels[m] = level < compiledLevels[m] ? level : compiledLevels[m];
+                matched = true;
+            }
+        }
+        if (!matched) return false;
+    }
+
+    memcpy(logLevels, levels, sizeof(levels));
+    return true;
+}
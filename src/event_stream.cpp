@@ -0,0 +1,218 @@
+#include "event_stream.h"
+#include "state.h"
+#include "config.h"
+#include "debug.h"
+#include "command_queue.h"
+#include "json_arena.h"
+
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include <errno.h>
+#include <lwip/sockets.h>
+
+EventStreamStats eventStats;
+
+// Pending event kinds - a flag per kind, so only the latest state is ever sent
+enum : uint8_t {
+    EVT_STATE = 1 << 0,
+    EVT_BT_STATUS = 1 << 1,
+    EVT_METRICS = 1 << 2,
+    EVT_KEEPALIVE = 1 << 3
+};
+
+struct EventSubscriber {
+    bool active = false;
+    int fd = -1;
+    uint8_t pending = 0;
+    unsigned long lastSend = 0;
+    char out[EVENTS_CLIENT_BUFFER_SIZE];   // Unsent tail of the message in flight
+    size_t outLen = 0;
+    size_t outPos = 0;
+};
+
+static EventSubscriber subscribers[EVENTS_MAX_SUBSCRIBERS];
+static unsigned long lastMetricsEvent = 0;
+
+size_t eventSubscriberCount() {
+    size_t count = 0;
+    for (const EventSubscriber& sub : subscribers) {
+        if (sub.active) count++;
+    }
+    return count;
+}
+
+static void markPending(uint8_t kind) {
+    for (EventSubscriber& sub : subscribers) {
+        if (!sub.active) continue;
+        if (sub.pending & kind) {
+            eventStats.eventsCoalesced++;
+        }
+        sub.pending |= kind;
+    }
+}
+
+void notifyStateChanged() {
+    markPending(EVT_STATE);
+}
+
+void notifyBtStatusChanged() {
+    markPending(EVT_BT_STATUS);
+}
+
+// Take over a detached HTTP socket as a subscriber
+bool addEventSubscriber(int fd) {
+    for (EventSubscriber& sub : subscribers) {
+        if (sub.active) continue;
+
+        // Response head goes out as the first message
+        sub.outLen = snprintf(sub.out, sizeof(sub.out),
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/event-stream\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: keep-alive\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "\r\n"
+            "retry: 5000\n\n");
+        sub.outPos = 0;
+        sub.active = true;
+        sub.fd = fd;
+        sub.lastSend = millis();
+        // New subscribers get a full snapshot straight away
+        sub.pending = EVT_BT_STATUS | EVT_METRICS | (lastSoundbarStatus.valid ? EVT_STATE : 0);
+
+        eventStats.subscribersAccepted++;
+        LOG_D(HTTP, "EVENTS: Subscriber added (%d active)", (int)eventSubscriberCount());
+        return true;
+    }
+
+    static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                               "Content-Type: application/json\r\n"
+                               "Content-Length: 38\r\nConnection: close\r\n\r\n"
+                               "{\"error\":\"Too many event subscribers\"}";
+    send(fd, busy, sizeof(busy) - 1, MSG_DONTWAIT);
+    close(fd);
+    eventStats.subscribersRejected++;
+    return false;
+}
+
+// Format one SSE message into buf
+static size_t formatEvent(uint8_t kind, char* buf, size_t size) {
+    ArenaJsonDocument doc;
+    const char* name;
+    unsigned long id = 0;
+
+    if (kind == EVT_KEEPALIVE) {
+        return snprintf(buf, size, ": keepalive\n\n");
+    }
+
+    if (kind == EVT_STATE) {
+        name = "state";
+        id = statusVersion;
+        doc["power"] = lastSoundbarStatus.power;
+        doc["input"] = lastSoundbarStatus.input.c_str();
+        doc["muted"] = lastSoundbarStatus.muted;
+        doc["volume"] = lastSoundbarStatus.volume;
+        doc["subwoofer"] = lastSoundbarStatus.subwoofer;
+        doc["surround"] = lastSoundbarStatus.surround.c_str();
+        doc["bass_ext"] = lastSoundbarStatus.bass_ext;
+        doc["clear_voice"] = lastSoundbarStatus.clear_voice;
+        doc["version"] = statusVersion;
+    } else if (kind == EVT_BT_STATUS) {
+        name = "bt_status";
+        doc["status"] = lastBtStatus.c_str();
+        doc["connected"] = btConnected;
+    } else {
+        name = "metrics";
+        doc["uptime_ms"] = millis();
+        doc["free_heap"] = ESP.getFreeHeap();
+        doc["wifi_rssi"] = WiFi.RSSI();
+        doc["queue_depth"] = commandQueueDepth();
+        doc["bt_bytes_sent"] = btStats.bytesSent;
+        doc["bt_bytes_received"] = btStats.bytesReceived;
+        doc["bt_disconnects"] = btStats.disconnects;
+        doc["subscribers"] = eventSubscriberCount();
+    }
+
+    int len = (id > 0)
+        ? snprintf(buf, size, "event: %s\nid: %lu\ndata: ", name, id)
+        : snprintf(buf, size, "event: %s\ndata: ", name);
+    if (len < 0 || (size_t)len >= size) return 0;
+
+    size_t jsonLen = serializeJson(doc, buf + len, size - len);
+    len += jsonLen;
+    if ((size_t)len + 3 > size) return 0;
+    buf[len++] = '\n';
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+// Write as much of the in-flight message as the socket takes without blocking
+static bool flushSubscriber(EventSubscriber& sub) {
+    while (sub.outPos < sub.outLen) {
+        int sent = send(sub.fd, sub.out + sub.outPos, sub.outLen - sub.outPos, MSG_DONTWAIT);
+        if (sent > 0) {
+            sub.outPos += sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;   // Backpressure - try again next loop
+        } else {
+            return false;  // Socket error
+        }
+    }
+    sub.outLen = 0;
+    sub.outPos = 0;
+    return true;
+}
+
+// Peer hung up? Anything the client sends on an event stream is discarded.
+static bool subscriberConnected(EventSubscriber& sub) {
+    char scratch[32];
+    int n = recv(sub.fd, scratch, sizeof(scratch), MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+static void dropSubscriber(EventSubscriber& sub) {
+    close(sub.fd);
+    sub.fd = -1;
+    sub.active = false;
+    sub.pending = 0;
+    LOG_D(HTTP, "EVENTS: Subscriber removed (%d active)", (int)eventSubscriberCount());
+}
+
+// Flush pending events, send periodic metrics and keepalives
+void serviceEventStreams() {
+    if (millis() - lastMetricsEvent >= EVENTS_METRICS_INTERVAL_MS) {
+        lastMetricsEvent = millis();
+        markPending(EVT_METRICS);
+    }
+
+    for (EventSubscriber& sub : subscribers) {
+        if (!sub.active) continue;
+
+        if (!subscriberConnected(sub) || !flushSubscriber(sub)) {
+            dropSubscriber(sub);
+            continue;
+        }
+
+        if (sub.pending == 0 && millis() - sub.lastSend >= EVENTS_KEEPALIVE_MS) {
+            sub.pending |= EVT_KEEPALIVE;
+        }
+
+        // Only start a new message once the previous one is fully out
+        while (sub.outLen == 0 && sub.pending != 0) {
+            uint8_t kind = sub.pending & (uint8_t)-sub.pending;   // Lowest set bit
+            sub.pending &= ~kind;
+
+            sub.outLen = formatEvent(kind, sub.out, sizeof(sub.out));
+            sub.outPos = 0;
+            if (sub.outLen == 0) continue;
+
+            sub.lastSend = millis();
+            eventStats.eventsSent++;
+            if (!flushSubscriber(sub)) {
+                dropSubscriber(sub);
+                break;
+            }
+        }
+    }
+}
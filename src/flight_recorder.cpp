@@ -0,0 +1,199 @@
+#include "flight_recorder.h"
+#include "config.h"
+#include "state.h"
+#include "command_queue.h"
+#include "mqtt_client.h"
+
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+
+// Sizes are mixed in so a record left by a build with a different layout is ignored
+static const uint32_t FLIGHT_MAGIC = 0x464C5232 ^ (uint32_t)(FLIGHT_RECORDER_EVENTS << 16) ^ FLIGHT_LOG_BYTES;
+
+struct FlightLog {
+    uint32_t magic;
+    uint32_t bootCount;
+    uint32_t eventHead;                   // Next slot to write
+    uint32_t eventCount;
+    uint32_t logPos;                      // Bytes ever written to the log ring
+    FlightCounters counters;
+    FlightEvent events[FLIGHT_RECORDER_EVENTS];
+    char log[FLIGHT_LOG_BYTES];
+};
+
+// Left alone by the bootloader and startup code on anything short of a power cycle
+RTC_NOINIT_ATTR static FlightLog rtcLog;
+
+// The previous boot, copied out before this one starts writing
+static FlightCounters previousCounters;
+static FlightEvent previousEvents[FLIGHT_RECORDER_EVENTS];
+static size_t previousEventCount = 0;
+static char previousLog[FLIGHT_LOG_BYTES];
+static size_t previousLogLength = 0;
+static bool previousValid = false;
+
+static portMUX_TYPE eventMux = portMUX_INITIALIZER_UNLOCKED;
+static esp_reset_reason_t resetReason = ESP_RST_UNKNOWN;
+static unsigned long lastCheckpoint = 0;
+
+static const char* const eventNames[] = {
+    "?", "boot", "bt_status", "command", "loop_stall", "heap_min", "heap_block", "wifi", "mqtt", "restart",
+    "supervisor"
+};
+
+const char* flightEventName(uint8_t type) {
+    return type < sizeof(eventNames) / sizeof(eventNames[0]) ? eventNames[type] : "?";
+}
+
+static bool recordValid(const FlightLog& log) {
+    return log.magic == FLIGHT_MAGIC &&
+           log.eventHead < FLIGHT_RECORDER_EVENTS &&
+           log.eventCount <= FLIGHT_RECORDER_EVENTS;
+}
+
+// Unroll the log ring, dropping the line the oldest byte falls into
+static void copyPreviousLog() {
+    size_t size = sizeof(rtcLog.log);
+    size_t start = 0;
+    size_t length = rtcLog.logPos;
+    if (rtcLog.logPos > size) {
+        start = rtcLog.logPos % size;
+        length = size;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        previousLog[i] = rtcLog.log[(start + i) % size];
+    }
+
+    size_t skip = 0;
+    if (rtcLog.logPos > size) {
+        while (skip < length && previousLog[skip] != '\n') skip++;
+        if (skip < length) skip++;
+    }
+    memmove(previousLog, previousLog + skip, length - skip);
+    previousLogLength = length - skip;
+}
+
+void initFlightRecorder() {
+    resetReason = esp_reset_reason();
+
+    uint32_t bootCount = 1;
+    // Power-on leaves RTC memory random; never trust it even if the magic happens to match
+    if (resetReason != ESP_RST_POWERON && recordValid(rtcLog)) {
+        previousValid = true;
+        bootCount = rtcLog.bootCount + 1;
+        previousCounters = rtcLog.counters;
+
+        size_t first = (rtcLog.eventHead + FLIGHT_RECORDER_EVENTS - rtcLog.eventCount) % FLIGHT_RECORDER_EVENTS;
+        for (size_t i = 0; i < rtcLog.eventCount; i++) {
+            previousEvents[i] = rtcLog.events[(first + i) % FLIGHT_RECORDER_EVENTS];
+        }
+        previousEventCount = rtcLog.eventCount;
+        copyPreviousLog();
+    }
+
+    memset(&rtcLog, 0, sizeof(rtcLog));
+    rtcLog.bootCount = bootCount;
+    rtcLog.magic = FLIGHT_MAGIC;
+
+    flightRecord(FLIGHT_BOOT, flightResetReason(), resetReason);
+}
+
+void flightRecord(FlightEventType type, const char* text, int32_t value) {
+    portENTER_CRITICAL(&eventMux);
+    FlightEvent& e = rtcLog.events[rtcLog.eventHead];
+    e.timeMs = millis();
+    e.value = value;
+    e.type = type;
+    if (text) {
+        strncpy(e.text, text, sizeof(e.text) - 1);
+        e.text[sizeof(e.text) - 1] = '\0';
+    } else {
+        e.text[0] = '\0';
+    }
+    rtcLog.eventHead = (rtcLog.eventHead + 1) % FLIGHT_RECORDER_EVENTS;
+    if (rtcLog.eventCount < FLIGHT_RECORDER_EVENTS) rtcLog.eventCount++;
+    portEXIT_CRITICAL(&eventMux);
+}
+
+void flightRecordLogLine(const char* line, size_t len) {
+    // Drain task only, so the ring needs no lock
+    size_t size = sizeof(rtcLog.log);
+    if (len > size) {
+        line += len - size;
+        len = size;
+    }
+    for (size_t i = 0; i < len; i++) {
+        rtcLog.log[(rtcLog.logPos + i) % size] = line[i];
+    }
+    rtcLog.logPos += len;
+}
+
+void flightLoop(unsigned long loopUs) {
+    uint32_t loopMs = loopUs / 1000;
+    if (loopMs > rtcLog.counters.loopMaxMs) {
+        rtcLog.counters.loopMaxMs = loopMs;
+    }
+    if (loopMs >= FLIGHT_LOOP_STALL_MS) {
+        flightRecord(FLIGHT_LOOP_STALL, nullptr, loopMs);
+    }
+
+    unsigned long now = millis();
+    if (now - lastCheckpoint < FLIGHT_CHECKPOINT_MS) {
+        return;
+    }
+    lastCheckpoint = now;
+
+    FlightCounters& c = rtcLog.counters;
+    c.uptimeMs = now;
+    c.btConnectAttempts = btStats.connectAttempts;
+    c.btConnectFailures = btStats.connectFailures;
+    c.btDisconnects = btStats.disconnects;
+    c.btBytesSent = btStats.bytesSent;
+    c.btBytesReceived = btStats.bytesReceived;
+    c.framesSent = cmdQueueStats.framesSent;
+    c.mqttConnects = mqttStats.connects;
+    c.minFreeHeap = ESP.getMinFreeHeap();
+}
+
+uint32_t flightBootCount() {
+    return rtcLog.bootCount;
+}
+
+const char* flightResetReason() {
+    switch (resetReason) {
+        case ESP_RST_POWERON: return "power_on";
+        case ESP_RST_EXT: return "external";
+        case ESP_RST_SW: return "software";
+        case ESP_RST_PANIC: return "panic";
+        case ESP_RST_INT_WDT: return "interrupt_wdt";
+        case ESP_RST_TASK_WDT: return "task_wdt";
+        case ESP_RST_WDT: return "other_wdt";
+        case ESP_RST_DEEPSLEEP: return "deep_sleep";
+        case ESP_RST_BROWNOUT: return "brownout";
+        case ESP_RST_SDIO: return "sdio";
+        default: return "unknown";
+    }
+}
+
+bool lastBootAvailable() {
+    return previousValid;
+}
+
+const FlightCounters& lastBootCounters() {
+    return previousCounters;
+}
+
+size_t lastBootEventCount() {
+    return previousEventCount;
+}
+
+const FlightEvent& lastBootEventAt(size_t i) {
+    return previousEvents[i < previousEventCount ? i : 0];
+}
+
+const char* lastBootLog(size_t& length) {
+    length = previousLogLength;
+    return previousLog;
+}
@@ -0,0 +1,264 @@
+#include "heap_monitor.h"
+#include "config.h"
+#include "debug.h"
+#include "flight_recorder.h"
+
+#include <freertos/FreeRTOS.h>
+
+// ----------------------------------------------------------------------------
+// Allocator wrappers
+// ----------------------------------------------------------------------------
+
+// Updated from every task; relaxed atomics, the counts only need to add up
+static uint32_t allocCount = 0;
+static uint32_t freeCount = 0;
+static uint32_t reallocCount = 0;
+static uint32_t failedCount = 0;
+
+static inline void countUp(uint32_t& counter) {
+    __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+}
+
+// Set by heapWatchBegin(); only the watched task ever adds to watchedAllocs
+static TaskHandle_t watchedTask = nullptr;
+static uint32_t watchedAllocs = 0;
+
+static inline void countWatched() {
+    if (watchedTask && xTaskGetCurrentTaskHandle() == watchedTask) {
+        watchedAllocs++;
+    }
+}
+
+#if defined(HEAP_TRACK_ALLOCS) && defined(HEAP_TRACK_CALLERS)
+struct HeapCaller {
+    uint32_t pc;
+    uint32_t count;
+    uint32_t bytes;
+};
+
+static HeapCaller callers[HEAP_CALLER_SLOTS];
+static uint32_t callersOverflow = 0;
+static portMUX_TYPE callerMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Open addressing on the return address; entries are never removed
+static void countCaller(void* ret, size_t size) {
+    // Windowed ABI keeps the call size in the top two bits of the return address
+    uint32_t pc = ((uint32_t)(uintptr_t)ret & 0x3FFFFFFF) | 0x40000000;
+    uint32_t slot = (pc >> 2) % HEAP_CALLER_SLOTS;
+
+    portENTER_CRITICAL(&callerMux);
+    for (uint32_t probe = 0; probe < HEAP_CALLER_SLOTS; probe++) {
+        HeapCaller& c = callers[(slot + probe) % HEAP_CALLER_SLOTS];
+        if (c.pc == pc || c.pc == 0) {
+            c.pc = pc;
+            c.count++;
+            c.bytes += size;
+            portEXIT_CRITICAL(&callerMux);
+            return;
+        }
+    }
+    callersOverflow++;
+    portEXIT_CRITICAL(&callerMux);
+}
+#define COUNT_CALLER(size) countCaller(__builtin_return_address(0), size)
+#else
+#define COUNT_CALLER(size) do {} while (0)
+#endif
+
+#ifdef HEAP_TRACK_ALLOCS
+// Linked with -Wl,--wrap=malloc etc., so every malloc in the image lands here
+// first, including String, operator new and the IDF components
+extern "C" {
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    void* p = __real_malloc(size);
+    countUp(p ? allocCount : failedCount);
+    countWatched();
+    COUNT_CALLER(size);
+    return p;
+}
+
+void __wrap_free(void* ptr) {
+    if (ptr) countUp(freeCount);
+    __real_free(ptr);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    void* p = __real_calloc(n, size);
+    countUp(p ? allocCount : failedCount);
+    countWatched();
+    COUNT_CALLER(n * size);
+    return p;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    void* p = __real_realloc(ptr, size);
+    if (!ptr) {
+        countUp(p ? allocCount : failedCount);
+    } else if (size == 0) {
+        countUp(freeCount);
+    } else {
+        countUp(p ? reallocCount : failedCount);
+    }
+    if (size > 0) {
+        countWatched();
+        COUNT_CALLER(size);
+    }
+    return p;
+}
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Sampling
+// ----------------------------------------------------------------------------
+
+static HeapSample history[HEAP_HISTORY_SAMPLES];
+static size_t historyHead = 0;
+static size_t historyCount = 0;
+static unsigned long lastCheck = 0;
+static unsigned long lastSample = 0;
+static uint32_t minLargestBlock = UINT32_MAX;
+static bool lowBlockWarned = false;
+static uint32_t recordedMinFree = UINT32_MAX;
+
+HeapSnapshot heapSnapshot() {
+    HeapSnapshot s;
+    s.freeBytes = ESP.getFreeHeap();
+    s.minFreeBytes = ESP.getMinFreeHeap();
+    s.largestBlock = ESP.getMaxAllocHeap();
+    s.minLargestBlock = minLargestBlock < s.largestBlock ? minLargestBlock : s.largestBlock;
+    s.fragmentationPct = s.freeBytes > 0 && s.largestBlock <= s.freeBytes ?
+        100 - (uint8_t)((uint64_t)s.largestBlock * 100 / s.freeBytes) : 0;
+    return s;
+}
+
+HeapCounters heapCounters() {
+    HeapCounters c;
+    c.allocs = __atomic_load_n(&allocCount, __ATOMIC_RELAXED);
+    c.frees = __atomic_load_n(&freeCount, __ATOMIC_RELAXED);
+    c.reallocs = __atomic_load_n(&reallocCount, __ATOMIC_RELAXED);
+    c.failed = __atomic_load_n(&failedCount, __ATOMIC_RELAXED);
+    return c;
+}
+
+bool heapAllocTracking() {
+#ifdef HEAP_TRACK_ALLOCS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void heapWatchBegin() {
+#ifdef HEAP_TRACK_ALLOCS
+    watchedAllocs = 0;
+    watchedTask = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+uint32_t heapWatchEnd() {
+    watchedTask = nullptr;
+    return watchedAllocs;
+}
+
+bool heapCallerTracking() {
+#if defined(HEAP_TRACK_ALLOCS) && defined(HEAP_TRACK_CALLERS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void checkHeap() {
+    HeapSnapshot s = heapSnapshot();
+    if (s.largestBlock < minLargestBlock) {
+        minLargestBlock = s.largestBlock;
+    }
+
+    // Warn once per crossing, the check runs every few seconds
+    if (s.largestBlock < HEAP_LOW_BLOCK_WARN_BYTES && !lowBlockWarned) {
+        lowBlockWarned = true;
+        LOG_W(SYS, "HEAP: Largest free block down to %u bytes (%u free, %u%% fragmented)",
+            (unsigned)s.largestBlock, (unsigned)s.freeBytes, (unsigned)s.fragmentationPct);
+        flightRecord(FLIGHT_HEAP_BLOCK, nullptr, s.largestBlock);
+    } else if (s.largestBlock >= HEAP_LOW_BLOCK_WARN_BYTES + HEAP_LOW_BLOCK_WARN_BYTES / 4) {
+        lowBlockWarned = false;
+    }
+
+    // Low-water marks in steps, so a slow leak leaves a trail across a reset
+    if (recordedMinFree == UINT32_MAX || s.minFreeBytes + FLIGHT_HEAP_STEP_BYTES <= recordedMinFree) {
+        recordedMinFree = s.minFreeBytes;
+        flightRecord(FLIGHT_HEAP_MIN, nullptr, s.minFreeBytes);
+    }
+}
+
+static void takeSample() {
+    HeapSnapshot s = heapSnapshot();
+    HeapCounters c = heapCounters();
+
+    HeapSample& sample = history[historyHead];
+    sample.uptimeS = millis() / 1000;
+    sample.freeBytes = s.freeBytes;
+    sample.minFreeBytes = s.minFreeBytes;
+    sample.largestBlock = s.largestBlock;
+    sample.allocs = c.allocs;
+    sample.frees = c.frees;
+
+    historyHead = (historyHead + 1) % HEAP_HISTORY_SAMPLES;
+    if (historyCount < HEAP_HISTORY_SAMPLES) historyCount++;
+
+    LOG_D(SYS, "HEAP: free=%u min=%u largest=%u allocs=%u frees=%u",
+        (unsigned)s.freeBytes, (unsigned)s.minFreeBytes, (unsigned)s.largestBlock,
+        (unsigned)c.allocs, (unsigned)c.frees);
+}
+
+void initHeapMonitor() {
+    checkHeap();
+    takeSample();
+    lastCheck = lastSample = millis();
+}
+
+void serviceHeapMonitor() {
+    unsigned long now = millis();
+    if (now - lastCheck >= HEAP_CHECK_INTERVAL_MS) {
+        lastCheck = now;
+        checkHeap();
+    }
+    if (now - lastSample >= HEAP_SAMPLE_INTERVAL_MS) {
+        lastSample = now;
+        takeSample();
+    }
+}
+
+size_t heapHistoryCount() {
+    return historyCount;
+}
+
+const HeapSample& heapHistoryAt(size_t i) {
+    size_t start = (historyHead + HEAP_HISTORY_SAMPLES - historyCount) % HEAP_HISTORY_SAMPLES;
+    return history[(start + i) % HEAP_HISTORY_SAMPLES];
+}
+
+uint32_t heapCallersForEach(HeapCallerVisitor visit) {
+#if defined(HEAP_TRACK_ALLOCS) && defined(HEAP_TRACK_CALLERS)
+    // Copy out first, the visitor allocates
+    static HeapCaller snapshot[HEAP_CALLER_SLOTS];
+    portENTER_CRITICAL(&callerMux);
+    memcpy(snapshot, callers, sizeof(snapshot));
+    uint32_t overflow = callersOverflow;
+    portEXIT_CRITICAL(&callerMux);
+
+    for (const HeapCaller& c : snapshot) {
+        if (c.pc != 0) visit(c.pc, c.count, c.bytes);
+    }
+    return overflow;
+#else
+    (void)visit;
+    return 0;
+#endif
+}
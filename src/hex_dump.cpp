@@ -0,0 +1,21 @@
+#include "hex_dump.h"
+
+const char* bytesToHex(const uint8_t* data, size_t len, char* out, size_t size) {
+    static const char digits[] = "0123456789ABCDEF";
+    if (size == 0) {
+        return out;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < len; i++) {
+        size_t need = i > 0 ? 3 : 2;
+        if (pos + need >= size) {
+            break;
+        }
+        if (i > 0) out[pos++] = ' ';
+        out[pos++] = digits[data[i] >> 4];
+        out[pos++] = digits[data[i] & 0x0F];
+    }
+    out[pos] = '\0';
+    return out;
+}
@@ -4,9 +4,26 @@
 #include "debug.h"
 #include "bluetooth.h"
 #include "yas_commands.h"
+#include "planner.h"
+#include "command_batch.h"
+#include "command_queue.h"
+#include "event_stream.h"
+#include "trace.h"
+#include "metrics.h"
+#include "heap_monitor.h"
+#include "json_arena.h"
+#include "task_monitor.h"
+#include "flight_recorder.h"
+#include "supervisor.h"
+#include "coex.h"
+#include "link_policy.h"
+#include "link_quality.h"
+#include "keepalive.h"
+#include "power.h"
 
 #include <WiFi.h>
 #include <ArduinoJson.h>
+#include <esp_system.h>
 
 // Check API key authentication
 static bool checkAuth() {
@@ -33,88 +50,251 @@ static bool checkAuth() {
     return false;
 }
 
+// Respond with a document, serialized into the static output buffer when it fits
+static void sendJson(int code, const JsonDocument& doc) {
+    size_t length;
+    const char* out = serializeJsonOutput(doc, length);
+    if (out) {
+        server.send(code, "application/json", out, length);
+        return;
+    }
+    String response;
+    serializeJson(doc, response);
+    server.send(code, "application/json", response);
+}
+
+static void sendJsonDeferred(HttpRequestId id, int code, const JsonDocument& doc,
+                             const String& extraHeaders = String()) {
+    size_t length;
+    const char* out = serializeJsonOutput(doc, length);
+    if (out) {
+        server.sendDeferred(id, code, "application/json", out, length, extraHeaders);
+        return;
+    }
+    String response;
+    serializeJson(doc, response);
+    server.sendDeferred(id, code, "application/json", response, extraHeaders);
+}
+
+// statusVersion restarts at 0 on every boot; the nonce keeps a client's ETag
+// from an earlier boot from matching a different state
+static uint32_t statusEtagNonce = 0;
+
 // Initialize HTTP server
 void initHttpServer() {
-    server.on("/", HTTP_GET, handleRoot);
-    server.on("/status", HTTP_GET, handleStatus);
-    server.on("/send_command", HTTP_GET, handleSendCommand);
-    server.on("/debug", HTTP_GET, handleDebug);
-    server.on("/reset_pairing", HTTP_GET, handleResetPairing);
-    server.on("/reconnect", HTTP_GET, handleReconnect);
+    statusEtagNonce = esp_random();
+    server.on("/", HTTP_METHOD_GET, handleRoot);
+    server.on("/status", HTTP_METHOD_GET, handleStatus);
+    server.on("/send_command", HTTP_METHOD_GET, handleSendCommand);
+    server.on("/state", HTTP_METHOD_POST, handleSetState);
+    server.on("/commands", HTTP_METHOD_POST, handleCommandBatch);
+    server.on("/debug", HTTP_METHOD_GET, handleDebug);
+    server.on("/debug/trace", HTTP_METHOD_GET, handleTrace);
+    server.on("/debug/heap", HTTP_METHOD_GET, handleHeap);
+    server.on("/debug/tasks", HTTP_METHOD_GET, handleTasks);
+    server.on("/debug/lastboot", HTTP_METHOD_GET, handleLastBoot);
+    server.on("/metrics", HTTP_METHOD_GET, handleMetrics);
+    server.on("/events", HTTP_METHOD_GET, handleEvents);
+    server.on("/logs", HTTP_METHOD_GET, handleLogs);
+    server.on("/reset_pairing", HTTP_METHOD_GET, handleResetPairing);
+    server.on("/reconnect", HTTP_METHOD_GET, handleReconnect);
     server.onNotFound(handleNotFound);
-
-    const char* headerKeys[] = {"Authorization"};
-    server.collectHeaders(headerKeys, 1);
+    server.onResponseTime(coexObserveHttp);
 
     server.begin();
-    DBG("HTTP: Server started on port %d", HTTP_PORT);
-    DBG("HTTP: Debug endpoint at http://%s/debug", WiFi.localIP().toString().c_str());
+    LOG_I(HTTP, "HTTP: Server started on port %d", HTTP_PORT);
+    LOG_I(HTTP, "HTTP: Debug endpoint at http://%s/debug", WiFi.localIP().toString().c_str());
 }
 
 // GET / - Basic info
 void handleRoot() {
     if (!checkAuth()) return;
 
-    JsonDocument doc;
+    ArenaJsonDocument doc;
     doc["name"] = "YAS Bluetooth Bridge";
     doc["version"] = "2.2.0";
     doc["bluetooth_connected"] = btConnected;
     doc["mqtt_connected"] = mqtt.connected();
     doc["ip"] = WiFi.localIP().toString();
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    sendJson(200, doc);
+}
+
+// /status requests waiting for a soundbar read
+struct StatusWaiter {
+    HttpRequestId id = HTTP_REQUEST_NONE;
+    unsigned long readMark = 0;       // cmdQueueStats.statusReads when deferred
+    unsigned long requestedAt = 0;
+    String ifNoneMatch;
+};
+
+static StatusWaiter statusWaiters[HTTP_MAX_CONNECTIONS];
+
+// Answer a /status request from the snapshot, directly (id == HTTP_REQUEST_NONE) or deferred
+static void respondStatus(HttpRequestId id, const String& ifNoneMatch) {
+    // Weak ETag: the body also carries the snapshot age, which changes without the state changing
+    char etag[32];
+    snprintf(etag, sizeof(etag), "W/\"%08lx-%lu\"", (unsigned long)statusEtagNonce, statusVersion);
+
+    if (ifNoneMatch == etag) {
+        if (id == HTTP_REQUEST_NONE) {
+            server.sendHeader("ETag", etag);
+            server.sendHeader("Cache-Control", "no-cache");
+            server.send(304);
+        } else {
+            server.sendDeferred(id, 304, nullptr, String(),
+                                "ETag: " + String(etag) + "\r\nCache-Control: no-cache\r\n");
+        }
+        return;
+    }
+
+    const YasStatus& status = lastSoundbarStatus;
+    ArenaJsonDocument doc;
+    doc["power"] = status.power;
+    doc["input"] = status.input.c_str();
+    doc["muted"] = status.muted;
+    doc["volume"] = status.volume;
+    doc["subwoofer"] = status.subwoofer;
+    doc["surround"] = status.surround.c_str();
+    doc["bass_ext"] = status.bass_ext;
+    doc["clear_voice"] = status.clear_voice;
+    doc["age_ms"] = millis() - lastStatusUpdate;
+    doc["version"] = statusVersion;
+
+    if (id == HTTP_REQUEST_NONE) {
+        server.sendHeader("ETag", etag);
+        server.sendHeader("Cache-Control", "no-cache");
+        sendJson(200, doc);
+    } else {
+        sendJsonDeferred(id, 200, doc, "ETag: " + String(etag) + "\r\nCache-Control: no-cache\r\n");
+    }
 }
 
 // GET /status - Soundbar status
+// Serves the snapshot loop() keeps current; only reads from the soundbar when
+// the snapshot is older than max_age (ms) or fresh=1 is given. That read is
+// queued at user priority and the request is answered once it completes.
 void handleStatus() {
     if (!checkAuth()) return;
 
+    unsigned long maxAge = STATUS_CACHE_MAX_AGE_MS;
+    if (server.hasArg("max_age")) {
+        // Digits only: toInt() would turn "-1" into a huge age and "abc" into 0
+        String arg = server.arg("max_age");
+        bool valid = arg.length() > 0;
+        for (size_t i = 0; i < arg.length() && valid; i++) {
+            valid = isdigit((unsigned char)arg[i]);
+        }
+        if (!valid) {
+            server.send(400, "application/json", "{\"error\":\"Invalid max_age\"}");
+            return;
+        }
+        maxAge = strtoul(arg.c_str(), nullptr, 10);
+    }
+    bool forceFresh = server.hasArg("fresh") && server.arg("fresh") == "1";
+    String ifNoneMatch = server.header("If-None-Match");
+
+    bool cacheUsable = lastSoundbarStatus.valid && !forceFresh &&
+        millis() - lastStatusUpdate <= maxAge;
+
+    if (cacheUsable) {
+        respondStatus(HTTP_REQUEST_NONE, ifNoneMatch);
+        return;
+    }
+
     if (!btConnected) {
         server.send(503, "application/json", "{\"error\":\"Bluetooth not connected\"}");
         return;
     }
 
-    YasStatus status = requestStatus();
+    for (StatusWaiter& waiter : statusWaiters) {
+        if (server.isPending(waiter.id)) continue;
 
-    if (!status.valid) {
-        server.send(500, "application/json", "{\"error\":\"Failed to get status\"}");
+        waiter.readMark = cmdQueueStats.statusReads;
+        waiter.requestedAt = millis();
+        waiter.ifNoneMatch = ifNoneMatch;
+        waiter.id = server.defer();
+        queueStatusRequest(PRIO_USER);
         return;
     }
 
-    JsonDocument doc;
-    doc["power"] = status.power;
-    doc["input"] = status.input;
-    doc["muted"] = status.muted;
-    doc["volume"] = status.volume;
-    doc["subwoofer"] = status.subwoofer;
-    doc["surround"] = status.surround;
-    doc["bass_ext"] = status.bass_ext;
-    doc["clear_voice"] = status.clear_voice;
+    server.send(503, "application/json", "{\"error\":\"Too many pending requests\"}");
+}
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+// Complete deferred requests whose soundbar work has finished
+void serviceHttpRequests() {
+    for (StatusWaiter& waiter : statusWaiters) {
+        if (!server.isPending(waiter.id)) continue;
+
+        if (!btConnected) {
+            server.sendDeferred(waiter.id, 503, "application/json", "{\"error\":\"Bluetooth not connected\"}");
+        } else if (cmdQueueStats.statusReads > waiter.readMark) {
+            if (lastSoundbarStatus.valid && (long)(lastStatusUpdate - waiter.requestedAt) >= 0) {
+                respondStatus(waiter.id, waiter.ifNoneMatch);
+            } else {
+                server.sendDeferred(waiter.id, 500, "application/json", "{\"error\":\"Failed to get status\"}");
+            }
+        } else if (millis() - waiter.requestedAt > BATCH_TIMEOUT_MS) {
+            server.sendDeferred(waiter.id, 500, "application/json", "{\"error\":\"Status request timed out\"}");
+        } else {
+            continue;
+        }
+        waiter.id = HTTP_REQUEST_NONE;
+    }
 }
 
 // GET /debug - Debug info
+// ?log=bt:debug,cmd:warn changes runtime log levels first
 void handleDebug() {
     if (!checkAuth()) return;
 
-    JsonDocument doc;
+    if (server.hasArg("log") && !setLogLevels(server.arg("log"))) {
+        server.send(400, "application/json", "{\"error\":\"Invalid log levels\"}");
+        return;
+    }
+    if (server.hasArg("coex")) {
+        CoexMode mode;
+        bool automatic;
+        if (!parseCoexMode(server.arg("coex"), mode, automatic)) {
+            server.send(400, "application/json", "{\"error\":\"Invalid coex mode\"}");
+            return;
+        }
+        setCoexMode(mode, automatic);
+    }
+    if (server.hasArg("power")) {
+        PowerProfile profile;
+        if (!parsePowerProfile(server.arg("power"), profile)) {
+            server.send(400, "application/json", "{\"error\":\"Invalid power profile\"}");
+            return;
+        }
+        setPowerProfile(profile);
+    }
+    if (server.hasArg("keepalive")) {
+        if (server.arg("keepalive") != "reset") {
+            server.send(400, "application/json", "{\"error\":\"Invalid keepalive action\"}");
+            return;
+        }
+        resetKeepalive();
+    }
+
+    ArenaJsonDocument doc;
 
     // System info
     doc["uptime_ms"] = millis();
-    doc["free_heap"] = ESP.getFreeHeap();
+    HeapSnapshot heap = heapSnapshot();
+    doc["free_heap"] = heap.freeBytes;
+    doc["min_free_heap"] = heap.minFreeBytes;
+    doc["largest_free_block"] = heap.largestBlock;
     doc["wifi_rssi"] = WiFi.RSSI();
     doc["esp32_temp"] = temperatureRead();
 
     // Bluetooth stats
     doc["bt"]["connected"] = btConnected;
     doc["bt"]["paired"] = isPaired;
-    doc["bt"]["status"] = lastBtStatus;
+    doc["bt"]["status"] = lastBtStatus.c_str();
     doc["bt"]["target_address"] = SOUNDBAR_ADDRESS;
+    doc["bt"]["transport"] = btTransportName();
+    doc["bt"]["stack_heap_bytes"] = btStackHeapBytes();
     doc["bt"]["connect_attempts"] = btStats.connectAttempts;
     doc["bt"]["connect_successes"] = btStats.connectSuccesses;
     doc["bt"]["connect_failures"] = btStats.connectFailures;
@@ -124,55 +304,426 @@ void handleDebug() {
         (btConnected ? (millis() - btStats.connectedSince) : 0);
     doc["bt"]["bytes_sent"] = btStats.bytesSent;
     doc["bt"]["bytes_received"] = btStats.bytesReceived;
-    doc["bt"]["last_error"] = btStats.lastError;
+    doc["bt"]["last_error"] = btStats.lastError.c_str();
+    doc["bt"]["last_disconnect_idle_ms"] = btStats.lastDisconnectIdleMs;
 
     if (btStats.connectAttempts > 0) {
         doc["bt"]["success_rate"] = 100.0 * btStats.connectSuccesses / btStats.connectAttempts;
     }
 
+    // SPP transmit path and congestion
+    BtTxStats tx = btTxStats();
+    doc["bt"]["tx"]["congested"] = btTxCongested();
+    doc["bt"]["tx"]["depth"] = btTxDepth();
+    doc["bt"]["tx"]["max_depth"] = tx.maxDepth;
+    doc["bt"]["tx"]["congestions"] = tx.congestions;
+    doc["bt"]["tx"]["congested_ms"] = tx.congestedMs;
+    doc["bt"]["tx"]["max_congested_ms"] = tx.maxCongestedMs;
+    doc["bt"]["tx"]["held"] = tx.held;
+    doc["bt"]["tx"]["released"] = tx.released;
+    doc["bt"]["tx"]["dropped"] = tx.dropped;
+
+    // Command queue
+    doc["queue"]["depth"] = commandQueueDepth();
+    doc["queue"]["frames_sent"] = cmdQueueStats.framesSent;
+    doc["queue"]["status_reads"] = cmdQueueStats.statusReads;
+    doc["queue"]["deduplicated"] = cmdQueueStats.deduplicated;
+    doc["queue"]["preemptions"] = cmdQueueStats.preemptions;
+    doc["queue"]["dropped"] = cmdQueueStats.dropped;
+    doc["queue"]["max_depth"] = cmdQueueStats.maxDepth;
+
+    // Logging
+    doc["log"]["recorded"] = logStats.recorded;
+    doc["log"]["dropped"] = logStats.dropped;
+    doc["log"]["truncated"] = logStats.truncated;
+    doc["log"]["max_used"] = logStats.maxUsed;
+    doc["log"]["syslog_sent"] = logStats.syslogSent;
+    doc["log"]["syslog_suppressed"] = logStats.syslogSuppressed;
+    for (int m = 0; m < LOG_MOD_COUNT; m++) {
+        doc["log"]["levels"][logModuleName((LogModule)m)] = logLevelName(logLevels[m]);
+    }
+
+    // JSON memory
+    doc["json"]["arena_bytes"] = JSON_ARENA_BYTES;
+    doc["json"]["arena_peak"] = jsonArenaStats.peak;
+    doc["json"]["heap_fallbacks"] = jsonArenaStats.heapFallbacks;
+    doc["json"]["output_overflows"] = jsonArenaStats.outputOverflows;
+
+    // HTTP server
+    doc["http"]["connections"] = server.activeConnections();
+    doc["http"]["max_concurrent"] = server.stats.maxConcurrent;
+    doc["http"]["accepted"] = server.stats.connectionsAccepted;
+    doc["http"]["rejected"] = server.stats.connectionsRejected;
+    doc["http"]["requests"] = server.stats.requests;
+    doc["http"]["keepalive_reuses"] = server.stats.keepAliveReuses;
+    doc["http"]["parse_errors"] = server.stats.parseErrors;
+    doc["http"]["write_timeouts"] = server.stats.writeTimeouts;
+    doc["http"]["deferred"] = server.stats.deferred;
+    doc["http"]["deferred_expired"] = server.stats.deferredExpired;
+
+    // Event stream
+    doc["events"]["subscribers"] = eventSubscriberCount();
+    doc["events"]["accepted"] = eventStats.subscribersAccepted;
+    doc["events"]["rejected"] = eventStats.subscribersRejected;
+    doc["events"]["sent"] = eventStats.eventsSent;
+    doc["events"]["coalesced"] = eventStats.eventsCoalesced;
+
     // MQTT info
     doc["mqtt"]["connected"] = mqtt.connected();
     doc["mqtt"]["host"] = MQTT_HOST;
     doc["mqtt"]["port"] = MQTT_PORT;
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    // Power profile, inbound latency (gateway round trip) per WiFi power save mode
+    doc["power"]["profile"] = powerProfileName(powerProfile());
+    doc["power"]["wifi_power_save"] = wifiPowerSaveName(wifiPowerSave());
+    doc["power"]["bt_sniff_allowed"] = btSniffAllowed();
+    doc["power"]["poll_interval_ms"] = statusPollIntervalMs();
+    for (int ps = 0; ps < WIFI_PS_MODES; ps++) {
+        LatencyStats s = inboundLatency((wifi_ps_type_t)ps);
+        if (s.count == 0 && s.timeouts == 0) continue;
+        JsonObject entry = doc["power"]["inbound_latency"][wifiPowerSaveName((wifi_ps_type_t)ps)].to<JsonObject>();
+        entry["samples"] = s.count;
+        if (s.count > 0) {
+            entry["avg_ms"] = (float)s.sumMs / s.count;
+            entry["max_ms"] = s.maxMs;
+        }
+        entry["timeouts"] = s.timeouts;
+    }
+
+    // BT link mode and sniff policy
+    doc["link"]["mode"] = linkUp() ? linkModeName(linkMode()) : "down";
+    doc["link"]["sniff_allowed"] = linkSniffAllowed();
+    doc["link"]["interactive"] = linkInteractive();
+    doc["link"]["keepawake_reads"] = linkKeepAwakeReads();
+    for (int m = 0; m < LINK_MODE_COUNT; m++) {
+        LinkModeStats s = linkModeStats((LinkMode)m);
+        if (s.entered == 0) continue;
+        JsonObject entry = doc["link"]["modes"][linkModeName((LinkMode)m)].to<JsonObject>();
+        entry["time_ms"] = s.timeMs;
+        entry["entered"] = s.entered;
+    }
+    LinkWakeStats wakes = linkWakeStats();
+    doc["link"]["wakes"]["count"] = wakes.count;
+    if (wakes.count > 0) {
+        doc["link"]["wakes"]["avg_ms"] = (float)wakes.sumMs / wakes.count;
+        doc["link"]["wakes"]["max_ms"] = wakes.maxMs;
+    }
+
+    // Idle-link keepalive
+    KeepaliveStats keepalive = keepaliveStats();
+    doc["keepalive"]["idle_timeout_ms"] = keepalive.thresholdMs;
+    doc["keepalive"]["interval_ms"] = keepalive.intervalMs;
+    doc["keepalive"]["idle_disconnects"] = keepalive.idleDisconnects;
+    doc["keepalive"]["sent"] = keepalive.sent;
+    doc["keepalive"]["suspended"] = keepalive.suspended;
+
+    // BT link quality: RSSI samples [age_s, rssi_delta, last_rtt_ms] and link events
+    uint32_t nowS = millis() / 1000;
+    JsonObject quality = doc["bt_quality"].to<JsonObject>();
+    if (linkQualityValid()) {
+        quality["rssi_delta"] = linkQualityRssi();
+        quality["rssi_avg"] = linkQualityRssiAvg();
+    }
+    quality["weak"] = linkQualityWeak();
+    quality["weak_count"] = linkQualityWeakCount();
+    JsonArray history = quality["samples"].to<JsonArray>();
+    for (size_t i = 0; i < linkQualitySampleCount(); i++) {
+        LinkQualitySample s = linkQualitySampleAt(i);
+        JsonArray entry = history.add<JsonArray>();
+        entry.add(nowS - s.uptimeS);
+        entry.add(s.rssiDelta);
+        entry.add(s.rttMs);
+    }
+    JsonArray linkEvents = quality["events"].to<JsonArray>();
+    for (size_t i = 0; i < linkQualityEventCount(); i++) {
+        LinkQualityEvent e = linkQualityEventAt(i);
+        JsonObject entry = linkEvents.add<JsonObject>();
+        entry["age_s"] = nowS - e.uptimeS;
+        entry["event"] = linkQualityEventName(e.type);
+        entry["value"] = e.value;
+        if (e.rssiAvg != INT8_MIN) {
+            entry["rssi_avg"] = e.rssiAvg;
+        }
+    }
+
+    // Radio coexistence, measurements per preference
+    doc["coex"]["mode"] = coexModeName(coexMode());
+    doc["coex"]["automatic"] = coexAutomatic();
+    for (int m = 0; m < COEX_MODE_COUNT; m++) {
+        CoexModeStats s = coexModeStats((CoexMode)m);
+        JsonObject entry = doc["coex"]["modes"][coexModeName((CoexMode)m)].to<JsonObject>();
+        entry["time_ms"] = s.activeMs;
+        entry["entered"] = s.entered;
+        entry["bt_rtt_samples"] = s.btRttCount;
+        if (s.btRttCount > 0) {
+            entry["bt_rtt_avg_ms"] = (float)s.btRttSumMs / s.btRttCount;
+            entry["bt_rtt_max_ms"] = s.btRttMaxMs;
+        }
+        entry["http_samples"] = s.httpCount;
+        if (s.httpCount > 0) {
+            entry["http_avg_ms"] = (float)(s.httpSumUs / s.httpCount) / 1000;
+            entry["http_max_ms"] = s.httpMaxUs / 1000.0;
+        }
+    }
+
+    // Supervisor
+    for (int i = 0; i < SUB_COUNT; i++) {
+        SubsystemHealth h = subsystemHealth((Subsystem)i);
+        JsonObject entry = doc["supervisor"][h.name].to<JsonObject>();
+        entry["beat_age_ms"] = h.beatAgeMs;
+        if (h.callMs > 0) {
+            entry["call_ms"] = h.callMs;
+        }
+        entry["recovering"] = h.recovering;
+        entry["trips"] = h.trips;
+        entry["recoveries"] = h.recoveries;
+    }
+
+    sendJson(200, doc);
+}
+
+// GET /events - Server-Sent Events stream of state changes
+void handleEvents() {
+    if (!checkAuth()) return;
+
+    // The stream takes over the socket; the server forgets the connection
+    int fd = server.detachClient();
+    if (fd >= 0) {
+        addEventSubscriber(fd);
+    }
+}
+
+// Large text responses (/metrics, /debug/trace) are rendered into this buffer;
+// send() copies whatever the socket doesn't take at once, so it is free again
+// as soon as the handler returns
+static char textOutput[TEXT_OUTPUT_BYTES];
+
+// GET /metrics - Prometheus text exposition, rendered into a static buffer
+void handleMetrics() {
+    if (!checkAuth()) return;
+
+    size_t len = renderMetrics(textOutput, sizeof(textOutput));
+    server.send(200, "text/plain; version=0.0.4", textOutput, len);
+}
+
+// GET /debug/heap - Heap state, allocator counts and the sampled history
+void handleHeap() {
+    if (!checkAuth()) return;
+
+    HeapSnapshot heap = heapSnapshot();
+    HeapCounters counters = heapCounters();
+
+    ArenaJsonDocument doc;
+    doc["free"] = heap.freeBytes;
+    doc["min_free"] = heap.minFreeBytes;
+    doc["largest_block"] = heap.largestBlock;
+    doc["min_largest_block"] = heap.minLargestBlock;
+    doc["fragmentation_pct"] = heap.fragmentationPct;
+
+    if (heapAllocTracking()) {
+        doc["allocs"] = counters.allocs;
+        doc["frees"] = counters.frees;
+        doc["reallocs"] = counters.reallocs;
+        doc["failed"] = counters.failed;
+        doc["live"] = counters.allocs - counters.frees;
+        doc["status_read_allocs"] = cmdQueueStats.statusReadAllocs;
+    }
+
+    doc["sample_interval_s"] = HEAP_SAMPLE_INTERVAL_MS / 1000;
+    JsonArray history = doc["history"].to<JsonArray>();
+    for (size_t i = 0; i < heapHistoryCount(); i++) {
+        const HeapSample& sample = heapHistoryAt(i);
+        JsonObject entry = history.add<JsonObject>();
+        entry["uptime_s"] = sample.uptimeS;
+        entry["free"] = sample.freeBytes;
+        entry["min_free"] = sample.minFreeBytes;
+        entry["largest_block"] = sample.largestBlock;
+        entry["allocs"] = sample.allocs;
+        entry["frees"] = sample.frees;
+    }
+
+    if (heapCallerTracking()) {
+        JsonArray callers = doc["callers"].to<JsonArray>();
+        uint32_t unattributed = heapCallersForEach([&callers](uint32_t pc, uint32_t count, uint32_t bytes) {
+            char addr[11];
+            snprintf(addr, sizeof(addr), "0x%08x", (unsigned)pc);
+            JsonObject entry = callers.add<JsonObject>();
+            entry["pc"] = addr;
+            entry["count"] = count;
+            entry["bytes"] = bytes;
+        });
+        doc["callers_unattributed"] = unattributed;
+    }
+
+    sendJson(200, doc);
+}
+
+// GET /debug/tasks - CPU usage per task and core over the last sample window, stack headroom
+void handleTasks() {
+    if (!checkAuth()) return;
+
+    ArenaJsonDocument doc;
+    doc["interval_ms"] = taskSampleIntervalMs();
+    doc["cpu_stats"] = taskCpuStatsAvailable();
+
+    if (taskCpuStatsAvailable()) {
+        JsonArray cores = doc["cores"].to<JsonArray>();
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            JsonObject entry = cores.add<JsonObject>();
+            entry["core"] = core;
+            entry["load_pct"] = coreLoadPermille(core) / 10.0;
+        }
+    }
+
+    JsonArray tasks = doc["tasks"].to<JsonArray>();
+    for (size_t i = 0; i < taskCount(); i++) {
+        const TaskInfo& t = taskAt(i);
+        JsonObject entry = tasks.add<JsonObject>();
+        entry["name"] = t.name;
+        char state[2] = {t.state, '\0'};
+        entry["state"] = state;
+        entry["priority"] = t.priority;
+        if (t.core >= 0) {
+            entry["core"] = t.core;
+        }
+        entry["stack_free"] = t.stackFreeBytes;
+        if (taskCpuStatsAvailable()) {
+            entry["cpu_pct"] = t.cpuPermille / 10.0;
+        }
+    }
+
+    sendJson(200, doc);
+}
+
+// GET /debug/lastboot - Flight recorder contents from before the last reset
+void handleLastBoot() {
+    if (!checkAuth()) return;
+
+    ArenaJsonDocument doc;
+    doc["boot"] = flightBootCount();
+    doc["reset_reason"] = flightResetReason();
+    doc["available"] = lastBootAvailable();
+
+    if (lastBootAvailable()) {
+        const FlightCounters& c = lastBootCounters();
+        JsonObject counters = doc["counters"].to<JsonObject>();
+        counters["uptime_ms"] = c.uptimeMs;
+        counters["bt_connect_attempts"] = c.btConnectAttempts;
+        counters["bt_connect_failures"] = c.btConnectFailures;
+        counters["bt_disconnects"] = c.btDisconnects;
+        counters["bt_bytes_sent"] = c.btBytesSent;
+        counters["bt_bytes_received"] = c.btBytesReceived;
+        counters["frames_sent"] = c.framesSent;
+        counters["mqtt_connects"] = c.mqttConnects;
+        counters["min_free_heap"] = c.minFreeHeap;
+        counters["loop_max_ms"] = c.loopMaxMs;
+
+        JsonArray events = doc["events"].to<JsonArray>();
+        for (size_t i = 0; i < lastBootEventCount(); i++) {
+            const FlightEvent& e = lastBootEventAt(i);
+            JsonObject entry = events.add<JsonObject>();
+            entry["time_ms"] = e.timeMs;
+            entry["type"] = flightEventName(e.type);
+            if (e.text[0]) {
+                entry["text"] = e.text;
+            }
+            entry["value"] = e.value;
+        }
+
+        size_t length;
+        const char* log = lastBootLog(length);
+        JsonArray lines = doc["log"].to<JsonArray>();
+        size_t start = 0;
+        for (size_t i = 0; i < length; i++) {
+            if (log[i] == '\n') {
+                lines.add(JsonString(log + start, i - start));
+                start = i + 1;
+            }
+        }
+        if (start < length) {
+            lines.add(JsonString(log + start, length - start));
+        }
+    }
+
+    sendJson(200, doc);
+}
+
+// GET /debug/trace - Request lifecycle trace in Chrome trace-event JSON
+// Open in chrome://tracing or ui.perfetto.dev; ?clear=1 empties the buffer after export
+void handleTrace() {
+    if (!checkAuth()) return;
+
+    size_t len = traceExport(textOutput, sizeof(textOutput));
+    if (server.hasArg("clear") && server.arg("clear") == "1") {
+        traceClear();
+    }
+    server.send(200, "application/json", textOutput, len);
+}
+
+// GET /logs?since=<seq> - Recent log lines, poll with the returned "next" to tail
+void handleLogs() {
+    if (!checkAuth()) return;
+
+    uint32_t since = 0;
+    if (server.hasArg("since")) {
+        since = strtoul(server.arg("since").c_str(), NULL, 10);
+    }
+    // Ahead of us means the bridge restarted - start over from the oldest line
+    if (since > logHistoryLastSeq()) {
+        since = 0;
+    }
+
+    ArenaJsonDocument doc;
+    JsonArray lines = doc["lines"].to<JsonArray>();
+    uint32_t next = since;
+    size_t bytes = 0;
+    uint32_t first = logHistoryForEach(since, [&](uint32_t seq, const char* text, size_t len) {
+        if (bytes + len > LOG_HTTP_MAX_BYTES) {
+            return false;   // Rest on the next poll
+        }
+        lines.add(text);
+        bytes += len;
+        next = seq;
+        return true;
+    });
+
+    // Lines that were overwritten before this poll could fetch them
+    doc["missed"] = (first > since + 1) ? first - since - 1 : 0;
+    doc["next"] = next;
+    doc["last"] = logHistoryLastSeq();
+
+    sendJson(200, doc);
 }
 
 // GET /reset_pairing - Reset BT pairing
 void handleResetPairing() {
     if (!checkAuth()) return;
 
-    DBG("HTTP: Reset pairing requested");
+    LOG_I(HTTP, "HTTP: Reset pairing requested");
     resetPairing();
 
-    JsonDocument doc;
+    ArenaJsonDocument doc;
     doc["success"] = true;
     doc["message"] = "Pairing reset. Put soundbar in pairing mode. Will reconnect in 30 seconds (or call /reconnect).";
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    sendJson(200, doc);
 }
 
 // GET /reconnect - Trigger immediate reconnect
 void handleReconnect() {
     if (!checkAuth()) return;
 
-    DBG("HTTP: Reconnect requested");
+    LOG_I(HTTP, "HTTP: Reconnect requested");
 
     // Clear hold-off and trigger immediate reconnect
     reconnectHoldOffUntil = 0;
     lastBtConnectAttempt = 0;
 
-    JsonDocument doc;
+    ArenaJsonDocument doc;
     doc["success"] = true;
     doc["message"] = "Reconnect triggered";
 
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
+    sendJson(200, doc);
 }
 
 // GET /send_command - Send command to soundbar
@@ -196,10 +747,146 @@ void handleSendCommand() {
         return;
     }
 
-    if (sendCommand(command)) {
-        server.send(200, "application/json", "{\"message\":\"Command sent\"}");
+    TraceScope trace("http send_command");
+    if (queueCommand(command, PRIO_USER)) {
+        queueStatusRequest(PRIO_CONFIRM);
+        server.send(200, "application/json", "{\"message\":\"Command queued\"}");
     } else {
-        server.send(500, "application/json", "{\"error\":\"Failed to send command\"}");
+        server.send(503, "application/json", "{\"error\":\"Command queue full\"}");
+    }
+}
+
+// POST /state - Move soundbar to a desired partial state
+// Body: {"power":true,"input":"hdmi","surround":"movie","volume":22,"subwoofer":16}
+void handleSetState() {
+    if (!checkAuth()) return;
+
+    if (!server.hasArg("plain")) {
+        server.send(400, "application/json", "{\"error\":\"Missing JSON body\"}");
+        return;
+    }
+
+    ArenaJsonDocument body;
+    if (deserializeJson(body, server.arg("plain"))) {
+        server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        return;
+    }
+
+    TargetState target;
+    String error;
+    if (!parseTargetState(body.as<JsonVariantConst>(), target, error)) {
+        ArenaJsonDocument doc;
+        doc["error"] = error;
+        sendJson(400, doc);
+        return;
+    }
+
+    if (!btConnected) {
+        server.send(503, "application/json", "{\"error\":\"Bluetooth not connected\"}");
+        return;
+    }
+
+    LOG_I(HTTP, "HTTP: Set state requested");
+
+    // Answered from loop() once the confirming status read is in
+    TraceScope trace("http set_state");
+    HttpRequestId id = server.defer();
+    bool started = startTargetState(target, [id](bool ok, const std::vector<PlanStep>& steps) {
+        if (!ok) {
+            server.sendDeferred(id, 500, "application/json", "{\"error\":\"Failed to reach target state\"}");
+            return;
+        }
+
+        const YasStatus& status = lastSoundbarStatus;
+        ArenaJsonDocument doc;
+        JsonArray commands = doc["commands"].to<JsonArray>();
+        for (const PlanStep& step : steps) {
+            commands.add(step.command);
+        }
+        doc["status"]["power"] = status.power;
+        doc["status"]["input"] = status.input.c_str();
+        doc["status"]["muted"] = status.muted;
+        doc["status"]["volume"] = status.volume;
+        doc["status"]["subwoofer"] = status.subwoofer;
+        doc["status"]["surround"] = status.surround.c_str();
+        doc["status"]["bass_ext"] = status.bass_ext;
+        doc["status"]["clear_voice"] = status.clear_voice;
+
+        sendJsonDeferred(id, 200, doc);
+    });
+
+    if (!started) {
+        server.sendDeferred(id, 503, "application/json", "{\"error\":\"Another state change is in progress\"}");
+    }
+}
+
+// POST /commands - Send an ordered list of commands back-to-back
+// Body: {"commands":["power_on",{"command":"set_input_hdmi","delay_ms":1500},"volume_up"],
+//        "pace_ms":100,"status":true}
+void handleCommandBatch() {
+    if (!checkAuth()) return;
+
+    if (!server.hasArg("plain")) {
+        server.send(400, "application/json", "{\"error\":\"Missing JSON body\"}");
+        return;
+    }
+
+    ArenaJsonDocument body;
+    if (deserializeJson(body, server.arg("plain"))) {
+        server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+        return;
+    }
+
+    CommandBatch batch;
+    String error;
+    if (!parseCommandBatch(body.as<JsonVariantConst>(), batch, error)) {
+        ArenaJsonDocument doc;
+        doc["error"] = error;
+        sendJson(400, doc);
+        return;
+    }
+
+    // Answered from loop() once the last command (and status read) is done
+    TraceScope trace("http commands");
+    HttpRequestId id = server.defer();
+    bool started = startCommandBatch(batch, [id](bool ok, const CommandBatch& batch) {
+        ArenaJsonDocument doc;
+        doc["batch"] = batch.id;
+        doc["ok"] = ok;
+        doc["pace_ms"] = batch.paceMs;
+        doc["duration_ms"] = batch.finishedAt - batch.startedAt;
+
+        // TX times are relative to when the batch was accepted
+        JsonArray commands = doc["commands"].to<JsonArray>();
+        for (const BatchCommand& cmd : batch.commands) {
+            JsonObject entry = commands.add<JsonObject>();
+            entry["command"] = cmd.command;
+            entry["sent"] = cmd.sent;
+            if (cmd.sent) {
+                entry["ok"] = cmd.ok;
+                entry["tx_ms"] = cmd.sentAt - batch.startedAt;
+            }
+        }
+
+        if (batch.readStatus && ok) {
+            const YasStatus& status = lastSoundbarStatus;
+            doc["status"]["power"] = status.power;
+            doc["status"]["input"] = status.input.c_str();
+            doc["status"]["muted"] = status.muted;
+            doc["status"]["volume"] = status.volume;
+            doc["status"]["subwoofer"] = status.subwoofer;
+            doc["status"]["surround"] = status.surround.c_str();
+            doc["status"]["bass_ext"] = status.bass_ext;
+            doc["status"]["clear_voice"] = status.clear_voice;
+        }
+
+        sendJsonDeferred(id, ok ? 200 : 500, doc);
+    }, error);
+
+    if (!started) {
+        ArenaJsonDocument doc;
+        doc["error"] = error;
+        sendJsonDeferred(id, 503, doc);
     }
 }
 
@@ -0,0 +1,706 @@
+#include "http_server.h"
+#include "debug.h"
+#include "supervisor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <lwip/sockets.h>
+#include <freertos/task.h>
+
+// Slot ownership: the socket task owns READING and WRITING slots, loop() owns
+// QUEUED and DEFERRED slots. Only the owner touches the slot's buffers; handing
+// over is a single atomic store of the new state.
+enum ConnState : uint8_t {
+    CONN_FREE = 0,
+    CONN_READING,
+    CONN_QUEUED,
+    CONN_DEFERRED,
+    CONN_WRITING
+};
+
+struct AsyncHttpServer::Connection {
+    std::atomic<uint8_t> state{CONN_FREE};
+    int fd = -1;
+    uint16_t generation = 0;
+    uint16_t requestsServed = 0;
+    bool keepAlive = false;
+    bool needsParse = false;          // Pipelined bytes left in rx after a response
+    unsigned long lastActivity = 0;
+    unsigned long requestStart = 0;   // micros() when the request was read, 0 if none
+
+    char rx[HTTP_RX_BUFFER_SIZE + 1];
+    size_t rxLen = 0;
+
+    // Parsed request
+    HttpMethod method = HTTP_METHOD_OTHER;
+    String uri;
+    String body;
+    uint8_t argCount = 0;
+    String argNames[HTTP_MAX_ARGS];
+    String argValues[HTTP_MAX_ARGS];
+    uint8_t headerCount = 0;
+    String headerNames[HTTP_MAX_HEADERS];
+    String headerValues[HTTP_MAX_HEADERS];
+
+    // Response in flight
+    String tx;
+    size_t txPos = 0;
+};
+
+static const char* reasonPhrase(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "";
+    }
+}
+
+// Decode %XX and '+' in place
+static void urlDecode(char* s) {
+    char* out = s;
+    while (*s) {
+        if (*s == '+') {
+            *out++ = ' ';
+            s++;
+        } else if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+            char hex[3] = {s[1], s[2], 0};
+            *out++ = (char)strtol(hex, NULL, 16);
+            s += 3;
+        } else {
+            *out++ = *s++;
+        }
+    }
+    *out = '\0';
+}
+
+static HttpRequestId makeRequestId(int slot, uint16_t generation) {
+    return ((HttpRequestId)generation << 8) | (uint8_t)(slot + 1);
+}
+
+AsyncHttpServer::AsyncHttpServer(uint16_t port) : _port(port) {}
+
+void AsyncHttpServer::on(const char* path, HttpMethod method, HttpHandler handler) {
+    if (_routeCount >= HTTP_MAX_ROUTES) {
+        LOG_W(HTTP, "HTTP: Route table full, dropping %s", path);
+        return;
+    }
+    _routes[_routeCount++] = {String(path), method, handler, 0};
+}
+
+void AsyncHttpServer::onNotFound(HttpHandler handler) {
+    _notFound = handler;
+}
+
+void AsyncHttpServer::begin() {
+    _conns = new Connection[HTTP_MAX_CONNECTIONS];
+    _readyQueue = xQueueCreate(HTTP_MAX_CONNECTIONS, sizeof(int));
+
+    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(_listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(_listenFd, HTTP_MAX_CONNECTIONS) < 0) {
+        LOG_E(HTTP, "HTTP: Failed to open port %d (errno %d)", _port, errno);
+        close(_listenFd);
+        _listenFd = -1;
+        return;
+    }
+    fcntl(_listenFd, F_SETFL, O_NONBLOCK);
+
+    xTaskCreatePinnedToCore(taskEntry, "http", HTTP_TASK_STACK_SIZE, this,
+                            HTTP_TASK_PRIORITY, nullptr, HTTP_TASK_CORE);
+}
+
+void AsyncHttpServer::taskEntry(void* arg) {
+    static_cast<AsyncHttpServer*>(arg)->taskLoop();
+}
+
+// ----------------------------------------------------------------------------
+// Socket task
+// ----------------------------------------------------------------------------
+
+void AsyncHttpServer::taskLoop() {
+    for (;;) {
+        supervisorBeat(SUB_HTTP);
+        fd_set readFds, writeFds;
+        FD_ZERO(&readFds);
+        FD_ZERO(&writeFds);
+        FD_SET(_listenFd, &readFds);
+        int maxFd = _listenFd;
+
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            Connection& c = _conns[i];
+            uint8_t state = c.state.load(std::memory_order_acquire);
+
+            if (state == CONN_READING) {
+                if (c.needsParse) {
+                    c.needsParse = false;
+                    if (parseRequest(i)) continue;
+                }
+                if (millis() - c.lastActivity > HTTP_KEEPALIVE_TIMEOUT_MS) {
+                    closeClient(i);
+                    continue;
+                }
+                FD_SET(c.fd, &readFds);
+            } else if (state == CONN_WRITING) {
+                // A client that stopped reading would hold the slot and its response forever
+                if (millis() - c.lastActivity > HTTP_KEEPALIVE_TIMEOUT_MS) {
+                    stats.writeTimeouts++;
+                    closeClient(i);
+                    continue;
+                }
+                FD_SET(c.fd, &writeFds);
+            } else {
+                continue;
+            }
+            if (c.fd > maxFd) maxFd = c.fd;
+        }
+
+        struct timeval tv = {0, HTTP_TASK_POLL_MS * 1000};
+        int ready = select(maxFd + 1, &readFds, &writeFds, nullptr, &tv);
+        if (ready <= 0) continue;
+
+        if (FD_ISSET(_listenFd, &readFds)) {
+            acceptClients();
+        }
+
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            Connection& c = _conns[i];
+            uint8_t state = c.state.load(std::memory_order_acquire);
+            if (state == CONN_READING && FD_ISSET(c.fd, &readFds)) {
+                readClient(i);
+            } else if (state == CONN_WRITING && FD_ISSET(c.fd, &writeFds)) {
+                writeClient(i);
+            }
+        }
+    }
+}
+
+void AsyncHttpServer::acceptClients() {
+    for (;;) {
+        int fd = accept(_listenFd, nullptr, nullptr);
+        if (fd < 0) return;
+
+        int slot = -1;
+        size_t active = 0;
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            if (_conns[i].state.load(std::memory_order_acquire) == CONN_FREE) {
+                if (slot < 0) slot = i;
+            } else {
+                active++;
+            }
+        }
+
+        if (slot < 0) {
+            static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                                       "Content-Length: 0\r\nConnection: close\r\n\r\n";
+            ::send(fd, busy, sizeof(busy) - 1, MSG_DONTWAIT);
+            close(fd);
+            stats.connectionsRejected++;
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Connection& c = _conns[slot];
+        c.fd = fd;
+        c.generation++;
+        c.requestsServed = 0;
+        c.rxLen = 0;
+        c.needsParse = false;
+        c.lastActivity = millis();
+        c.state.store(CONN_READING, std::memory_order_release);
+
+        stats.connectionsAccepted++;
+        if (active + 1 > stats.maxConcurrent) {
+            stats.maxConcurrent = active + 1;
+        }
+    }
+}
+
+void AsyncHttpServer::readClient(int slot) {
+    Connection& c = _conns[slot];
+    size_t space = HTTP_RX_BUFFER_SIZE - c.rxLen;
+    if (space == 0) {
+        rejectRequest(slot, 413);
+        return;
+    }
+
+    int n = recv(c.fd, c.rx + c.rxLen, space, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        closeClient(slot);
+        return;
+    }
+    if (n < 0) return;
+
+    c.rxLen += n;
+    c.lastActivity = millis();
+    parseRequest(slot);
+}
+
+// Parse one complete request from rx; returns true if it was handed off or rejected
+bool AsyncHttpServer::parseRequest(int slot) {
+    Connection& c = _conns[slot];
+    c.rx[c.rxLen] = '\0';
+
+    char* headerEnd = strstr(c.rx, "\r\n\r\n");
+    if (!headerEnd) {
+        if (c.rxLen >= HTTP_RX_BUFFER_SIZE) {
+            rejectRequest(slot, 413);
+            return true;
+        }
+        return false;
+    }
+    size_t headerLen = headerEnd - c.rx + 4;
+
+    // Content-Length has to be known before we can tell if the body is complete
+    size_t contentLength = 0;
+    for (char* p = strstr(c.rx, "\r\n"); p && p < headerEnd; p = strstr(p + 2, "\r\n")) {
+        if (strncasecmp(p + 2, "Content-Length:", 15) == 0) {
+            contentLength = strtoul(p + 17, NULL, 10);
+            break;
+        }
+    }
+    if (contentLength > HTTP_MAX_BODY_SIZE || headerLen + contentLength > HTTP_RX_BUFFER_SIZE) {
+        rejectRequest(slot, 413);
+        return true;
+    }
+    if (c.rxLen < headerLen + contentLength) {
+        return false;
+    }
+
+    // Request line: METHOD SP target SP version
+    *headerEnd = '\0';
+    char* line = c.rx;
+    char* lineEnd = strstr(line, "\r\n");
+    if (lineEnd) *lineEnd = '\0';
+
+    char* target = strchr(line, ' ');
+    char* version = target ? strchr(target + 1, ' ') : nullptr;
+    if (!target || !version) {
+        stats.parseErrors++;
+        rejectRequest(slot, 400);
+        return true;
+    }
+    *target++ = '\0';
+    *version++ = '\0';
+
+    c.method = strcmp(line, "GET") == 0 ? HTTP_METHOD_GET
+             : strcmp(line, "POST") == 0 ? HTTP_METHOD_POST
+             : HTTP_METHOD_OTHER;
+    bool http11 = strcmp(version, "HTTP/1.1") == 0;
+
+    c.argCount = 0;
+    auto parseArgs = [&c](char* query) {
+        while (query && *query && c.argCount < HTTP_MAX_ARGS) {
+            char* next = strchr(query, '&');
+            if (next) *next++ = '\0';
+            char* eq = strchr(query, '=');
+            if (eq) *eq++ = '\0';
+            urlDecode(query);
+            if (eq) urlDecode(eq);
+            c.argNames[c.argCount] = query;
+            c.argValues[c.argCount] = eq ? eq : "";
+            c.argCount++;
+            query = next;
+        }
+    };
+
+    char* query = strchr(target, '?');
+    if (query) *query++ = '\0';
+    urlDecode(target);
+    c.uri = target;
+    parseArgs(query);
+
+    // Headers
+    c.headerCount = 0;
+    bool connClose = false;
+    bool connKeepAlive = false;
+    bool formBody = false;
+    for (char* h = lineEnd ? lineEnd + 2 : nullptr; h && *h; ) {
+        char* next = strstr(h, "\r\n");
+        if (next) {
+            *next = '\0';
+            next += 2;
+        }
+        char* colon = strchr(h, ':');
+        if (colon && c.headerCount < HTTP_MAX_HEADERS) {
+            *colon++ = '\0';
+            while (*colon == ' ') colon++;
+            c.headerNames[c.headerCount] = h;
+            c.headerValues[c.headerCount] = colon;
+            c.headerCount++;
+
+            if (strcasecmp(h, "Connection") == 0) {
+                connClose = strcasecmp(colon, "close") == 0;
+                connKeepAlive = strcasecmp(colon, "keep-alive") == 0;
+            } else if (strcasecmp(h, "Content-Type") == 0) {
+                formBody = strncasecmp(colon, "application/x-www-form-urlencoded", 33) == 0;
+            }
+        }
+        h = next;
+    }
+    c.keepAlive = http11 ? !connClose : connKeepAlive;
+
+    // Body - kept raw as "plain", form bodies also become args
+    char* body = c.rx + headerLen;
+    char saved = body[contentLength];
+    body[contentLength] = '\0';
+    c.body = body;
+    if (formBody) {
+        parseArgs(body);
+    }
+    body[contentLength] = saved;
+
+    // Keep pipelined bytes for the next request
+    size_t consumed = headerLen + contentLength;
+    memmove(c.rx, c.rx + consumed, c.rxLen - consumed);
+    c.rxLen -= consumed;
+
+    stats.requests++;
+    if (c.requestsServed++ > 0) {
+        stats.keepAliveReuses++;
+    }
+
+    c.requestStart = micros();
+    c.state.store(CONN_QUEUED, std::memory_order_release);
+    xQueueSend(_readyQueue, &slot, 0);
+    return true;
+}
+
+void AsyncHttpServer::writeClient(int slot) {
+    Connection& c = _conns[slot];
+    int n = ::send(c.fd, c.tx.c_str() + c.txPos, c.tx.length() - c.txPos, MSG_DONTWAIT);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        closeClient(slot);
+        return;
+    }
+    if (n > 0) {
+        c.txPos += n;
+        c.lastActivity = millis();
+    }
+    if (c.txPos >= c.tx.length()) {
+        finishResponse(slot);
+    }
+}
+
+// Response fully written - wait for the next request or hang up
+// Called by whichever side currently owns the slot.
+void AsyncHttpServer::finishResponse(int slot) {
+    Connection& c = _conns[slot];
+    c.tx = String();
+    c.txPos = 0;
+
+    if (c.requestStart != 0) {
+        if (_responseTimeObserver) {
+            _responseTimeObserver(micros() - c.requestStart);
+        }
+        c.requestStart = 0;
+    }
+
+    if (!c.keepAlive) {
+        closeClient(slot);
+        return;
+    }
+
+    c.uri = String();
+    c.body = String();
+    c.lastActivity = millis();
+    c.needsParse = c.rxLen > 0;
+    c.state.store(CONN_READING, std::memory_order_release);
+}
+
+void AsyncHttpServer::closeClient(int slot) {
+    Connection& c = _conns[slot];
+    if (c.fd >= 0) {
+        close(c.fd);
+        c.fd = -1;
+    }
+    c.rxLen = 0;
+    c.requestStart = 0;
+    c.tx = String();
+    c.uri = String();
+    c.body = String();
+    c.state.store(CONN_FREE, std::memory_order_release);
+}
+
+// Error answered from the socket task, connection is closed afterwards
+void AsyncHttpServer::rejectRequest(int slot, int code) {
+    Connection& c = _conns[slot];
+    char buf[96];
+    int len = snprintf(buf, sizeof(buf), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                       code, reasonPhrase(code));
+    ::send(c.fd, buf, len, MSG_DONTWAIT);
+    closeClient(slot);
+}
+
+// ----------------------------------------------------------------------------
+// Loop side
+// ----------------------------------------------------------------------------
+
+void AsyncHttpServer::handleClient() {
+    if (!_readyQueue) return;
+
+    int slot;
+    while (xQueueReceive(_readyQueue, &slot, 0) == pdTRUE) {
+        dispatch(slot);
+    }
+}
+
+void AsyncHttpServer::dispatch(int slot) {
+    _current = slot;
+    _handled = false;
+    _extraHeaders = String();
+
+    bool pathMatched = false;
+    HttpHandler handler;
+    const Connection& c = _conns[slot];
+    for (size_t i = 0; i < _routeCount; i++) {
+        if (_routes[i].path != c.uri) continue;
+        pathMatched = true;
+        if (_routes[i].method == HTTP_METHOD_ANY || _routes[i].method == c.method) {
+            handler = _routes[i].handler;
+            _routes[i].requests++;
+            break;
+        }
+    }
+
+    if (!handler) {
+        stats.unmatched++;
+    }
+
+    if (handler) {
+        handler();
+    } else if (pathMatched) {
+        send(405, "application/json", "{\"error\":\"Method not allowed\"}");
+    } else if (_notFound) {
+        _notFound();
+    } else {
+        send(404);
+    }
+
+    // A handler must answer, defer or detach
+    if (!_handled) {
+        send(500, "application/json", "{\"error\":\"No response\"}");
+    }
+    _current = -1;
+}
+
+HttpMethod AsyncHttpServer::method() const {
+    return _current >= 0 ? _conns[_current].method : HTTP_METHOD_OTHER;
+}
+
+const String& AsyncHttpServer::uri() const {
+    static const String empty;
+    return _current >= 0 ? _conns[_current].uri : empty;
+}
+
+bool AsyncHttpServer::hasArg(const String& name) const {
+    if (_current < 0) return false;
+    const Connection& c = _conns[_current];
+    if (name == "plain") return c.body.length() > 0;
+    for (uint8_t i = 0; i < c.argCount; i++) {
+        if (c.argNames[i] == name) return true;
+    }
+    return false;
+}
+
+String AsyncHttpServer::arg(const String& name) const {
+    if (_current < 0) return String();
+    const Connection& c = _conns[_current];
+    if (name == "plain") return c.body;
+    for (uint8_t i = 0; i < c.argCount; i++) {
+        if (c.argNames[i] == name) return c.argValues[i];
+    }
+    return String();
+}
+
+bool AsyncHttpServer::hasHeader(const String& name) const {
+    if (_current < 0) return false;
+    const Connection& c = _conns[_current];
+    for (uint8_t i = 0; i < c.headerCount; i++) {
+        if (c.headerNames[i].equalsIgnoreCase(name)) return true;
+    }
+    return false;
+}
+
+String AsyncHttpServer::header(const String& name) const {
+    if (_current < 0) return String();
+    const Connection& c = _conns[_current];
+    for (uint8_t i = 0; i < c.headerCount; i++) {
+        if (c.headerNames[i].equalsIgnoreCase(name)) return c.headerValues[i];
+    }
+    return String();
+}
+
+void AsyncHttpServer::sendHeader(const String& name, const String& value) {
+    _extraHeaders += name;
+    _extraHeaders += ": ";
+    _extraHeaders += value;
+    _extraHeaders += "\r\n";
+}
+
+void AsyncHttpServer::send(int code, const char* contentType, const String& content) {
+    send(code, contentType, content.c_str(), content.length());
+}
+
+void AsyncHttpServer::send(int code, const char* contentType, const char* content, size_t length) {
+    if (_current < 0) return;
+    // Once answered the slot may already be serving the next request
+    int slot = _current;
+    _current = -1;
+    _handled = true;
+    String headers = _extraHeaders;
+    _extraHeaders = String();
+    queueResponse(slot, code, contentType, content, length, headers);
+}
+
+// Build the response and write as much as the socket takes right away;
+// the socket task finishes anything left over. Small bodies go out in the same
+// segment as the headers, large ones straight from the caller's buffer so only
+// the part the socket can't take yet is copied.
+void AsyncHttpServer::queueResponse(int slot, int code, const char* contentType, const char* content,
+                                    size_t length, const String& extraHeaders) {
+    Connection& c = _conns[slot];
+
+    char head[160];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Length: %u\r\nConnection: %s\r\n",
+             code, reasonPhrase(code), (unsigned)length, c.keepAlive ? "keep-alive" : "close");
+
+    bool inlineBody = length <= HTTP_INLINE_BODY_BYTES;
+    c.tx.reserve(strlen(head) + extraHeaders.length() + (inlineBody ? length : 0) + 48);
+    c.tx = head;
+    if (contentType) {
+        c.tx += "Content-Type: ";
+        c.tx += contentType;
+        c.tx += "\r\n";
+    }
+    c.tx += extraHeaders;
+    c.tx += "\r\n";
+    if (inlineBody) {
+        c.tx.concat(content, length);
+        length = 0;
+    }
+    c.txPos = 0;
+
+    int n = ::send(c.fd, c.tx.c_str(), c.tx.length(), MSG_DONTWAIT);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        closeClient(slot);
+        return;
+    }
+    if (n > 0) {
+        c.txPos = n;
+    }
+    if (length > 0 && c.txPos >= c.tx.length()) {
+        n = ::send(c.fd, content, length, MSG_DONTWAIT);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            closeClient(slot);
+            return;
+        }
+        if (n > 0) {
+            content += n;
+            length -= n;
+        }
+    }
+    if (length > 0) {
+        c.tx.concat(content, length);
+    }
+
+    if (c.txPos >= c.tx.length()) {
+        finishResponse(slot);
+    } else {
+        c.lastActivity = millis();
+        c.state.store(CONN_WRITING, std::memory_order_release);
+    }
+}
+
+HttpRequestId AsyncHttpServer::defer() {
+    if (_current < 0) return HTTP_REQUEST_NONE;
+    Connection& c = _conns[_current];
+    c.state.store(CONN_DEFERRED, std::memory_order_release);
+    stats.deferred++;
+    HttpRequestId id = makeRequestId(_current, c.generation);
+    _current = -1;   // Further send() calls in this handler are ignored
+    _handled = true;
+    return id;
+}
+
+bool AsyncHttpServer::isPending(HttpRequestId id) const {
+    if (id == HTTP_REQUEST_NONE) return false;
+    int slot = (id & 0xFF) - 1;
+    if (slot < 0 || slot >= HTTP_MAX_CONNECTIONS) return false;
+    const Connection& c = _conns[slot];
+    return c.generation == (uint16_t)(id >> 8) &&
+           c.state.load(std::memory_order_acquire) == CONN_DEFERRED;
+}
+
+bool AsyncHttpServer::sendDeferred(HttpRequestId id, int code, const char* contentType, const String& content,
+                                   const String& extraHeaders) {
+    return sendDeferred(id, code, contentType, content.c_str(), content.length(), extraHeaders);
+}
+
+bool AsyncHttpServer::sendDeferred(HttpRequestId id, int code, const char* contentType, const char* content,
+                                   size_t length, const String& extraHeaders) {
+    if (!isPending(id)) {
+        stats.deferredExpired++;
+        return false;
+    }
+    queueResponse((id & 0xFF) - 1, code, contentType, content, length, extraHeaders);
+    return true;
+}
+
+int AsyncHttpServer::detachClient() {
+    if (_current < 0) return -1;
+    Connection& c = _conns[_current];
+    int fd = c.fd;
+    c.fd = -1;
+    c.rxLen = 0;
+    c.requestStart = 0;
+    c.uri = String();
+    c.body = String();
+    c.state.store(CONN_FREE, std::memory_order_release);
+    _current = -1;
+    _handled = true;
+    return fd;
+}
+
+size_t AsyncHttpServer::activeConnections() const {
+    size_t count = 0;
+    for (int i = 0; _conns && i < HTTP_MAX_CONNECTIONS; i++) {
+        if (_conns[i].state.load(std::memory_order_acquire) != CONN_FREE) count++;
+    }
+    return count;
+}
+
+size_t AsyncHttpServer::routeCount() const {
+    return _routeCount;
+}
+
+const char* AsyncHttpServer::routePath(size_t i) const {
+    return i < _routeCount ? _routes[i].path.c_str() : "";
+}
+
+HttpMethod AsyncHttpServer::routeMethod(size_t i) const {
+    return i < _routeCount ? _routes[i].method : HTTP_METHOD_ANY;
+}
+
+unsigned long AsyncHttpServer::routeRequests(size_t i) const {
+    return i < _routeCount ? _routes[i].requests : 0;
+}
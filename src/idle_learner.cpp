@@ -0,0 +1,70 @@
+#include "idle_learner.h"
+
+void idleLearnerReset(IdleLearner& learner, uint32_t thresholdMs) {
+    learner.count = 0;
+    learner.next = 0;
+    learner.thresholdMs = thresholdMs;
+}
+
+size_t idleLearnerCluster(const IdleLearner& learner, const IdleLearnerParams& params, uint32_t& shortestMs) {
+    uint32_t sorted[IDLE_LEARNER_HISTORY];
+    size_t n = learner.count;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t value = learner.samples[i];
+        size_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+
+    // Widest window starting at each sample; the lowest one wins a tie
+    size_t best = 0;
+    shortestMs = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t limit = (uint64_t)sorted[i] * (100 + params.tolerancePercent) / 100;
+        size_t j = i;
+        while (j + 1 < n && sorted[j + 1] <= limit) {
+            j++;
+        }
+        if (j - i + 1 > best) {
+            best = j - i + 1;
+            shortestMs = sorted[i];
+        }
+    }
+    return best;
+}
+
+bool idleLearnerAdd(IdleLearner& learner, const IdleLearnerParams& params, uint32_t idleMs) {
+    if (idleMs < params.minIdleMs) {
+        return false;
+    }
+
+    learner.samples[learner.next] = idleMs;
+    learner.next = (learner.next + 1) % IDLE_LEARNER_HISTORY;
+    if (learner.count < IDLE_LEARNER_HISTORY) {
+        learner.count++;
+    }
+
+    uint32_t shortest;
+    size_t size = idleLearnerCluster(learner, params, shortest);
+    if (size < params.minCluster || size * 2 <= learner.count || shortest == learner.thresholdMs) {
+        return false;
+    }
+    learner.thresholdMs = shortest;
+    return true;
+}
+
+uint32_t idleKeepaliveInterval(uint32_t thresholdMs, uint8_t leadPercent, uint32_t minIntervalMs) {
+    if (thresholdMs == 0) {
+        return 0;
+    }
+    uint32_t interval = (uint64_t)thresholdMs * leadPercent / 100;
+    if (interval < minIntervalMs) {
+        interval = minIntervalMs;
+    }
+    // A floor above a very short threshold would let the link drop first
+    uint32_t ceiling = thresholdMs / 10 * 9;
+    return interval > ceiling ? ceiling : interval;
+}
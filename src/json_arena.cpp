@@ -0,0 +1,99 @@
+#include "json_arena.h"
+
+// Each block is preceded by its size, so reallocate() can copy and the top
+// block can be grown or popped in place
+struct BlockHeader {
+    uint32_t size;
+};
+
+static const size_t ALIGN = 4;
+
+JsonArena jsonArena;
+JsonArenaStats jsonArenaStats;
+
+static char jsonOutput[JSON_OUTPUT_BYTES];
+
+static inline size_t alignUp(size_t n) {
+    return (n + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+bool JsonArena::owns(const void* ptr) const {
+    return ptr >= _buf && ptr < _buf + sizeof(_buf);
+}
+
+void* JsonArena::allocate(size_t size) {
+    size_t need = sizeof(BlockHeader) + alignUp(size);
+    if (_top + need > sizeof(_buf)) {
+        jsonArenaStats.heapFallbacks++;
+        return malloc(size);
+    }
+
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(_buf + _top);
+    header->size = alignUp(size);
+    _top += need;
+    if (_top > jsonArenaStats.peak) {
+        jsonArenaStats.peak = _top;
+    }
+    return header + 1;
+}
+
+void JsonArena::deallocate(void* ptr) {
+    if (!ptr) return;
+    if (!owns(ptr)) {
+        free(ptr);
+        return;
+    }
+
+    // Only the top block can be handed back early; the rest goes with the scope
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    uint8_t* end = static_cast<uint8_t*>(ptr) + header->size;
+    if (end == _buf + _top) {
+        _top = reinterpret_cast<uint8_t*>(header) - _buf;
+    }
+}
+
+void* JsonArena::reallocate(void* ptr, size_t newSize) {
+    if (!ptr) return allocate(newSize);
+    if (!owns(ptr)) return realloc(ptr, newSize);
+
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    uint8_t* start = static_cast<uint8_t*>(ptr);
+
+    // Top block (a growing string or the pool being shrunk to fit) resizes in place
+    if (start + header->size == _buf + _top) {
+        size_t offset = start - _buf;
+        if (offset + alignUp(newSize) <= sizeof(_buf)) {
+            header->size = alignUp(newSize);
+            _top = offset + header->size;
+            if (_top > jsonArenaStats.peak) {
+                jsonArenaStats.peak = _top;
+            }
+            return ptr;
+        }
+    } else if (alignUp(newSize) <= header->size) {
+        return ptr;
+    }
+
+    void* moved = allocate(newSize);
+    if (moved) {
+        memcpy(moved, ptr, header->size < newSize ? header->size : newSize);
+        deallocate(ptr);
+    }
+    return moved;
+}
+
+void JsonArena::release(size_t mark) {
+    if (mark < _top) {
+        _top = mark;
+    }
+}
+
+const char* serializeJsonOutput(const JsonDocument& doc, size_t& length) {
+    length = serializeJson(doc, jsonOutput, sizeof(jsonOutput));
+    // A full buffer means the output may have been cut short
+    if (length + 1 >= sizeof(jsonOutput)) {
+        jsonArenaStats.outputOverflows++;
+        return nullptr;
+    }
+    return jsonOutput;
+}
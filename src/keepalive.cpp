@@ -0,0 +1,93 @@
+#include "keepalive.h"
+#include "config.h"
+#include "debug.h"
+#include "state.h"
+#include "link_policy.h"
+#include "command_queue.h"
+#include "idle_learner.h"
+
+static const IdleLearnerParams learnParams = {
+    KEEPALIVE_MIN_IDLE_MS, KEEPALIVE_LEARN_SAMPLES, KEEPALIVE_TOLERANCE_PERCENT
+};
+
+static IdleLearner learner;
+static uint32_t idleDisconnects = 0;
+static uint32_t sent = 0;
+
+static uint32_t intervalFor(uint32_t threshold) {
+    return idleKeepaliveInterval(threshold, KEEPALIVE_LEAD_PERCENT, KEEPALIVE_MIN_INTERVAL_MS);
+}
+
+static bool suspended() {
+#if KEEPALIVE_WHILE_OFF
+    return false;
+#else
+    return lastSoundbarStatus.valid && !lastSoundbarStatus.power;
+#endif
+}
+
+void initKeepalive() {
+    idleLearnerReset(learner, prefs.getUInt("ka_idle", 0));
+    if (learner.thresholdMs > 0) {
+        LOG_I(BT, "KEEPALIVE: Learned idle timeout %lu ms, keepalive after %lu ms quiet",
+            (unsigned long)learner.thresholdMs, (unsigned long)intervalFor(learner.thresholdMs));
+    }
+}
+
+void keepaliveDisconnected(uint32_t idleMs) {
+    if (idleMs < KEEPALIVE_MIN_IDLE_MS) {
+        return;
+    }
+    idleDisconnects++;
+
+    if (!idleLearnerAdd(learner, learnParams, idleMs)) {
+        uint32_t shortest;
+        size_t similar = idleLearnerCluster(learner, learnParams, shortest);
+        LOG_I(BT, "KEEPALIVE: Disconnect after %lu ms quiet (%d of %d recent drops alike)",
+            (unsigned long)idleMs, (int)similar, (int)learner.count);
+        return;
+    }
+
+    prefs.putUInt("ka_idle", learner.thresholdMs);
+    LOG_I(BT, "KEEPALIVE: Idle timeout learned as %lu ms, keepalive after %lu ms quiet",
+        (unsigned long)learner.thresholdMs, (unsigned long)intervalFor(learner.thresholdMs));
+}
+
+void serviceKeepalive() {
+    uint32_t interval = intervalFor(learner.thresholdMs);
+    if (interval == 0 || !btConnected || suspended()) {
+        return;
+    }
+
+    // A fresh link counts as traffic, nothing has been sent on it yet
+    uint32_t quiet = linkQuietMs();
+    uint32_t connectedMs = millis() - btStats.connectedSince;
+    if (connectedMs < quiet) {
+        quiet = connectedMs;
+    }
+
+    if (quiet >= interval && commandQueueDepth() == 0) {
+        sent++;
+        queueStatusRequest(PRIO_POLL);
+    }
+}
+
+void resetKeepalive() {
+    idleLearnerReset(learner, 0);
+    prefs.remove("ka_idle");
+    LOG_I(BT, "KEEPALIVE: Learned idle timeout cleared");
+}
+
+uint32_t keepaliveIntervalMs() {
+    return suspended() ? 0 : intervalFor(learner.thresholdMs);
+}
+
+KeepaliveStats keepaliveStats() {
+    KeepaliveStats s;
+    s.thresholdMs = learner.thresholdMs;
+    s.intervalMs = intervalFor(learner.thresholdMs);
+    s.idleDisconnects = idleDisconnects;
+    s.sent = sent;
+    s.suspended = suspended();
+    return s;
+}
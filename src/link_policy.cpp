@@ -0,0 +1,176 @@
+#include "link_policy.h"
+#include "config.h"
+#include "debug.h"
+#include "state.h"
+#include "power.h"
+#include "command_queue.h"
+
+#include <freertos/FreeRTOS.h>
+
+static const char* const modeNames[LINK_MODE_COUNT] = {"active", "hold", "sniff", "park"};
+
+// Written by the BT task, read by loop() and the HTTP handlers
+static LinkModeStats modeStats[LINK_MODE_COUNT];
+static LinkWakeStats wakeStats;
+static portMUX_TYPE linkMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile LinkMode currentMode = LINK_ACTIVE;
+static volatile bool up = false;
+static uint32_t modeSince = 0;
+static uint32_t wakeStart = 0;
+static bool waking = false;
+
+// Loop task only
+static unsigned long interactiveUntil = 0;
+static unsigned long lastTraffic = 0;
+static uint32_t keepAwakeReads = 0;
+static bool sniffAllowed = true;
+
+const char* linkModeName(LinkMode mode) {
+    return mode < LINK_MODE_COUNT ? modeNames[mode] : "?";
+}
+
+// Caller holds linkMux
+static void enterMode(LinkMode mode, uint32_t now) {
+    if (up) {
+        modeStats[currentMode].timeMs += now - modeSince;
+    }
+    modeStats[mode].entered++;
+    currentMode = mode;
+    modeSince = now;
+}
+
+void linkOpened() {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&linkMux);
+    up = false;
+    enterMode(LINK_ACTIVE, now);
+    up = true;
+    waking = false;
+    portEXIT_CRITICAL(&linkMux);
+}
+
+void linkClosed() {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&linkMux);
+    if (up) {
+        modeStats[currentMode].timeMs += now - modeSince;
+    }
+    up = false;
+    waking = false;
+    portEXIT_CRITICAL(&linkMux);
+}
+
+void linkModeChanged(esp_bt_pm_mode_t pm) {
+    LinkMode mode = (int)pm < LINK_MODE_COUNT ? (LinkMode)pm : LINK_ACTIVE;
+    uint32_t now = millis();
+    uint32_t wakeMs = 0;
+    bool woke = false;
+
+    portENTER_CRITICAL(&linkMux);
+    if (mode != currentMode || !up) {
+        enterMode(mode, now);
+    }
+    if (mode == LINK_ACTIVE && waking) {
+        waking = false;
+        woke = true;
+        wakeMs = now - wakeStart;
+        wakeStats.count++;
+        wakeStats.sumMs += wakeMs;
+        if (wakeMs > wakeStats.maxMs) wakeStats.maxMs = wakeMs;
+    }
+    portEXIT_CRITICAL(&linkMux);
+
+    if (woke) {
+        LOG_D(BT, "LINK: %s, first frame waited %lu ms", modeNames[mode], (unsigned long)wakeMs);
+    } else {
+        LOG_D(BT, "LINK: %s", modeNames[mode]);
+    }
+}
+
+void linkTrafficQueued(bool interactive) {
+    if (interactive) {
+        interactiveUntil = millis() + LINK_INTERACTIVE_MS;
+    }
+}
+
+void linkFrameSending() {
+    uint32_t now = millis();
+    lastTraffic = now;
+    portENTER_CRITICAL(&linkMux);
+    if (up && currentMode != LINK_ACTIVE && !waking) {
+        waking = true;
+        wakeStart = now;
+    }
+    portEXIT_CRITICAL(&linkMux);
+}
+
+void serviceLinkPolicy() {
+    unsigned long now = millis();
+    bool interactive = (long)(interactiveUntil - now) > 0;
+    bool allowed = btSniffAllowed() && !interactive;
+    if (allowed != sniffAllowed) {
+        sniffAllowed = allowed;
+        LOG_D(BT, "LINK: Sniff %s", allowed ? "allowed" : "held off");
+    }
+
+    if (allowed || LINK_KEEPAWAKE_MS == 0 || !btConnected || !up) {
+        return;
+    }
+    // For the profile alone the status poll is the traffic; reads on top of it
+    // would cost more airtime than the polls themselves
+    if (!interactive && !LINK_KEEPAWAKE_PROFILE) {
+        return;
+    }
+
+    // Anything already waiting goes out soon enough and keeps the link busy
+    if (now - lastTraffic >= LINK_KEEPAWAKE_MS && commandQueueDepth() == 0) {
+        lastTraffic = now;
+        keepAwakeReads++;
+        queueStatusRequest(PRIO_POLL);
+    }
+}
+
+LinkMode linkMode() {
+    return currentMode;
+}
+
+bool linkUp() {
+    return up;
+}
+
+uint32_t linkQuietMs() {
+    return millis() - lastTraffic;
+}
+
+bool linkSniffAllowed() {
+    return sniffAllowed;
+}
+
+bool linkInteractive() {
+    return (long)(interactiveUntil - millis()) > 0;
+}
+
+LinkModeStats linkModeStats(LinkMode mode) {
+    LinkModeStats s = {};
+    if (mode >= LINK_MODE_COUNT) {
+        return s;
+    }
+    portENTER_CRITICAL(&linkMux);
+    s = modeStats[mode];
+    if (up && mode == currentMode) {
+        s.timeMs += millis() - modeSince;
+    }
+    portEXIT_CRITICAL(&linkMux);
+    return s;
+}
+
+LinkWakeStats linkWakeStats() {
+    portENTER_CRITICAL(&linkMux);
+    LinkWakeStats s = wakeStats;
+    portEXIT_CRITICAL(&linkMux);
+    return s;
+}
+
+uint32_t linkKeepAwakeReads() {
+    return keepAwakeReads;
+}
@@ -0,0 +1,217 @@
+#include "link_quality.h"
+#include "config.h"
+#include "debug.h"
+#include "state.h"
+#include "link_policy.h"
+#include "command_queue.h"
+#include "mqtt_client.h"
+
+#include <limits.h>
+
+static const char* const eventNames[] = {"disconnect", "rtt_spike", "weak", "recovered"};
+
+// Handed over from the BT task
+static esp_bd_addr_t peer;
+static volatile bool peerKnown = false;
+static volatile bool resultReady = false;
+static volatile esp_bt_status_t resultStat;
+static volatile int8_t resultDelta;
+
+// Loop task only
+static LinkQualitySample samples[BT_RSSI_HISTORY];
+static size_t sampleHead = 0;
+static size_t sampleCount = 0;
+static LinkQualityEvent events[BT_LINK_EVENTS];
+static size_t eventHead = 0;
+static size_t eventCount = 0;
+
+static int8_t window[BT_RSSI_AVG_SAMPLES];
+static size_t windowCount = 0;
+static size_t windowNext = 0;
+static bool weak = false;
+static uint32_t weakCount = 0;
+
+static uint16_t lastRttMs = 0;
+static bool readPending = false;
+static unsigned long lastRead = 0;
+static int publishedRssi = INT_MIN;
+
+const char* linkQualityEventName(LinkQualityEventType type) {
+    return type <= LQ_RECOVERED ? eventNames[type] : "?";
+}
+
+void linkQualityPeer(const esp_bd_addr_t bda) {
+    memcpy(peer, bda, sizeof(esp_bd_addr_t));
+    peerKnown = true;
+}
+
+void linkQualityRssiResult(esp_bt_status_t stat, int8_t rssiDelta) {
+    resultStat = stat;
+    resultDelta = rssiDelta;
+    resultReady = true;
+}
+
+float linkQualityRssiAvg() {
+    if (windowCount == 0) {
+        return 0;
+    }
+    int sum = 0;
+    for (size_t i = 0; i < windowCount; i++) {
+        sum += window[i];
+    }
+    return (float)sum / windowCount;
+}
+
+static int8_t avgForEvent() {
+    return windowCount > 0 ? (int8_t)lroundf(linkQualityRssiAvg()) : INT8_MIN;
+}
+
+static void addEvent(LinkQualityEventType type, uint32_t value) {
+    LinkQualityEvent& e = events[(eventHead + eventCount) % BT_LINK_EVENTS];
+    e.uptimeS = millis() / 1000;
+    e.value = value > UINT16_MAX ? UINT16_MAX : value;
+    e.rssiAvg = avgForEvent();
+    e.type = type;
+    if (eventCount < BT_LINK_EVENTS) {
+        eventCount++;
+    } else {
+        eventHead = (eventHead + 1) % BT_LINK_EVENTS;
+    }
+}
+
+static void addSample(int8_t rssiDelta) {
+    LinkQualitySample& s = samples[(sampleHead + sampleCount) % BT_RSSI_HISTORY];
+    s.uptimeS = millis() / 1000;
+    s.rssiDelta = rssiDelta;
+    s.rttMs = lastRttMs;
+    if (sampleCount < BT_RSSI_HISTORY) {
+        sampleCount++;
+    } else {
+        sampleHead = (sampleHead + 1) % BT_RSSI_HISTORY;
+    }
+
+    window[windowNext] = rssiDelta;
+    windowNext = (windowNext + 1) % BT_RSSI_AVG_SAMPLES;
+    if (windowCount < BT_RSSI_AVG_SAMPLES) {
+        windowCount++;
+    }
+
+    // Judge only on a full window, one bad sample is not a weak link
+    float avg = linkQualityRssiAvg();
+    if (!weak && windowCount == BT_RSSI_AVG_SAMPLES && avg < BT_RSSI_WEAK_DELTA) {
+        weak = true;
+        weakCount++;
+        addEvent(LQ_WEAK, windowCount);
+        LOG_W(BT, "BT: Weak link, RSSI %.1f dB below the golden range", -avg);
+    } else if (weak && avg >= BT_RSSI_WEAK_DELTA + BT_RSSI_HYSTERESIS) {
+        weak = false;
+        addEvent(LQ_RECOVERED, windowCount);
+        LOG_I(BT, "BT: Link quality recovered, RSSI delta %.1f dB", avg);
+    }
+}
+
+void linkQualityObserveRtt(uint32_t ms) {
+    lastRttMs = ms > UINT16_MAX ? UINT16_MAX : ms;
+    if (ms > BT_RTT_SPIKE_MS) {
+        addEvent(LQ_RTT_SPIKE, ms);
+        LOG_D(BT, "BT: Round trip spike %lu ms, RSSI delta %d", (unsigned long)ms, avgForEvent());
+    }
+}
+
+void linkQualityDisconnected(uint32_t connectedMs) {
+    addEvent(LQ_DISCONNECT, connectedMs / 1000);
+    if (windowCount > 0) {
+        LOG_I(BT, "BT: Link RSSI delta before disconnect: %.1f dB (%d samples)",
+            linkQualityRssiAvg(), (int)windowCount);
+    }
+
+    // The next connection starts a fresh average
+    windowCount = 0;
+    windowNext = 0;
+    weak = false;
+    readPending = false;
+    lastRttMs = 0;
+}
+
+static void publishRssi() {
+    if (!mqtt.connected() || windowCount == 0) {
+        return;
+    }
+    int rssi = lroundf(linkQualityRssiAvg());
+    if (rssi == publishedRssi) {
+        return;
+    }
+    char payload[8];
+    snprintf(payload, sizeof(payload), "%d", rssi);
+    if (mqttPublish(MQTT_BT_RSSI_TOPIC, payload, true)) {
+        publishedRssi = rssi;
+    }
+}
+
+void serviceLinkQuality() {
+    if (resultReady) {
+        resultReady = false;
+        readPending = false;
+        if (resultStat == ESP_BT_STATUS_SUCCESS && btConnected) {
+            addSample(resultDelta);
+            publishRssi();
+        } else {
+            LOG_D(BT, "BT: RSSI read failed, status %d", (int)resultStat);
+        }
+    }
+
+    if (!btConnected || !linkUp() || !peerKnown) {
+        return;
+    }
+
+    unsigned long now = millis();
+    if (readPending) {
+        if (now - lastRead < BT_RSSI_TIMEOUT_MS) {
+            return;
+        }
+        readPending = false;
+    }
+
+    // Only on an idle link, the read must not delay a command
+    if (now - lastRead < BT_RSSI_INTERVAL_MS || commandQueueDepth() > 0 ||
+        linkQuietMs() < BT_RSSI_IDLE_MS) {
+        return;
+    }
+
+    lastRead = now;
+    if (esp_bt_gap_read_rssi_delta(peer) == ESP_OK) {
+        readPending = true;
+    }
+}
+
+bool linkQualityValid() {
+    return windowCount > 0;
+}
+
+int8_t linkQualityRssi() {
+    return windowCount > 0 ? window[(windowNext + BT_RSSI_AVG_SAMPLES - 1) % BT_RSSI_AVG_SAMPLES] : 0;
+}
+
+bool linkQualityWeak() {
+    return weak;
+}
+
+uint32_t linkQualityWeakCount() {
+    return weakCount;
+}
+
+size_t linkQualitySampleCount() {
+    return sampleCount;
+}
+
+LinkQualitySample linkQualitySampleAt(size_t i) {
+    return samples[(sampleHead + i) % BT_RSSI_HISTORY];
+}
+
+size_t linkQualityEventCount() {
+    return eventCount;
+}
+
+LinkQualityEvent linkQualityEventAt(size_t i) {
+    return events[(eventHead + i) % BT_LINK_EVENTS];
+}
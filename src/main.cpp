@@ -10,8 +10,6 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
-#include <BluetoothSerial.h>
-#include <WebServer.h>
 #include <PubSubClient.h>
 #include <Preferences.h>
 
@@ -21,14 +19,28 @@
 #include "bluetooth.h"
 #include "mqtt_client.h"
 #include "http_handlers.h"
+#include "command_queue.h"
+#include "event_stream.h"
+#include "planner.h"
+#include "command_batch.h"
+#include "metrics.h"
+#include "heap_monitor.h"
+#include "task_monitor.h"
+#include "flight_recorder.h"
+#include "supervisor.h"
+#include "coex.h"
+#include "power.h"
+#include "link_policy.h"
+#include "link_quality.h"
+#include "keepalive.h"
 
 // ============================================================================
 // Global Objects
 // ============================================================================
 
-BluetoothSerial SerialBT;
-WebServer server(HTTP_PORT);
-WiFiClient wifiClient;
+BtTransport SerialBT;
+AsyncHttpServer server(HTTP_PORT);
+MqttSocket wifiClient;
 PubSubClient mqtt(wifiClient);
 Preferences prefs;
 
@@ -43,14 +55,17 @@ unsigned long lastBtConnectAttempt = 0;
 unsigned long reconnectHoldOffUntil = 0;
 
 // Status tracking
-String lastBtStatus = "initializing";
-String lastPublishedBtStatus = "";
+BtStatusName lastBtStatus = "initializing";
+BtStatusName lastPublishedBtStatus;
 YasStatus lastSoundbarStatus = {false, "unknown", false, 0, 0, "unknown", false, false, false};
+unsigned long statusVersion = 0;
+unsigned long lastStatusUpdate = 0;
 
 // Internal state
 static unsigned long lastWifiCheck = 0;
 static unsigned long lastMqttConnectAttempt = 0;
 static unsigned long lastStatusPoll = 0;
+static unsigned long lastDiagnostics = 0;
 static float lastTemperature = 0.0;
 static volatile bool wifiGotIP = false;
 
@@ -58,13 +73,35 @@ static volatile bool wifiGotIP = false;
 // Status Helper
 // ============================================================================
 
-void setBtStatus(const String& status, const String& detail) {
+void setBtStatus(const char* status, const char* detail) {
+    if (lastBtStatus != status) {
+        notifyBtStatusChanged();
+        flightRecord(FLIGHT_BT_STATUS, status);
+    }
     lastBtStatus = status;
-    if (detail.length() > 0) {
+    if (detail && detail[0]) {
         btStats.lastError = detail;
-        DBG("BT STATUS: %s (%s)", status.c_str(), detail.c_str());
+        LOG_I(BT, "BT STATUS: %s (%s)", status, detail);
     } else {
-        DBG("BT STATUS: %s", status.c_str());
+        LOG_I(BT, "BT STATUS: %s", status);
+    }
+}
+
+void updateSoundbarStatus(const YasStatus& status) {
+    lastStatusUpdate = millis();
+    if (status.power != lastSoundbarStatus.power ||
+        status.input != lastSoundbarStatus.input ||
+        status.muted != lastSoundbarStatus.muted ||
+        status.volume != lastSoundbarStatus.volume ||
+        status.subwoofer != lastSoundbarStatus.subwoofer ||
+        status.surround != lastSoundbarStatus.surround ||
+        status.bass_ext != lastSoundbarStatus.bass_ext ||
+        status.clear_voice != lastSoundbarStatus.clear_voice ||
+        !lastSoundbarStatus.valid) {
+        lastSoundbarStatus = status;
+        statusVersion++;
+        publishStatus(status);
+        notifyStateChanged();
     }
 }
 
@@ -76,11 +113,13 @@ static void WiFiEvent(WiFiEvent_t event) {
     switch (event) {
         case ARDUINO_EVENT_WIFI_STA_GOT_IP:
             wifiGotIP = true;
-            DBG("WiFi: Got IP %s", WiFi.localIP().toString().c_str());
+            flightRecord(FLIGHT_WIFI, "got_ip");
+            LOG_I(WIFI, "WiFi: Got IP %s", WiFi.localIP().toString().c_str());
             break;
         case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
             wifiGotIP = false;
-            DBG("WiFi: Disconnected");
+            flightRecord(FLIGHT_WIFI, "disconnected");
+            LOG_W(WIFI, "WiFi: Disconnected");
             break;
         default:
             break;
@@ -89,6 +128,7 @@ static void WiFiEvent(WiFiEvent_t event) {
 
 static void checkWifiConnection() {
     if (WiFi.status() == WL_CONNECTED) {
+        supervisorBeat(SUB_WIFI);
         return;
     }
 
@@ -97,47 +137,64 @@ static void checkWifiConnection() {
     }
 
     lastWifiCheck = millis();
-    DBG("WiFi: Disconnected, reconnecting...");
+    LOG_W(WIFI, "WiFi: Disconnected, reconnecting...");
     WiFi.disconnect();
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
 }
 
+void resetWifi() {
+    LOG_W(WIFI, "WiFi: Restarting WiFi");
+    WiFi.disconnect(true);
+    WiFi.mode(WIFI_OFF);
+    WiFi.mode(WIFI_STA);
+    esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    lastWifiCheck = millis();
+}
+
 // ============================================================================
 // Setup
 // ============================================================================
 
 void setup() {
     Serial.begin(115200);
+    initFlightRecorder();
+    initLogging();
     delay(1000);
 
-    Serial.println("\n");
-    Serial.println("========================================");
-    Serial.println("  YAS Bluetooth Bridge v2.2.0");
-    Serial.println("========================================");
-    DBG("ESP32 MAC: %s", WiFi.macAddress().c_str());
-    DBG("Free heap: %d bytes", ESP.getFreeHeap());
+    // Through the log queue like everything else, so it also lands in the /logs history
+    LOG_I(SYS, "========================================");
+    LOG_I(SYS, "YAS Bluetooth Bridge v2.2.0");
+    LOG_I(SYS, "========================================");
+    LOG_I(SYS, "ESP32 MAC: %s", WiFi.macAddress().c_str());
+    LOG_I(SYS, "Free heap: %d bytes", ESP.getFreeHeap());
+    LOG_I(SYS, "Boot #%lu, reset reason: %s%s", (unsigned long)flightBootCount(), flightResetReason(),
+        lastBootAvailable() ? " (previous boot at /debug/lastboot)" : "");
 
     // Connect to WiFi
     WiFi.onEvent(WiFiEvent);
     WiFi.mode(WIFI_STA);
     esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N);
 
-    DBG("WiFi: Connecting to %s", WIFI_SSID);
+    LOG_I(WIFI, "WiFi: Connecting to %s", WIFI_SSID);
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
 
     int attempts = 0;
     while (!wifiGotIP && attempts < 60) {
         delay(500);
-        Serial.print(".");
         attempts++;
+        if (attempts % 10 == 0) {
+            LOG_D(WIFI, "WiFi: Still connecting (%d s)", attempts / 2);
+        }
     }
-    Serial.println();
 
     if (wifiGotIP) {
-        DBG("WiFi: Connected! IP: %s, RSSI: %d dBm",
+        LOG_I(WIFI, "WiFi: Connected! IP: %s, RSSI: %d dBm",
             WiFi.localIP().toString().c_str(), WiFi.RSSI());
     } else {
-        DBG("WiFi: Connection failed after %d attempts, restarting...", attempts);
+        LOG_E(WIFI, "WiFi: Connection failed after %d attempts, restarting...", attempts);
+        flightRecord(FLIGHT_RESTART, "wifi_setup", attempts);
+        logFlush();
         delay(1000);
         ESP.restart();
     }
@@ -145,7 +202,11 @@ void setup() {
     // Load pairing state from NVS
     prefs.begin("yas-bridge", false);
     isPaired = prefs.getBool("paired", false);
-    DBG("BT: Paired state from NVS: %s", isPaired ? "YES" : "NO");
+    LOG_I(BT, "BT: Paired state from NVS: %s", isPaired ? "YES" : "NO");
+
+    // WiFi power save and BT sniff policy
+    initPowerProfile();
+    initKeepalive();
 
     // Initialize modules
     initBluetooth();
@@ -153,11 +214,15 @@ void setup() {
     initHttpServer();
 
     // Initial connections
+    initCoex();
     connectBluetooth();
     connectMqtt();
 
-    DBG("Setup complete, entering main loop");
-    Serial.println("----------------------------------------");
+    // Baseline once everything is allocated
+    initHeapMonitor();
+    initSupervisor();
+
+    LOG_I(SYS, "Setup complete, entering main loop");
 }
 
 // ============================================================================
@@ -165,50 +230,26 @@ void setup() {
 // ============================================================================
 
 void loop() {
+    unsigned long loopStart = micros();
+
+    // Requests are parsed by the HTTP task; only their handlers run here
     server.handleClient();
-    mqtt.loop();
+    serviceHttpRequests();
+    {
+        SupervisedCall call(SUB_MQTT);
+        mqtt.loop();
+    }
     checkWifiConnection();
 
     // Publish any pending BT status changes
     publishBtStatus();
 
-    // Check Bluetooth connection state
-    bool isConnected = SerialBT.connected();
-
-    // Detect disconnection
-    if (!isConnected && btConnected) {
-        unsigned long connectedDuration = millis() - btStats.connectedSince;
-        btStats.totalConnectedTime += connectedDuration;
-        btStats.disconnects++;
-
-        DBG("BT: Connection LOST after %lu ms (total disconnects: %lu)",
-            connectedDuration, btStats.disconnects);
-
-        setBtStatus("disconnected");
-        btConnected = false;
-
-        if (mqtt.connected()) {
-            mqtt.publish(MQTT_AVAILABLE_TOPIC, "offline", true);
-            publishBtStatus();
-        }
-    }
-
-    // Detect new connection
-    if (isConnected && !btConnected) {
-        btConnected = true;
-        btStats.connectedSince = millis();
-
-        DBG("BT: Connection ESTABLISHED");
-        setBtStatus("connected");
-
-        if (mqtt.connected()) {
-            mqtt.publish(MQTT_AVAILABLE_TOPIC, "online", true);
-            publishBtStatus();
-        }
-    }
+    // Apply SPP open/close events to the connection state
+    serviceBtEvents();
 
     // Reconnect if not connected (but respect hold-off period)
     if (!btConnected) {
+        supervisorBeat(SUB_BT);
         if (millis() >= reconnectHoldOffUntil &&
             millis() - lastBtConnectAttempt > BT_RECONNECT_DELAY_MS) {
             connectBluetooth();
@@ -221,34 +262,49 @@ void loop() {
         connectMqtt();
     }
 
-    // Poll soundbar status periodically
-    if (btConnected && millis() - lastStatusPoll > STATUS_POLL_INTERVAL_MS) {
+    // Poll soundbar status periodically (lowest priority, merged with any queued read);
+    // the interval depends on the power profile
+    if (btConnected && millis() - lastStatusPoll > statusPollIntervalMs()) {
         lastStatusPoll = millis();
-        YasStatus status = requestStatus();
-        if (status.valid) {
-            if (status.power != lastSoundbarStatus.power ||
-                status.input != lastSoundbarStatus.input ||
-                status.muted != lastSoundbarStatus.muted ||
-                status.volume != lastSoundbarStatus.volume ||
-                status.subwoofer != lastSoundbarStatus.subwoofer ||
-                status.surround != lastSoundbarStatus.surround ||
-                status.bass_ext != lastSoundbarStatus.bass_ext ||
-                status.clear_voice != lastSoundbarStatus.clear_voice) {
-                lastSoundbarStatus = status;
-                publishStatus(status);
-            }
-        }
+        queueStatusRequest(PRIO_POLL);
 
         // Read ESP32 internal temperature
         float currentTemp = temperatureRead();
         if (abs(currentTemp - lastTemperature) > 0.5) {
             lastTemperature = currentTemp;
             if (mqtt.connected()) {
-                String tempTopic = String(MQTT_BASE_TOPIC) + "/temperature";
-                mqtt.publish(tempTopic.c_str(), String(currentTemp, 1).c_str(), true);
+                char payload[12];
+                snprintf(payload, sizeof(payload), "%.1f", currentTemp);
+                mqttPublish(MQTT_TEMPERATURE_TOPIC, payload, true);
             }
         }
     }
 
+    // Compact diagnostics for long-term monitoring
+    if (mqtt.connected() && millis() - lastDiagnostics > MQTT_DIAGNOSTICS_INTERVAL_MS) {
+        lastDiagnostics = millis();
+        publishDiagnostics();
+    }
+
+    // Send at most one queued frame per iteration so user commands preempt
+    serviceBtTx();
+    processCommandQueue();
+    servicePlanner();
+    serviceCommandBatches();
+    serviceCoex();
+    servicePowerProfile();
+    serviceLinkPolicy();
+    serviceLinkQuality();
+    serviceKeepalive();
+
+    // Push state changes to /events subscribers
+    serviceEventStreams();
+    serviceHeapMonitor();
+    serviceTaskMonitor();
+    serviceSupervisor();
+
+    unsigned long loopUs = micros() - loopStart;
+    loopTimeHistogram.observe(loopUs);
+    flightLoop(loopUs);
     yield();
 }
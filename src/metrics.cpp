@@ -0,0 +1,256 @@
+#include "metrics.h"
+#include "state.h"
+#include "command_queue.h"
+#include "bluetooth.h"
+#include "mqtt_client.h"
+#include "event_stream.h"
+#include "debug.h"
+#include "heap_monitor.h"
+#include "json_arena.h"
+#include "supervisor.h"
+#include "coex.h"
+#include "link_policy.h"
+#include "link_quality.h"
+
+#include <WiFi.h>
+#include <stdarg.h>
+
+static const uint32_t loopBoundsUs[] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+static const uint32_t btRttBoundsMs[] = {
+    10, 25, 50, 100, 150, 200, 300, 500, 1000, 2000, 3000
+};
+
+Histogram loopTimeHistogram(loopBoundsUs, sizeof(loopBoundsUs) / sizeof(loopBoundsUs[0]), 1000000);
+Histogram btRttHistogram(btRttBoundsMs, sizeof(btRttBoundsMs) / sizeof(btRttBoundsMs[0]), 1000);
+
+Histogram::Histogram(const uint32_t* bounds, uint8_t boundCount, uint32_t unitsPerSecond)
+    : bounds(bounds),
+      boundCount(boundCount < METRICS_MAX_BUCKETS ? boundCount : METRICS_MAX_BUCKETS),
+      unitsPerSecond(unitsPerSecond) {
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void Histogram::observe(uint32_t value) {
+    uint8_t i = 0;
+    while (i < boundCount && value > bounds[i]) {
+        i++;
+    }
+    buckets[i]++;
+    sum += value;
+    count++;
+}
+
+// Appends to a fixed buffer; a family that overflows is cut back to where it started
+struct MetricsWriter {
+    char* buf;
+    size_t size;
+    size_t len = 0;
+    size_t familyStart = 0;
+    bool overflow = false;
+
+    MetricsWriter(char* buf, size_t size) : buf(buf), size(size) {}
+
+    void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (overflow) return;
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, size - len, fmt, args);
+        va_end(args);
+        if (n < 0 || (size_t)n >= size - len) {
+            overflow = true;
+        } else {
+            len += n;
+        }
+    }
+
+    void family(const char* name, const char* type, const char* help) {
+        endFamily();
+        printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+
+    void endFamily() {
+        if (overflow) {
+            len = familyStart;
+            overflow = false;
+        }
+        familyStart = len;
+    }
+};
+
+static void counter(MetricsWriter& w, const char* name, const char* help, unsigned long value) {
+    w.family(name, "counter", help);
+    w.printf("%s %lu\n", name, value);
+}
+
+static void gauge(MetricsWriter& w, const char* name, const char* help, long value) {
+    w.family(name, "gauge", help);
+    w.printf("%s %ld\n", name, value);
+}
+
+static void histogram(MetricsWriter& w, const char* name, const char* help, const Histogram& h) {
+    w.family(name, "histogram", help);
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i < h.boundCount; i++) {
+        cumulative += h.buckets[i];
+        w.printf("%s_bucket{le=\"%g\"} %u\n", name, (double)h.bounds[i] / h.unitsPerSecond,
+                 (unsigned)cumulative);
+    }
+    cumulative += h.buckets[h.boundCount];
+    w.printf("%s_bucket{le=\"+Inf\"} %u\n", name, (unsigned)cumulative);
+    w.printf("%s_sum %.6f\n", name, (double)h.sum / h.unitsPerSecond);
+    w.printf("%s_count %u\n", name, (unsigned)h.count);
+}
+
+static const char* methodName(HttpMethod method) {
+    switch (method) {
+        case HTTP_METHOD_GET: return "GET";
+        case HTTP_METHOD_POST: return "POST";
+        case HTTP_METHOD_ANY: return "ANY";
+        default: return "OTHER";
+    }
+}
+
+size_t renderMetrics(char* buf, size_t size) {
+    if (size == 0) return 0;
+    MetricsWriter w(buf, size);
+
+    // System
+    HeapSnapshot heap = heapSnapshot();
+    gauge(w, "yas_uptime_seconds", "Time since boot", millis() / 1000);
+    gauge(w, "yas_heap_free_bytes", "Free heap", heap.freeBytes);
+    gauge(w, "yas_heap_min_free_bytes", "Lowest free heap since boot", heap.minFreeBytes);
+    gauge(w, "yas_heap_largest_free_block_bytes", "Largest allocatable heap block", heap.largestBlock);
+    gauge(w, "yas_heap_fragmentation_percent", "Free heap not in the largest block", heap.fragmentationPct);
+    if (heapAllocTracking()) {
+        HeapCounters counters = heapCounters();
+        counter(w, "yas_heap_allocs_total", "Heap allocations", counters.allocs);
+        counter(w, "yas_heap_frees_total", "Heap frees", counters.frees);
+        counter(w, "yas_heap_failed_allocs_total", "Allocations that returned NULL", counters.failed);
+        counter(w, "yas_status_read_allocs_total", "Allocations during status polls, expected 0",
+            cmdQueueStats.statusReadAllocs);
+    }
+    if (WiFi.isConnected()) {
+        gauge(w, "yas_wifi_rssi_dbm", "WiFi signal strength", WiFi.RSSI());
+    }
+    gauge(w, "yas_json_arena_peak_bytes", "Most JSON arena memory in use at once", jsonArenaStats.peak);
+    counter(w, "yas_json_heap_fallbacks_total", "JSON allocations that spilled to the heap",
+        jsonArenaStats.heapFallbacks);
+    histogram(w, "yas_loop_duration_seconds", "Main loop iteration time", loopTimeHistogram);
+
+    // Bluetooth
+    gauge(w, "yas_bt_connected", "1 while the soundbar link is up", btConnected ? 1 : 0);
+    counter(w, "yas_bt_connect_attempts_total", "Connection attempts", btStats.connectAttempts);
+    counter(w, "yas_bt_connect_successes_total", "Successful connections", btStats.connectSuccesses);
+    counter(w, "yas_bt_connect_failures_total", "Failed connections", btStats.connectFailures);
+    counter(w, "yas_bt_disconnects_total", "Connection losses", btStats.disconnects);
+    w.family("yas_bt_last_connect_duration_seconds", "gauge", "Duration of the last connect");
+    w.printf("yas_bt_last_connect_duration_seconds %.3f\n", btStats.lastConnectDuration / 1000.0);
+    counter(w, "yas_bt_connected_seconds_total", "Time spent connected",
+        (btStats.totalConnectedTime + (btConnected ? millis() - btStats.connectedSince : 0)) / 1000);
+    counter(w, "yas_bt_sent_bytes_total", "Bytes sent to the soundbar", btStats.bytesSent);
+    counter(w, "yas_bt_received_bytes_total", "Bytes received from the soundbar", btStats.bytesReceived);
+    histogram(w, "yas_bt_rtt_seconds", "Status request round trip", btRttHistogram);
+
+    // Command queue
+    gauge(w, "yas_cmd_queue_depth", "Frames waiting", commandQueueDepth());
+    counter(w, "yas_cmd_frames_sent_total", "Command frames sent", cmdQueueStats.framesSent);
+    counter(w, "yas_cmd_status_reads_total", "Status reads", cmdQueueStats.statusReads);
+    counter(w, "yas_cmd_deduplicated_total", "Queued frames merged into an earlier one", cmdQueueStats.deduplicated);
+    counter(w, "yas_cmd_dropped_total", "Frames dropped on a full queue", cmdQueueStats.dropped);
+
+    // MQTT
+    gauge(w, "yas_mqtt_connected", "1 while connected to the broker", mqtt.connected() ? 1 : 0);
+    counter(w, "yas_mqtt_connects_total", "Broker connections", mqttStats.connects);
+    counter(w, "yas_mqtt_published_total", "Messages published", mqttStats.published);
+    counter(w, "yas_mqtt_dropped_total", "Messages that could not be published", mqttStats.dropped);
+    counter(w, "yas_mqtt_received_total", "Messages received", mqttStats.received);
+
+    // HTTP
+    w.family("yas_http_requests_total", "counter", "Requests by route");
+    for (size_t i = 0; i < server.routeCount(); i++) {
+        w.printf("yas_http_requests_total{route=\"%s\",method=\"%s\"} %lu\n",
+                 server.routePath(i), methodName(server.routeMethod(i)), server.routeRequests(i));
+    }
+    w.printf("yas_http_requests_total{route=\"unmatched\",method=\"ANY\"} %lu\n", server.stats.unmatched);
+    gauge(w, "yas_http_connections", "Open connections", server.activeConnections());
+    counter(w, "yas_http_connections_rejected_total", "Connections refused with all slots busy",
+        server.stats.connectionsRejected);
+    counter(w, "yas_http_parse_errors_total", "Malformed requests", server.stats.parseErrors);
+    counter(w, "yas_http_write_timeouts_total", "Connections closed with a response stalled",
+        server.stats.writeTimeouts);
+    gauge(w, "yas_events_subscribers", "Connected /events streams", eventSubscriberCount());
+
+    gauge(w, "yas_bt_stack_heap_bytes", "Heap taken by the BT stack and SPP transport at start",
+        btStackHeapBytes());
+
+    // SPP congestion
+    BtTxStats tx = btTxStats();
+    counter(w, "yas_bt_congestions_total", "SPP congestion episodes", tx.congestions);
+    w.family("yas_bt_congested_seconds_total", "counter", "Time the SPP link was congested");
+    w.printf("yas_bt_congested_seconds_total %.3f\n", tx.congestedMs / 1000.0);
+    counter(w, "yas_bt_tx_held_total", "Frames held while the link was congested", tx.held);
+    counter(w, "yas_bt_tx_dropped_total", "Held frames dropped (queue full or link lost)", tx.dropped);
+    gauge(w, "yas_bt_tx_depth", "Frames held now", btTxDepth());
+
+    // BT link mode
+    w.family("yas_bt_link_mode_seconds_total", "counter", "Connected time spent in each BT link mode");
+    for (int m = 0; m < LINK_MODE_COUNT; m++) {
+        w.printf("yas_bt_link_mode_seconds_total{mode=\"%s\"} %.3f\n", linkModeName((LinkMode)m),
+                 linkModeStats((LinkMode)m).timeMs / 1000.0);
+    }
+    LinkWakeStats wakes = linkWakeStats();
+    w.family("yas_bt_link_wake_seconds", "summary", "Frame sent in sniff until the link is active");
+    w.printf("yas_bt_link_wake_seconds_sum %.3f\n", wakes.sumMs / 1000.0);
+    w.printf("yas_bt_link_wake_seconds_count %lu\n", (unsigned long)wakes.count);
+    counter(w, "yas_bt_link_keepawake_reads_total", "Status reads sent to hold sniff off", linkKeepAwakeReads());
+
+    if (linkQualityValid()) {
+        gauge(w, "yas_bt_rssi_delta_db", "BT link RSSI relative to the golden receive range", linkQualityRssi());
+    }
+    counter(w, "yas_bt_weak_link_total", "Times the BT link RSSI average fell below the weak threshold",
+        linkQualityWeakCount());
+
+    // Radio coexistence
+    CoexModeStats coex[COEX_MODE_COUNT];
+    for (int m = 0; m < COEX_MODE_COUNT; m++) {
+        coex[m] = coexModeStats((CoexMode)m);
+    }
+    w.family("yas_coex_mode_seconds_total", "counter", "Time spent in each coexistence preference");
+    for (int m = 0; m < COEX_MODE_COUNT; m++) {
+        w.printf("yas_coex_mode_seconds_total{mode=\"%s\"} %.3f\n", coexModeName((CoexMode)m),
+                 coex[m].activeMs / 1000.0);
+    }
+    w.family("yas_coex_bt_rtt_seconds", "summary", "Status round trip by coexistence preference");
+    for (int m = 0; m < COEX_MODE_COUNT; m++) {
+        const char* mode = coexModeName((CoexMode)m);
+        w.printf("yas_coex_bt_rtt_seconds_sum{mode=\"%s\"} %.3f\n", mode, coex[m].btRttSumMs / 1000.0);
+        w.printf("yas_coex_bt_rtt_seconds_count{mode=\"%s\"} %lu\n", mode, (unsigned long)coex[m].btRttCount);
+    }
+    w.family("yas_coex_http_response_seconds", "summary", "HTTP response time by coexistence preference");
+    for (int m = 0; m < COEX_MODE_COUNT; m++) {
+        const char* mode = coexModeName((CoexMode)m);
+        w.printf("yas_coex_http_response_seconds_sum{mode=\"%s\"} %.6f\n", mode, coex[m].httpSumUs / 1e6);
+        w.printf("yas_coex_http_response_seconds_count{mode=\"%s\"} %lu\n", mode, (unsigned long)coex[m].httpCount);
+    }
+
+    // Supervisor
+    w.family("yas_supervisor_trips_total", "counter", "Subsystems found stuck or silent");
+    for (int i = 0; i < SUB_COUNT; i++) {
+        SubsystemHealth h = subsystemHealth((Subsystem)i);
+        w.printf("yas_supervisor_trips_total{subsystem=\"%s\"} %lu\n", h.name, (unsigned long)h.trips);
+    }
+    w.family("yas_supervisor_recoveries_total", "counter", "Trips cleared by soft recovery");
+    for (int i = 0; i < SUB_COUNT; i++) {
+        SubsystemHealth h = subsystemHealth((Subsystem)i);
+        w.printf("yas_supervisor_recoveries_total{subsystem=\"%s\"} %lu\n", h.name, (unsigned long)h.recoveries);
+    }
+
+    // Logging
+    counter(w, "yas_log_lines_total", "Log lines recorded", logStats.recorded);
+    counter(w, "yas_log_dropped_total", "Log lines dropped on a full ring", logStats.dropped);
+
+    w.endFamily();
+    return w.len;
+}
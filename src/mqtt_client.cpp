@@ -4,21 +4,39 @@
 #include "debug.h"
 #include "bluetooth.h"
 #include "yas_commands.h"
+#include "planner.h"
+#include "command_queue.h"
+#include "trace.h"
+#include "json_arena.h"
+#include "heap_monitor.h"
+#include "task_monitor.h"
+#include "flight_recorder.h"
+#include "supervisor.h"
+#include "coex.h"
+#include "link_quality.h"
 
 #include <WiFi.h>
 #include <ArduinoJson.h>
+#include <lwip/sockets.h>
+
+MqttStats mqttStats;
+
+static bool connectFailureRecorded = false;
+
+static void publishLastBoot();
 
 // Initialize MQTT
 void initMqtt() {
     mqtt.setServer(MQTT_HOST, MQTT_PORT);
     mqtt.setCallback(mqttCallback);
     mqtt.setBufferSize(1024);
-    DBG("MQTT: Configured for %s:%d", MQTT_HOST, MQTT_PORT);
+    LOG_I(MQTT, "MQTT: Configured for %s:%d", MQTT_HOST, MQTT_PORT);
 }
 
 // Connect to MQTT broker
 void connectMqtt() {
-    DBG("MQTT: Connecting to %s:%d...", MQTT_HOST, MQTT_PORT);
+    SupervisedCall call(SUB_MQTT);
+    LOG_I(MQTT, "MQTT: Connecting to %s:%d...", MQTT_HOST, MQTT_PORT);
 
     String clientId = "yas-bridge-" + String(WiFi.macAddress());
     clientId.replace(":", "");
@@ -32,27 +50,96 @@ void connectMqtt() {
     }
 
     if (connected) {
-        DBG("MQTT: Connected!");
-        mqtt.publish(MQTT_AVAILABLE_TOPIC, btConnected ? "online" : "offline", true);
+        LOG_I(MQTT, "MQTT: Connected!");
+        mqttStats.connects++;
+        connectFailureRecorded = false;
+        flightRecord(FLIGHT_MQTT, "connected");
+        mqttPublish(MQTT_AVAILABLE_TOPIC, btConnected ? "online" : "offline", true);
         mqtt.subscribe(MQTT_COMMAND_TOPIC);
         mqtt.subscribe(MQTT_VOLUME_TOPIC);
         mqtt.subscribe(MQTT_SUBWOOFER_TOPIC);
+        mqtt.subscribe(MQTT_SET_STATE_TOPIC);
         mqtt.subscribe(MQTT_RESTART_TOPIC);
         mqtt.subscribe(MQTT_RESET_PAIRING_TOPIC);
+        mqtt.subscribe(MQTT_LOG_LEVEL_TOPIC);
+        coexWifiBurst();
         publishDiscovery();
+        publishLastBoot();
         lastPublishedBtStatus = "";
         publishBtStatus();
 
+        // Republish what we know now, confirm it from the soundbar shortly
+        if (lastSoundbarStatus.valid) {
+            publishStatus(lastSoundbarStatus);
+        }
         if (btConnected) {
-            YasStatus status = requestStatus();
-            if (status.valid) {
-                lastSoundbarStatus = status;
-                publishStatus(status);
-            }
+            queueStatusRequest(PRIO_CONFIRM);
         }
     } else {
-        DBG("MQTT: Connection failed, rc=%d", mqtt.state());
+        LOG_W(MQTT, "MQTT: Connection failed, rc=%d", mqtt.state());
+        // Retries run every few seconds; one event per outage is enough
+        if (!connectFailureRecorded) {
+            connectFailureRecorded = true;
+            flightRecord(FLIGHT_MQTT, "connect_failed", mqtt.state());
+        }
+    }
+}
+
+MqttSocket::MqttSocket() {
+    _lock = xSemaphoreCreateMutex();
+}
+
+void MqttSocket::record(int fd) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _fd = fd;
+    xSemaphoreGive(_lock);
+}
+
+// A successful connect replaces (and closes) the previous socket, so that one
+// is forgotten first
+int MqttSocket::connect(IPAddress ip, uint16_t port) {
+    record(-1);
+    int ok = WiFiClient::connect(ip, port);
+    if (ok) record(fd());
+    return ok;
+}
+
+int MqttSocket::connect(const char* host, uint16_t port) {
+    record(-1);
+    int ok = WiFiClient::connect(host, port);
+    if (ok) record(fd());
+    return ok;
+}
+
+// PubSubClient and WiFiClient close the socket through here
+void MqttSocket::stop() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _fd = -1;
+    WiFiClient::stop();
+    xSemaphoreGive(_lock);
+}
+
+void MqttSocket::abort() {
+    // The loop task only holds the lock briefly; if it is stuck in there the
+    // restart after the grace period takes over
+    if (xSemaphoreTake(_lock, pdMS_TO_TICKS(100)) != pdTRUE) {
+        return;
+    }
+    if (_fd >= 0) {
+        shutdown(_fd, SHUT_RDWR);
     }
+    xSemaphoreGive(_lock);
+}
+
+// Supervisor task: make a stuck PubSubClient call return
+void abortMqttSocket() {
+    wifiClient.abort();
+}
+
+// Drop the broker connection (supervisor soft recovery); loop() reconnects
+void resetMqttConnection() {
+    mqtt.disconnect();
+    wifiClient.stop();
 }
 
 // MQTT message callback
@@ -62,48 +149,157 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
         message += (char)payload[i];
     }
 
-    DBG("MQTT RX: %s = %s", topic, message.c_str());
+    LOG_V(MQTT, "MQTT RX: %s = %s", topic, message.c_str());
+    mqttStats.received++;
 
     if (String(topic) == MQTT_COMMAND_TOPIC) {
+        TraceScope trace("mqtt command");
         if (isValidCommand(message)) {
-            if (sendCommand(message)) {
-                delay(100);
-                YasStatus status = requestStatus();
-                if (status.valid) {
-                    lastSoundbarStatus = status;
-                    publishStatus(status);
-                }
+            if (queueCommand(message, PRIO_USER)) {
+                queueStatusRequest(PRIO_CONFIRM);
             }
         } else {
-            DBG("MQTT: Invalid command: %s", message.c_str());
+            LOG_W(MQTT, "MQTT: Invalid command: %s", message.c_str());
         }
     } else if (String(topic) == MQTT_VOLUME_TOPIC) {
+        TraceScope trace("mqtt set_volume");
         int targetVolume = message.toInt();
         if (targetVolume >= 0 && targetVolume <= 50) {
             setVolume(targetVolume);
         }
     } else if (String(topic) == MQTT_SUBWOOFER_TOPIC) {
+        TraceScope trace("mqtt set_subwoofer");
         int targetSubwoofer = message.toInt();
         if (targetSubwoofer >= 0 && targetSubwoofer <= 32) {
             setSubwoofer(targetSubwoofer);
         }
+    } else if (String(topic) == MQTT_SET_STATE_TOPIC) {
+        TraceScope trace("mqtt set_state");
+        ArenaJsonDocument doc;
+        TargetState target;
+        String error;
+        if (deserializeJson(doc, message)) {
+            LOG_W(MQTT, "MQTT: Invalid state JSON");
+        } else if (!parseTargetState(doc.as<JsonVariantConst>(), target, error)) {
+            LOG_W(MQTT, "MQTT: Invalid state: %s", error.c_str());
+        } else if (!btConnected) {
+            LOG_W(MQTT, "MQTT: Set state ignored, not connected");
+        } else if (!startTargetState(target)) {
+            LOG_W(MQTT, "MQTT: Set state ignored, another state change is in progress");
+        }
     } else if (String(topic) == MQTT_RESTART_TOPIC) {
-        DBG("MQTT: Restart requested");
+        LOG_I(MQTT, "MQTT: Restart requested");
+        flightRecord(FLIGHT_RESTART, "mqtt");
+        logFlush();
         delay(100);
         ESP.restart();
     } else if (String(topic) == MQTT_RESET_PAIRING_TOPIC) {
-        DBG("MQTT: Reset pairing requested");
+        LOG_I(MQTT, "MQTT: Reset pairing requested");
         resetPairing();
+    } else if (String(topic) == MQTT_LOG_LEVEL_TOPIC) {
+        if (!setLogLevels(message)) {
+            LOG_W(MQTT, "MQTT: Invalid log levels: %s", message.c_str());
+        }
+    }
+}
+
+// Publish and count, a message that can't go out now is dropped (state is republished on reconnect)
+bool mqttPublish(const char* topic, const char* payload, bool retained) {
+    SupervisedCall call(SUB_MQTT);
+    if (mqtt.connected() && mqtt.publish(topic, payload, retained)) {
+        mqttStats.published++;
+        return true;
     }
+    mqttStats.dropped++;
+    return false;
+}
+
+// Publish a document from the static output buffer
+static bool publishJson(const char* topic, const JsonDocument& doc, bool retained) {
+    size_t length;
+    const char* payload = serializeJsonOutput(doc, length);
+    if (!payload) {
+        LOG_W(MQTT, "MQTT: Payload for %s too large", topic);
+        mqttStats.dropped++;
+        return false;
+    }
+    return mqttPublish(topic, payload, retained);
+}
+
+// Once per boot: why the previous boot ended, its last counters and final events
+static void publishLastBoot() {
+    static bool published = false;
+    if (published) return;
+
+    ArenaJsonDocument doc;
+    doc["boot"] = flightBootCount();
+    doc["reason"] = flightResetReason();
+
+    if (lastBootAvailable()) {
+        const FlightCounters& c = lastBootCounters();
+        doc["up"] = c.uptimeMs / 1000;
+        doc["bt_fail"] = c.btConnectFailures;
+        doc["bt_disc"] = c.btDisconnects;
+        doc["min_heap"] = c.minFreeHeap;
+        doc["loop_max"] = c.loopMaxMs;
+
+        // [time ms, type, text, value], newest last
+        JsonArray events = doc["events"].to<JsonArray>();
+        size_t count = lastBootEventCount();
+        size_t first = count > FLIGHT_MQTT_EVENTS ? count - FLIGHT_MQTT_EVENTS : 0;
+        for (size_t i = first; i < count; i++) {
+            const FlightEvent& e = lastBootEventAt(i);
+            JsonArray entry = events.add<JsonArray>();
+            entry.add(e.timeMs);
+            entry.add(flightEventName(e.type));
+            entry.add(e.text);
+            entry.add(e.value);
+        }
+    }
+
+    published = publishJson(MQTT_LASTBOOT_TOPIC, doc, true);
+}
+
+// Compact health snapshot: heap, RSSI, core load and per-task [name, cpu permille, free stack]
+void publishDiagnostics() {
+    HeapSnapshot heap = heapSnapshot();
+
+    ArenaJsonDocument doc;
+    doc["up"] = millis() / 1000;
+    doc["heap"] = heap.freeBytes;
+    doc["min_heap"] = heap.minFreeBytes;
+    doc["blk"] = heap.largestBlock;
+    doc["rssi"] = WiFi.RSSI();
+    if (linkQualityValid()) {
+        doc["bt_rssi"] = linkQualityRssi();
+    }
+    doc["q"] = commandQueueDepth();
+
+    if (taskCpuStatsAvailable()) {
+        JsonArray load = doc["load"].to<JsonArray>();
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            load.add(coreLoadPermille(core));
+        }
+    }
+
+    JsonArray tasks = doc["tasks"].to<JsonArray>();
+    for (size_t i = 0; i < taskCount(); i++) {
+        const TaskInfo& t = taskAt(i);
+        JsonArray entry = tasks.add<JsonArray>();
+        entry.add(t.name);
+        entry.add(t.cpuPermille);
+        entry.add(t.stackFreeBytes);
+    }
+
+    publishJson(MQTT_DIAGNOSTICS_TOPIC, doc, false);
 }
 
 // Publish BT status changes
 void publishBtStatus() {
     if (mqtt.connected() && lastBtStatus != lastPublishedBtStatus) {
-        String topic = String(MQTT_BASE_TOPIC) + "/bt_status";
-        mqtt.publish(topic.c_str(), lastBtStatus.c_str(), true);
+        mqttPublish(MQTT_BT_STATUS_TOPIC, lastBtStatus.c_str(), true);
         lastPublishedBtStatus = lastBtStatus;
-        DBG("MQTT: Published BT status: %s", lastBtStatus.c_str());
+        LOG_D(MQTT, "MQTT: Published BT status: %s", lastBtStatus.c_str());
     }
 }
 
@@ -111,33 +307,35 @@ void publishBtStatus() {
 void publishStatus(const YasStatus& status) {
     if (!mqtt.connected()) return;
 
-    JsonDocument doc;
+    ArenaJsonDocument doc;
     doc["power"] = status.power ? "ON" : "OFF";
-    doc["input"] = status.input;
+    doc["input"] = status.input.c_str();
     doc["muted"] = status.muted ? "ON" : "OFF";
     doc["volume"] = status.volume;
     doc["subwoofer"] = status.subwoofer;
-    doc["surround"] = status.surround;
+    doc["surround"] = status.surround.c_str();
     doc["bass_ext"] = status.bass_ext ? "ON" : "OFF";
     doc["clear_voice"] = status.clear_voice ? "ON" : "OFF";
 
-    String payload;
-    serializeJson(doc, payload);
-    mqtt.publish(MQTT_STATE_TOPIC, payload.c_str(), true);
+    publishJson(MQTT_STATE_TOPIC, doc, true);
 
-    DBG("MQTT TX: State published");
+    LOG_V(MQTT, "MQTT TX: State published");
 }
 
 // Set volume (stepped)
 void setVolume(int targetVolume) {
     if (!btConnected) {
-        DBG("Volume: Not connected");
+        LOG_W(CMD, "Volume: Not connected");
         return;
     }
 
-    YasStatus status = requestStatus();
+    // A new target supersedes a volume staircase still in flight; a subwoofer
+    // one shares the priority class and carries on
+    clearQueuedCommands(PRIO_VOLUME, CMD_TAG_VOLUME);
+
+    YasStatus status = queryStatusNow();
     if (!status.valid) {
-        DBG("Volume: Failed to get current status");
+        LOG_W(CMD, "Volume: Failed to get current status");
         return;
     }
 
@@ -147,32 +345,24 @@ void setVolume(int targetVolume) {
     String cmd = (diff > 0) ? "volume_up" : "volume_down";
     int steps = abs(diff);
 
-    DBG("Volume: %d -> %d (%d steps)", status.volume, targetVolume, steps);
+    LOG_D(CMD, "Volume: %d -> %d (%d steps)", status.volume, targetVolume, steps);
 
     for (int i = 0; i < steps && i < 50; i++) {
-        sendCommand(cmd);
-        delay(50);
-    }
-
-    delay(100);
-    status = requestStatus();
-    if (status.valid) {
-        lastSoundbarStatus = status;
-        publishStatus(status);
-        DBG("Volume: Now at %d", status.volume);
+        queueCommand(cmd, PRIO_VOLUME, 0, CMD_TAG_VOLUME);
     }
+    queueStatusRequest(PRIO_CONFIRM);
 }
 
 // Set subwoofer level (stepped by 4)
 void setSubwoofer(int targetSubwoofer) {
     if (!btConnected) {
-        DBG("Subwoofer: Not connected");
+        LOG_W(CMD, "Subwoofer: Not connected");
         return;
     }
 
-    YasStatus status = requestStatus();
+    YasStatus status = queryStatusNow();
     if (!status.valid) {
-        DBG("Subwoofer: Failed to get current status");
+        LOG_W(CMD, "Subwoofer: Failed to get current status");
         return;
     }
 
@@ -182,27 +372,19 @@ void setSubwoofer(int targetSubwoofer) {
     String cmd = (diff > 0) ? "subwoofer_up" : "subwoofer_down";
     int steps = abs(diff) / 4;
 
-    DBG("Subwoofer: %d -> %d (%d steps)", status.subwoofer, targetSubwoofer, steps);
+    LOG_D(CMD, "Subwoofer: %d -> %d (%d steps)", status.subwoofer, targetSubwoofer, steps);
 
     for (int i = 0; i < steps && i < 8; i++) {
-        sendCommand(cmd);
-        delay(50);
-    }
-
-    delay(100);
-    status = requestStatus();
-    if (status.valid) {
-        lastSoundbarStatus = status;
-        publishStatus(status);
-        DBG("Subwoofer: Now at %d", status.subwoofer);
+        queueCommand(cmd, PRIO_VOLUME, 0, CMD_TAG_SUBWOOFER);
     }
+    queueStatusRequest(PRIO_CONFIRM);
 }
 
 // Publish Home Assistant MQTT discovery
 void publishDiscovery() {
     // Power switch
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Power";
         doc["unique_id"] = "yas_power";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -217,14 +399,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/switch/yas_soundbar/power/config", payload.c_str(), true);
+        publishJson("homeassistant/switch/yas_soundbar/power/config", doc, true);
     }
 
     // Mute switch
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Mute";
         doc["unique_id"] = "yas_mute";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -239,14 +419,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/switch/yas_soundbar/mute/config", payload.c_str(), true);
+        publishJson("homeassistant/switch/yas_soundbar/mute/config", doc, true);
     }
 
     // Clear Voice switch
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Clear Voice";
         doc["unique_id"] = "yas_clear_voice";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -261,14 +439,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/switch/yas_soundbar/clear_voice/config", payload.c_str(), true);
+        publishJson("homeassistant/switch/yas_soundbar/clear_voice/config", doc, true);
     }
 
     // Bass Extension switch
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Bass Extension";
         doc["unique_id"] = "yas_bass_ext";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -283,14 +459,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/switch/yas_soundbar/bass_ext/config", payload.c_str(), true);
+        publishJson("homeassistant/switch/yas_soundbar/bass_ext/config", doc, true);
     }
 
     // Volume number
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Volume";
         doc["unique_id"] = "yas_volume";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -304,14 +478,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/number/yas_soundbar/volume/config", payload.c_str(), true);
+        publishJson("homeassistant/number/yas_soundbar/volume/config", doc, true);
     }
 
     // Subwoofer number
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Subwoofer";
         doc["unique_id"] = "yas_subwoofer";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -325,14 +497,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/number/yas_soundbar/subwoofer/config", payload.c_str(), true);
+        publishJson("homeassistant/number/yas_soundbar/subwoofer/config", doc, true);
     }
 
     // Input select
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Input";
         doc["unique_id"] = "yas_input";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -348,14 +518,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/select/yas_soundbar/input/config", payload.c_str(), true);
+        publishJson("homeassistant/select/yas_soundbar/input/config", doc, true);
     }
 
     // Surround select
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Surround";
         doc["unique_id"] = "yas_surround";
         doc["state_topic"] = MQTT_STATE_TOPIC;
@@ -374,17 +542,15 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/select/yas_soundbar/surround/config", payload.c_str(), true);
+        publishJson("homeassistant/select/yas_soundbar/surround/config", doc, true);
     }
 
     // ESP32 Temperature sensor
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "ESP32 Temperature";
         doc["unique_id"] = "yas_bridge_temperature";
-        doc["state_topic"] = String(MQTT_BASE_TOPIC) + "/temperature";
+        doc["state_topic"] = MQTT_TEMPERATURE_TOPIC;
         doc["unit_of_measurement"] = "°C";
         doc["device_class"] = "temperature";
         doc["availability_topic"] = MQTT_AVAILABLE_TOPIC;
@@ -392,31 +558,45 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/sensor/yas_soundbar/temperature/config", payload.c_str(), true);
+        publishJson("homeassistant/sensor/yas_soundbar/temperature/config", doc, true);
     }
 
     // Bluetooth status sensor
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Bluetooth Status";
         doc["unique_id"] = "yas_bridge_bt_status";
-        doc["state_topic"] = String(MQTT_BASE_TOPIC) + "/bt_status";
+        doc["state_topic"] = MQTT_BT_STATUS_TOPIC;
         doc["icon"] = "mdi:bluetooth";
         doc["availability_topic"] = MQTT_AVAILABLE_TOPIC;
         doc["device"]["identifiers"][0] = "yas_soundbar";
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/sensor/yas_soundbar/bt_status/config", payload.c_str(), true);
+        publishJson("homeassistant/sensor/yas_soundbar/bt_status/config", doc, true);
+    }
+
+    // Bluetooth link RSSI (delta to the golden receive range)
+    {
+        ArenaJsonDocument doc;
+        doc["name"] = "Bluetooth RSSI";
+        doc["unique_id"] = "yas_bridge_bt_rssi";
+        doc["state_topic"] = MQTT_BT_RSSI_TOPIC;
+        doc["unit_of_measurement"] = "dB";
+        doc["state_class"] = "measurement";
+        doc["entity_category"] = "diagnostic";
+        doc["icon"] = "mdi:bluetooth-audio";
+        doc["availability_topic"] = MQTT_AVAILABLE_TOPIC;
+        doc["device"]["identifiers"][0] = "yas_soundbar";
+        doc["device"]["name"] = "YAS Soundbar";
+        doc["device"]["manufacturer"] = "Yamaha";
+
+        publishJson("homeassistant/sensor/yas_soundbar/bt_rssi/config", doc, true);
     }
 
     // Restart button
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Restart Bridge";
         doc["unique_id"] = "yas_bridge_restart";
         doc["command_topic"] = MQTT_RESTART_TOPIC;
@@ -426,14 +606,12 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/button/yas_soundbar/restart/config", payload.c_str(), true);
+        publishJson("homeassistant/button/yas_soundbar/restart/config", doc, true);
     }
 
     // Reset Pairing button
     {
-        JsonDocument doc;
+        ArenaJsonDocument doc;
         doc["name"] = "Reset Pairing";
         doc["unique_id"] = "yas_soundbar_reset_pairing";
         doc["command_topic"] = MQTT_RESET_PAIRING_TOPIC;
@@ -443,10 +621,8 @@ void publishDiscovery() {
         doc["device"]["name"] = "YAS Soundbar";
         doc["device"]["manufacturer"] = "Yamaha";
 
-        String payload;
-        serializeJson(doc, payload);
-        mqtt.publish("homeassistant/button/yas_soundbar/reset_pairing/config", payload.c_str(), true);
+        publishJson("homeassistant/button/yas_soundbar/reset_pairing/config", doc, true);
     }
 
-    DBG("MQTT: Discovery published");
+    LOG_I(MQTT, "MQTT: Discovery published");
 }
@@ -0,0 +1,292 @@
+#include "planner.h"
+#include "state.h"
+#include "config.h"
+#include "debug.h"
+#include "bluetooth.h"
+#include "yas_commands.h"
+#include "command_queue.h"
+
+// Accept JSON booleans as well as Home Assistant style "ON"/"OFF"
+static bool parseBool(JsonVariantConst value, bool& out) {
+    if (value.is<bool>()) {
+        out = value.as<bool>();
+        return true;
+    }
+    if (value.is<const char*>()) {
+        String s = value.as<const char*>();
+        s.toLowerCase();
+        if (s == "on" || s == "true") {
+            out = true;
+            return true;
+        }
+        if (s == "off" || s == "false") {
+            out = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check a name against the values of a decode table
+static bool isKnownName(const std::map<String, String>& names, const String& name) {
+    for (const auto& entry : names) {
+        if (entry.second == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a JSON target state
+bool parseTargetState(JsonVariantConst json, TargetState& target, String& error) {
+    if (!json.is<JsonObjectConst>()) {
+        error = "Expected a JSON object";
+        return false;
+    }
+
+    if (!json["power"].isNull()) {
+        if (!parseBool(json["power"], target.power)) {
+            error = "Invalid power";
+            return false;
+        }
+        target.hasPower = true;
+    }
+
+    if (!json["input"].isNull()) {
+        target.input = json["input"].as<String>();
+        if (!isKnownName(INPUT_NAMES, target.input)) {
+            error = "Invalid input";
+            return false;
+        }
+        target.hasInput = true;
+    }
+
+    if (!json["surround"].isNull()) {
+        target.surround = json["surround"].as<String>();
+        if (!isKnownName(SURROUND_NAMES, target.surround)) {
+            error = "Invalid surround";
+            return false;
+        }
+        target.hasSurround = true;
+    }
+
+    if (!json["muted"].isNull()) {
+        if (!parseBool(json["muted"], target.muted)) {
+            error = "Invalid muted";
+            return false;
+        }
+        target.hasMuted = true;
+    }
+
+    if (!json["volume"].isNull()) {
+        if (!json["volume"].is<int>() || json["volume"].as<int>() < 0 || json["volume"].as<int>() > 50) {
+            error = "Invalid volume (0-50)";
+            return false;
+        }
+        target.volume = json["volume"].as<int>();
+        target.hasVolume = true;
+    }
+
+    if (!json["subwoofer"].isNull()) {
+        if (!json["subwoofer"].is<int>() || json["subwoofer"].as<int>() < 0 || json["subwoofer"].as<int>() > 32) {
+            error = "Invalid subwoofer (0-32)";
+            return false;
+        }
+        target.subwoofer = json["subwoofer"].as<int>();
+        target.hasSubwoofer = true;
+    }
+
+    if (!json["bass_ext"].isNull()) {
+        if (!parseBool(json["bass_ext"], target.bassExt)) {
+            error = "Invalid bass_ext";
+            return false;
+        }
+        target.hasBassExt = true;
+    }
+
+    if (!json["clear_voice"].isNull()) {
+        if (!parseBool(json["clear_voice"], target.clearVoice)) {
+            error = "Invalid clear_voice";
+            return false;
+        }
+        target.hasClearVoice = true;
+    }
+
+    return true;
+}
+
+// Diff target against current status
+// Explicit on/off and set_* opcodes are always used so the plan is idempotent;
+// only volume and subwoofer need stepping.
+std::vector<PlanStep> planCommands(const YasStatus& current, const TargetState& target) {
+    std::vector<PlanStep> steps;
+
+    if (target.hasPower && !target.power) {
+        // Everything else is moot once the soundbar is off
+        if (current.power) {
+            steps.push_back({"power_off", 0});
+        }
+        return steps;
+    }
+
+    if (target.hasPower && target.power && !current.power) {
+        steps.push_back({"power_on", PLAN_POWER_ON_SETTLE_MS});
+    }
+
+    if (target.hasInput && target.input != current.input) {
+        steps.push_back({"set_input_" + target.input, 0});
+    }
+
+    if (target.hasSurround && target.surround != current.surround) {
+        steps.push_back({"set_surround_" + target.surround, 0});
+    }
+
+    if (target.hasBassExt && target.bassExt != current.bass_ext) {
+        steps.push_back({target.bassExt ? "bass_ext_on" : "bass_ext_off", 0});
+    }
+
+    if (target.hasClearVoice && target.clearVoice != current.clear_voice) {
+        steps.push_back({target.clearVoice ? "clearvoice_on" : "clearvoice_off", 0});
+    }
+
+    if (target.hasVolume && target.volume != current.volume) {
+        int diff = target.volume - current.volume;
+        const char* cmd = (diff > 0) ? "volume_up" : "volume_down";
+        for (int i = 0; i < abs(diff) && i < 50; i++) {
+            steps.push_back({cmd, 0});
+        }
+    }
+
+    if (target.hasSubwoofer) {
+        // Subwoofer moves in steps of 4
+        int diff = target.subwoofer - current.subwoofer;
+        const char* cmd = (diff > 0) ? "subwoofer_up" : "subwoofer_down";
+        for (int i = 0; i < abs(diff) / 4 && i < 8; i++) {
+            steps.push_back({cmd, 0});
+        }
+    }
+
+    // Mute last so volume steps don't unmute behind our back
+    if (target.hasMuted && target.muted != current.muted) {
+        steps.push_back({target.muted ? "mute_on" : "mute_off", 0});
+    }
+
+    return steps;
+}
+
+// Target state job - one at a time, advanced from loop()
+enum PlanPhase : uint8_t {
+    PLAN_IDLE,
+    PLAN_READ_CURRENT,   // Waiting for the status read we diff against
+    PLAN_CONFIRM         // Steps queued, waiting for the confirming read
+};
+
+static struct {
+    PlanPhase phase = PLAN_IDLE;
+    TargetState target;
+    std::vector<PlanStep> steps;
+    PlanDoneCallback done;
+    unsigned long startedAt = 0;
+    unsigned long phaseStartedAt = 0;
+    unsigned long readMark = 0;       // cmdQueueStats.statusReads when the read was queued
+    TraceId trace = TRACE_NONE;       // Request that started the job, finished with it
+} job;
+
+static void finishJob(bool ok) {
+    // Steps still queued would go on changing the soundbar; user commands and
+    // batches at the same priority stay
+    if (!ok) {
+        clearQueuedCommands(PRIO_USER, CMD_TAG_PLANNER);
+    }
+    LOG_I(CMD, "Planner: %s (%d commands, %lu ms)", ok ? "Done" : "Failed",
+        (int)job.steps.size(), millis() - job.startedAt);
+    job.phase = PLAN_IDLE;
+    traceFinish(job.trace);
+    job.trace = TRACE_NONE;
+    PlanDoneCallback done = job.done;
+    job.done = nullptr;
+    if (done) {
+        done(ok, job.steps);
+    }
+}
+
+static void queueJobRead(PlanPhase phase) {
+    job.phase = phase;
+    job.phaseStartedAt = millis();
+    job.readMark = cmdQueueStats.statusReads;
+    queueStatusRequest(PRIO_USER, job.trace);
+}
+
+// A status read queued by this job has completed
+static bool jobReadDone() {
+    return cmdQueueStats.statusReads > job.readMark && commandQueueIdle(PRIO_USER);
+}
+
+// The read succeeded (lastSoundbarStatus is newer than the request)
+static bool jobReadValid() {
+    return lastSoundbarStatus.valid && (long)(lastStatusUpdate - job.phaseStartedAt) >= 0;
+}
+
+bool startTargetState(const TargetState& target, PlanDoneCallback done) {
+    if (job.phase != PLAN_IDLE) {
+        return false;
+    }
+
+    job.target = target;
+    job.steps.clear();
+    job.done = done;
+    job.startedAt = millis();
+    job.trace = traceClaimCurrent();
+    queueJobRead(PLAN_READ_CURRENT);
+    return true;
+}
+
+void servicePlanner() {
+    if (job.phase == PLAN_IDLE) {
+        return;
+    }
+
+    if (!btConnected || millis() - job.startedAt > BATCH_TIMEOUT_MS) {
+        finishJob(false);
+        return;
+    }
+
+    if (!jobReadDone()) {
+        return;
+    }
+
+    if (!jobReadValid()) {
+        finishJob(false);
+        return;
+    }
+
+    if (job.phase == PLAN_CONFIRM) {
+        finishJob(true);
+        return;
+    }
+
+    job.steps = planCommands(lastSoundbarStatus, job.target);
+    LOG_D(CMD, "Planner: %d commands to reach target", (int)job.steps.size());
+    if (job.steps.empty()) {
+        finishJob(true);
+        return;
+    }
+
+    // Same class as the confirming read, so the read goes out after the last step.
+    // Steps are queued under the job's trace, as its handler is long gone.
+    TraceId outer = traceCurrent();
+    traceSetCurrent(job.trace);
+    bool queued = true;
+    for (const PlanStep& step : job.steps) {
+        if (!queueCommand(step.command, PRIO_USER, step.delayAfterMs, CMD_TAG_PLANNER)) {
+            queued = false;
+            break;
+        }
+    }
+    traceSetCurrent(outer);
+    if (!queued) {
+        finishJob(false);
+        return;
+    }
+    queueJobRead(PLAN_CONFIRM);
+}
@@ -0,0 +1,186 @@
+#include "power.h"
+#include "config.h"
+#include "debug.h"
+#include "state.h"
+#include "keepalive.h"
+
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <ping/ping_sock.h>
+#include <freertos/FreeRTOS.h>
+
+static const char* const profileNames[POWER_PROFILE_COUNT] = {"latency", "balanced", "eco"};
+
+static PowerProfile profile = POWER_PROFILE_DEFAULT;
+static bool lowPower = false;         // Power save and sniff currently allowed
+static bool applied = false;
+static volatile wifi_ps_type_t wifiPs = WIFI_PS_MIN_MODEM;
+
+static LatencyStats probeStats[WIFI_PS_MODES];
+static portMUX_TYPE probeMux = portMUX_INITIALIZER_UNLOCKED;
+static esp_ping_handle_t probe = nullptr;
+
+const char* powerProfileName(PowerProfile p) {
+    return p < POWER_PROFILE_COUNT ? profileNames[p] : "?";
+}
+
+// Whether the soundbar is in use; unknown counts as not
+static bool soundbarActive() {
+    return btConnected && lastSoundbarStatus.valid && lastSoundbarStatus.power;
+}
+
+static bool wantLowPower() {
+    switch (profile) {
+        case POWER_LATENCY: return false;
+        case POWER_ECO: return true;
+        default: return !soundbarActive();
+    }
+}
+
+// Beacon intervals between wakeups in max modem sleep; used from the next association
+static void setListenInterval(uint16_t interval) {
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK || config.sta.listen_interval == interval) {
+        return;
+    }
+    config.sta.listen_interval = interval;
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &config);
+    if (err != ESP_OK) {
+        LOG_W(WIFI, "POWER: Setting listen interval failed: %s", esp_err_to_name(err));
+    }
+}
+
+static void apply(bool low) {
+    if (applied && low == lowPower) {
+        return;
+    }
+    applied = true;
+    lowPower = low;
+
+    // With BT Classic running, coexistence rejects WIFI_PS_NONE; min modem
+    // (wake for every DTIM) is the floor
+    bool eco = low && profile == POWER_ECO;
+    wifi_ps_type_t wanted = eco ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM;
+    setListenInterval(eco ? POWER_ECO_LISTEN_INTERVAL : POWER_LISTEN_INTERVAL);
+
+    // Through the Arduino layer so a later WiFi.mode() keeps the setting
+    if (!WiFi.setSleep(wanted)) {
+        LOG_W(WIFI, "POWER: WiFi power save %s rejected", wifiPowerSaveName(wanted));
+    }
+    wifi_ps_type_t actual;
+    if (esp_wifi_get_ps(&actual) == ESP_OK) {
+        wifiPs = actual;
+    }
+    LOG_I(WIFI, "POWER: %s profile, WiFi power save %s, BT sniff %s", profileNames[profile],
+        wifiPowerSaveName(wifiPs), low ? "allowed" : "held off");
+}
+
+// Ping task
+static void onProbeSuccess(esp_ping_handle_t hdl, void*) {
+    uint32_t ms = 0;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_TIMEGAP, &ms, sizeof(ms));
+    portENTER_CRITICAL(&probeMux);
+    LatencyStats& s = probeStats[wifiPs];
+    s.count++;
+    s.sumMs += ms;
+    if (ms > s.maxMs) s.maxMs = ms;
+    portEXIT_CRITICAL(&probeMux);
+}
+
+static void onProbeTimeout(esp_ping_handle_t, void*) {
+    portENTER_CRITICAL(&probeMux);
+    probeStats[wifiPs].timeouts++;
+    portEXIT_CRITICAL(&probeMux);
+}
+
+static void startProbe() {
+    IPAddress gateway = WiFi.gatewayIP();
+    if ((uint32_t)gateway == 0) {
+        LOG_W(WIFI, "POWER: No gateway, latency probe disabled");
+        return;
+    }
+
+    esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+    IP_ADDR4(&config.target_addr, gateway[0], gateway[1], gateway[2], gateway[3]);
+    config.count = ESP_PING_COUNT_INFINITE;
+    config.interval_ms = POWER_PROBE_INTERVAL_MS;
+    config.data_size = 16;
+
+    esp_ping_callbacks_t cbs = {};
+    cbs.on_ping_success = onProbeSuccess;
+    cbs.on_ping_timeout = onProbeTimeout;
+
+    if (esp_ping_new_session(&config, &cbs, &probe) != ESP_OK || esp_ping_start(probe) != ESP_OK) {
+        LOG_W(WIFI, "POWER: Could not start latency probe");
+        probe = nullptr;
+    }
+}
+
+void initPowerProfile() {
+    uint8_t saved = prefs.getUChar("power", POWER_PROFILE_DEFAULT);
+    profile = saved < POWER_PROFILE_COUNT ? (PowerProfile)saved : POWER_PROFILE_DEFAULT;
+    apply(wantLowPower());
+    startProbe();
+}
+
+void servicePowerProfile() {
+    apply(wantLowPower());
+}
+
+void setPowerProfile(PowerProfile p) {
+    if (p >= POWER_PROFILE_COUNT) return;
+    if (p != profile) {
+        profile = p;
+        prefs.putUChar("power", p);
+        applied = false;
+    }
+    apply(wantLowPower());
+}
+
+bool parsePowerProfile(const String& name, PowerProfile& p) {
+    for (int i = 0; i < POWER_PROFILE_COUNT; i++) {
+        if (name.equalsIgnoreCase(profileNames[i])) {
+            p = (PowerProfile)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+PowerProfile powerProfile() {
+    return profile;
+}
+
+wifi_ps_type_t wifiPowerSave() {
+    return wifiPs;
+}
+
+const char* wifiPowerSaveName(wifi_ps_type_t ps) {
+    switch (ps) {
+        case WIFI_PS_NONE: return "off";
+        case WIFI_PS_MIN_MODEM: return "min_modem";
+        case WIFI_PS_MAX_MODEM: return "max_modem";
+        default: return "?";
+    }
+}
+
+bool btSniffAllowed() {
+    return lowPower;
+}
+
+unsigned long statusPollIntervalMs() {
+    unsigned long interval = lowPower && !soundbarActive() ? POWER_IDLE_POLL_MS : STATUS_POLL_INTERVAL_MS;
+    // Polls are traffic too; polling inside a learned idle timeout makes separate keepalives unnecessary
+    uint32_t keepalive = keepaliveIntervalMs();
+    return keepalive > 0 && keepalive < interval ? keepalive : interval;
+}
+
+LatencyStats inboundLatency(wifi_ps_type_t ps) {
+    LatencyStats s = {};
+    if ((int)ps < WIFI_PS_MODES) {
+        portENTER_CRITICAL(&probeMux);
+        s = probeStats[ps];
+        portEXIT_CRITICAL(&probeMux);
+    }
+    return s;
+}
@@ -0,0 +1,341 @@
+#ifdef BT_RAW_SPP
+
+#include "spp_transport.h"
+#include "debug.h"
+
+#include <esp_bt.h>
+#include <esp_bt_main.h>
+#include <esp_bt_device.h>
+
+#define EVT_INIT        BIT0
+#define EVT_DISCOVERY   BIT1      // SDP finished (scn set on success)
+#define EVT_OPEN        BIT2
+#define EVT_CLOSE       BIT3
+#define EVT_INQUIRY     BIT4      // Inquiry stopped
+#define EVT_FOUND       BIT5      // Inquiry found the wanted name
+
+static SppTransport* instance = nullptr;
+static bool bleMemoryReleased = false;
+
+// initArduino() releases all BT controller memory unless btInUse() says
+// otherwise. The core's weak default returns false and only BluetoothSerial
+// (through esp32-hal-bt) overrides it; without this the controller init fails
+// on freed memory and the board resets in a loop.
+extern "C" bool btInUse() {
+    return true;
+}
+
+size_t SppTransport::bufferBytes() {
+    return sizeof(SppTransport);
+}
+
+bool SppTransport::waitFor(EventBits_t bits, uint32_t timeoutMs) {
+    return xEventGroupWaitBits(_events, bits, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutMs)) & bits;
+}
+
+bool SppTransport::begin(const char* name, bool master) {
+    instance = this;
+    if (!_events) {
+        _events = xEventGroupCreate();
+        _frameReady = xSemaphoreCreateBinary();
+    }
+    if (!_events || !_frameReady) {
+        return false;
+    }
+    xEventGroupClearBits(_events, 0xFF);
+
+    // BLE is never used; its controller memory (~30 KB) goes back to the heap
+    if (!bleMemoryReleased) {
+        esp_bt_controller_mem_release(ESP_BT_MODE_BLE);
+        bleMemoryReleased = true;
+    }
+
+    if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_IDLE) {
+        esp_bt_controller_config_t cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+        cfg.mode = ESP_BT_MODE_CLASSIC_BT;
+        if (esp_bt_controller_init(&cfg) != ESP_OK) {
+            LOG_E(BT, "SPP: Controller init failed");
+            return false;
+        }
+    }
+    if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_INITED &&
+        esp_bt_controller_enable(ESP_BT_MODE_CLASSIC_BT) != ESP_OK) {
+        LOG_E(BT, "SPP: Controller enable failed");
+        return false;
+    }
+
+    if (esp_bluedroid_get_status() == ESP_BLUEDROID_STATUS_UNINITIALIZED && esp_bluedroid_init() != ESP_OK) {
+        LOG_E(BT, "SPP: Bluedroid init failed");
+        return false;
+    }
+    if (esp_bluedroid_get_status() != ESP_BLUEDROID_STATUS_ENABLED && esp_bluedroid_enable() != ESP_OK) {
+        LOG_E(BT, "SPP: Bluedroid enable failed");
+        return false;
+    }
+
+    esp_spp_register_callback(sppCallback);
+    if (esp_spp_init(ESP_SPP_MODE_CB) != ESP_OK || !waitFor(EVT_INIT, 2000)) {
+        LOG_E(BT, "SPP: Init failed");
+        return false;
+    }
+
+    esp_bt_dev_set_device_name(name);
+    esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, master ? ESP_BT_NON_DISCOVERABLE : ESP_BT_GENERAL_DISCOVERABLE);
+    return true;
+}
+
+void SppTransport::end() {
+    disconnect();
+    esp_spp_deinit();
+    esp_bluedroid_disable();
+    esp_bluedroid_deinit();
+    esp_bt_controller_disable();
+    esp_bt_controller_deinit();
+    _handle = 0;
+}
+
+esp_err_t SppTransport::register_callback(esp_spp_cb_t callback) {
+    _callback = callback;
+    return ESP_OK;
+}
+
+bool SppTransport::connect(uint8_t addr[6]) {
+    if (_handle != 0) {
+        return true;
+    }
+
+    xEventGroupClearBits(_events, EVT_DISCOVERY | EVT_OPEN | EVT_CLOSE);
+    _scn = 0;
+    if (esp_spp_start_discovery(addr) != ESP_OK || !waitFor(EVT_DISCOVERY, BT_RAW_CONNECT_TIMEOUT_MS)) {
+        LOG_W(BT, "SPP: Service discovery timed out");
+        return false;
+    }
+    if (_scn == 0) {
+        LOG_W(BT, "SPP: No SPP service on the remote device");
+        return false;
+    }
+
+    if (esp_spp_connect(ESP_SPP_SEC_ENCRYPT | ESP_SPP_SEC_AUTHENTICATE, ESP_SPP_ROLE_MASTER, _scn, addr) != ESP_OK) {
+        return false;
+    }
+    waitFor(EVT_OPEN | EVT_CLOSE, BT_RAW_CONNECT_TIMEOUT_MS);
+    return _handle != 0;
+}
+
+bool SppTransport::connect(const char* name) {
+    if (_handle != 0) {
+        return true;
+    }
+
+    _wantedName = name;
+    xEventGroupClearBits(_events, EVT_INQUIRY | EVT_FOUND);
+    if (esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, BT_RAW_INQUIRY_UNITS, 0) != ESP_OK) {
+        _wantedName = nullptr;
+        return false;
+    }
+    // Inquiry length is in units of 1.28 s
+    waitFor(EVT_FOUND | EVT_INQUIRY, BT_RAW_INQUIRY_UNITS * 1280 + 1000);
+    bool found = xEventGroupGetBits(_events) & EVT_FOUND;
+    esp_bt_gap_cancel_discovery();
+    _wantedName = nullptr;
+    if (!found) {
+        LOG_W(BT, "SPP: \"%s\" not found by inquiry", name);
+        return false;
+    }
+    return connect(_found);
+}
+
+bool SppTransport::connected(int timeoutMs) {
+    if (_handle == 0 && timeoutMs > 0) {
+        waitFor(EVT_OPEN, timeoutMs);
+    }
+    return _handle != 0;
+}
+
+bool SppTransport::hasClient() {
+    return _handle != 0;
+}
+
+bool SppTransport::disconnect() {
+    uint32_t handle = _handle;
+    if (handle == 0) {
+        return true;
+    }
+    xEventGroupClearBits(_events, EVT_CLOSE);
+    if (esp_spp_disconnect(handle) != ESP_OK) {
+        return false;
+    }
+    return waitFor(EVT_CLOSE, 1000);
+}
+
+size_t SppTransport::write(const uint8_t* data, size_t len) {
+    uint32_t handle = _handle;
+    if (handle == 0 || len == 0) {
+        return 0;
+    }
+    // The stack copies the data before this returns
+    return esp_spp_write(handle, len, (uint8_t*)data) == ESP_OK ? len : 0;
+}
+
+int SppTransport::available() {
+    portENTER_CRITICAL(&_rxMux);
+    int bytes = -(int)_readOffset;
+    for (size_t i = 0; i < _frameCount; i++) {
+        bytes += _frames[(_frameHead + i) % BT_RAW_RX_FRAMES].len;
+    }
+    portEXIT_CRITICAL(&_rxMux);
+    return bytes;
+}
+
+int SppTransport::read() {
+    int byte = -1;
+    portENTER_CRITICAL(&_rxMux);
+    if (_frameCount > 0) {
+        RxFrame& frame = _frames[_frameHead];
+        byte = frame.data[_readOffset++];
+        if (_readOffset >= frame.len) {
+            _frameHead = (_frameHead + 1) % BT_RAW_RX_FRAMES;
+            _frameCount--;
+            _readOffset = 0;
+        }
+    }
+    portEXIT_CRITICAL(&_rxMux);
+    return byte;
+}
+
+size_t SppTransport::readFrame(uint8_t* buffer, size_t size, uint32_t timeoutMs, unsigned long& receivedAt) {
+    for (;;) {
+        size_t len = 0;
+        portENTER_CRITICAL(&_rxMux);
+        if (_frameCount > 0) {
+            const RxFrame& frame = _frames[_frameHead];
+            len = frame.len - _readOffset;
+            if (len > size) len = size;
+            memcpy(buffer, frame.data + _readOffset, len);
+            receivedAt = frame.receivedAt;
+            _frameHead = (_frameHead + 1) % BT_RAW_RX_FRAMES;
+            _frameCount--;
+            _readOffset = 0;
+        }
+        portEXIT_CRITICAL(&_rxMux);
+
+        if (len > 0) {
+            return len;
+        }
+        if (xSemaphoreTake(_frameReady, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+            return 0;
+        }
+    }
+}
+
+// BT task: assemble cc aa len payload checksum frames into the slots
+void SppTransport::receive(const uint8_t* data, size_t len) {
+    bool completed = false;
+    portENTER_CRITICAL(&_rxMux);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        bool badHeader = (_partialLen == 0 && b != 0xcc) || (_partialLen == 1 && b != 0xaa) ||
+            (_partialLen == 2 && (size_t)b + 4 > BT_RAW_FRAME_BYTES);
+        if (badHeader) {
+            // The byte that broke the header may itself start the next frame
+            _rxDiscarded += _partialLen;
+            _partialLen = 0;
+            if (b != 0xcc) {
+                _rxDiscarded++;
+                continue;
+            }
+        }
+        _partial[_partialLen++] = b;
+
+        if (_partialLen >= 3 && _partialLen == (size_t)_partial[2] + 4) {
+            if (_frameCount < BT_RAW_RX_FRAMES) {
+                RxFrame& frame = _frames[(_frameHead + _frameCount) % BT_RAW_RX_FRAMES];
+                memcpy(frame.data, _partial, _partialLen);
+                frame.len = _partialLen;
+                frame.receivedAt = millis();
+                _frameCount++;
+                completed = true;
+            } else {
+                _rxOverflows++;
+            }
+            _partialLen = 0;
+        }
+    }
+    portEXIT_CRITICAL(&_rxMux);
+
+    if (completed) {
+        xSemaphoreGive(_frameReady);
+    }
+}
+
+void SppTransport::sppCallback(esp_spp_cb_event_t event, esp_spp_cb_param_t* param) {
+    if (instance) {
+        instance->handleEvent(event, param);
+    }
+}
+
+void SppTransport::handleEvent(esp_spp_cb_event_t event, esp_spp_cb_param_t* param) {
+    switch (event) {
+        case ESP_SPP_INIT_EVT:
+            xEventGroupSetBits(_events, EVT_INIT);
+            break;
+        case ESP_SPP_DISCOVERY_COMP_EVT:
+            if (param->disc_comp.status == ESP_SPP_SUCCESS && param->disc_comp.scn_num > 0) {
+                _scn = param->disc_comp.scn[0];
+            }
+            xEventGroupSetBits(_events, EVT_DISCOVERY);
+            break;
+        case ESP_SPP_OPEN_EVT:
+            _handle = param->open.handle;
+            _partialLen = 0;
+            xEventGroupSetBits(_events, EVT_OPEN);
+            break;
+        case ESP_SPP_CLOSE_EVT:
+            if (param->close.handle == _handle) {
+                _handle = 0;
+            }
+            xEventGroupSetBits(_events, EVT_CLOSE);
+            break;
+        case ESP_SPP_DATA_IND_EVT:
+            receive(param->data_ind.data, param->data_ind.len);
+            break;
+        default:
+            break;
+    }
+
+    if (_callback) {
+        _callback(event, param);
+    }
+}
+
+void SppTransport::onGapEvent(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t* param) {
+    if (event == ESP_BT_GAP_DISC_STATE_CHANGED_EVT) {
+        if (param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STOPPED) {
+            xEventGroupSetBits(_events, EVT_INQUIRY);
+        }
+        return;
+    }
+    if (event != ESP_BT_GAP_DISC_RES_EVT || !_wantedName) {
+        return;
+    }
+
+    for (int i = 0; i < param->disc_res.num_prop; i++) {
+        const esp_bt_gap_dev_prop_t& prop = param->disc_res.prop[i];
+        const char* name = nullptr;
+        uint8_t nameLen = 0;
+        if (prop.type == ESP_BT_GAP_DEV_PROP_BDNAME) {
+            name = (const char*)prop.val;
+            nameLen = strnlen(name, prop.len);
+        } else if (prop.type == ESP_BT_GAP_DEV_PROP_EIR) {
+            name = (const char*)esp_bt_gap_resolve_eir_data((uint8_t*)prop.val,
+                ESP_BT_EIR_TYPE_CMPL_LOCAL_NAME, &nameLen);
+        }
+        if (name && nameLen == strlen(_wantedName) && strncmp(name, _wantedName, nameLen) == 0) {
+            memcpy(_found, param->disc_res.bda, sizeof(esp_bd_addr_t));
+            xEventGroupSetBits(_events, EVT_FOUND | EVT_INQUIRY);
+            return;
+        }
+    }
+}
+
+#endif
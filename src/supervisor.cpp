@@ -0,0 +1,175 @@
+#include "supervisor.h"
+#include "config.h"
+#include "debug.h"
+#include "state.h"
+#include "bluetooth.h"
+#include "mqtt_client.h"
+#include "flight_recorder.h"
+
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+struct SubsystemLimits {
+    const char* name;
+    bool onLoop;              // Beats come from loop(), so a supervised call holds them up
+    uint32_t beatTimeoutMs;   // 0: heartbeats not checked
+    uint32_t callTimeoutMs;   // 0: no supervised calls
+    void (*unblock)();        // Supervisor task: make a stuck call return
+    void (*recover)();        // Loop task: soft recovery
+};
+
+static const SubsystemLimits limits[SUB_COUNT] = {
+    {"loop", true, SUPERVISOR_LOOP_TIMEOUT_MS, 0, nullptr, nullptr},
+    {"wifi", true, SUPERVISOR_WIFI_TIMEOUT_MS, 0, nullptr, resetWifi},
+    {"bt", true, SUPERVISOR_BT_SILENT_MS, SUPERVISOR_BT_CALL_TIMEOUT_MS, abortBtCall, restartBluetooth},
+    {"mqtt", true, 0, SUPERVISOR_MQTT_CALL_TIMEOUT_MS, abortMqttSocket, resetMqttConnection},
+    {"http", false, SUPERVISOR_HTTP_TIMEOUT_MS, 0, nullptr, nullptr},
+};
+
+struct SubsystemState {
+    volatile uint32_t lastBeat;
+    volatile uint32_t callStart;
+    volatile uint8_t callDepth;       // Loop task only writes
+    volatile bool recovering;         // Supervisor task only writes
+    uint32_t recoveryStart;
+    volatile uint32_t trips;
+    volatile uint32_t recoveries;
+};
+
+static SubsystemState subs[SUB_COUNT];
+static uint32_t recoveryRequests = 0;    // Bit per subsystem, handed to loop()
+
+const char* subsystemName(Subsystem sub) {
+    return sub < SUB_COUNT ? limits[sub].name : "?";
+}
+
+void supervisorBeat(Subsystem sub) {
+    subs[sub].lastBeat = millis();
+}
+
+SupervisedCall::SupervisedCall(Subsystem sub) : _sub(sub) {
+    SubsystemState& s = subs[sub];
+    if (s.callDepth == 0) {
+        s.callStart = millis();
+    }
+    s.callDepth = s.callDepth + 1;
+}
+
+SupervisedCall::~SupervisedCall() {
+    SubsystemState& s = subs[_sub];
+    s.callDepth = s.callDepth - 1;
+}
+
+// What is wrong with a subsystem (and for how long), nullptr if nothing
+static const char* checkSubsystem(int i, uint32_t now, bool callActive, uint32_t& overdueMs) {
+    const SubsystemLimits& l = limits[i];
+    SubsystemState& s = subs[i];
+
+    if (l.callTimeoutMs && s.callDepth > 0) {
+        uint32_t callMs = now - s.callStart;
+        if (callMs > l.callTimeoutMs) {
+            overdueMs = callMs;
+            return "stuck";
+        }
+    }
+
+    // A call that is still within its limit holds loop() up legitimately
+    if (l.beatTimeoutMs && !(l.onLoop && callActive)) {
+        uint32_t age = now - s.lastBeat;
+        if (age > l.beatTimeoutMs) {
+            overdueMs = age;
+            return "silent";
+        }
+    }
+    return nullptr;
+}
+
+static void supervisorTask(void*) {
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_CHECK_MS));
+        uint32_t now = millis();
+
+        bool callActive = false;
+        for (int i = 0; i < SUB_COUNT; i++) {
+            if (subs[i].callDepth > 0) callActive = true;
+        }
+
+        for (int i = 0; i < SUB_COUNT; i++) {
+            const SubsystemLimits& l = limits[i];
+            SubsystemState& s = subs[i];
+            uint32_t overdueMs = 0;
+            const char* problem = checkSubsystem(i, now, callActive, overdueMs);
+
+            if (!problem) {
+                if (s.recovering) {
+                    s.recovering = false;
+                    s.recoveries = s.recoveries + 1;
+                    LOG_I(SYS, "SUPERVISOR: %s recovered", l.name);
+                }
+                continue;
+            }
+
+            if (!s.recovering) {
+                s.recovering = true;
+                s.recoveryStart = now;
+                s.trips = s.trips + 1;
+                LOG_W(SYS, "SUPERVISOR: %s %s for %lu ms, %s", l.name, problem, (unsigned long)overdueMs,
+                    l.recover ? "recovering" : "no soft recovery");
+                flightRecord(FLIGHT_SUPERVISOR, l.name, overdueMs);
+                if (l.unblock) {
+                    l.unblock();
+                }
+                if (l.recover) {
+                    __atomic_fetch_or(&recoveryRequests, 1u << i, __ATOMIC_RELAXED);
+                }
+                continue;
+            }
+
+            if (now - s.recoveryStart > SUPERVISOR_RECOVERY_GRACE_MS) {
+                LOG_E(SYS, "SUPERVISOR: %s still %s after %lu ms, restarting", l.name, problem,
+                    (unsigned long)(now - s.recoveryStart));
+                char reason[16];
+                snprintf(reason, sizeof(reason), "sup_%s", l.name);
+                flightRecord(FLIGHT_RESTART, reason, overdueMs);
+                logFlush();
+                esp_restart();
+            }
+        }
+    }
+}
+
+void initSupervisor() {
+    uint32_t now = millis();
+    for (int i = 0; i < SUB_COUNT; i++) {
+        subs[i].lastBeat = now;
+    }
+    xTaskCreatePinnedToCore(supervisorTask, "supervisor", SUPERVISOR_TASK_STACK_SIZE, nullptr,
+                            SUPERVISOR_TASK_PRIORITY, nullptr, SUPERVISOR_TASK_CORE);
+    LOG_I(SYS, "SUPERVISOR: Watching %d subsystems", SUB_COUNT);
+}
+
+void serviceSupervisor() {
+    supervisorBeat(SUB_LOOP);
+
+    uint32_t requests = __atomic_exchange_n(&recoveryRequests, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < SUB_COUNT; i++) {
+        if (requests & (1u << i)) {
+            LOG_W(SYS, "SUPERVISOR: Soft recovery of %s", limits[i].name);
+            limits[i].recover();
+        }
+    }
+}
+
+SubsystemHealth subsystemHealth(Subsystem sub) {
+    const SubsystemState& s = subs[sub];
+    uint32_t now = millis();
+    SubsystemHealth h;
+    h.name = limits[sub].name;
+    h.beatAgeMs = now - s.lastBeat;
+    h.callMs = s.callDepth > 0 ? now - s.callStart : 0;
+    h.recovering = s.recovering;
+    h.trips = s.trips;
+    h.recoveries = s.recoveries;
+    return h;
+}
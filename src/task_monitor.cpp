@@ -0,0 +1,167 @@
+#include "task_monitor.h"
+#include "config.h"
+#include "debug.h"
+
+#include <freertos/task.h>
+
+// Run-time counter of a task at the previous sample, matched by task number
+struct TaskRunTime {
+    UBaseType_t number;
+    uint32_t counter;
+};
+
+static TaskStatus_t statusBuf[TASK_MONITOR_MAX_TASKS];
+static TaskInfo tasks[TASK_MONITOR_MAX_TASKS];
+static size_t tasksCount = 0;
+
+static TaskRunTime lastRunTimes[TASK_MONITOR_MAX_TASKS];
+static size_t lastRunTimesCount = 0;
+static uint32_t lastTotalRunTime = 0;
+static uint16_t coreLoad[portNUM_PROCESSORS];
+
+static unsigned long lastSample = 0;
+static unsigned long sampleInterval = 0;
+static bool sampled = false;
+static bool overflowWarned = false;
+
+bool taskCpuStatsAvailable() {
+#if configGENERATE_RUN_TIME_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+static char stateChar(eTaskState state) {
+    switch (state) {
+        case eRunning: return 'R';
+        case eReady: return 'r';
+        case eBlocked: return 'B';
+        case eSuspended: return 'S';
+        case eDeleted: return 'D';
+        default: return '?';
+    }
+}
+
+#if configGENERATE_RUN_TIME_STATS
+static uint32_t previousRunTime(UBaseType_t number, bool& found) {
+    for (size_t i = 0; i < lastRunTimesCount; i++) {
+        if (lastRunTimes[i].number == number) {
+            found = true;
+            return lastRunTimes[i].counter;
+        }
+    }
+    found = false;
+    return 0;
+}
+#endif
+
+static void sampleTasks() {
+    uint32_t totalRunTime = 0;
+    UBaseType_t n = uxTaskGetSystemState(statusBuf, TASK_MONITOR_MAX_TASKS, &totalRunTime);
+    if (n == 0) {
+        if (!overflowWarned) {
+            overflowWarned = true;
+            LOG_W(SYS, "TASKS: More than %d tasks, raise TASK_MONITOR_MAX_TASKS", TASK_MONITOR_MAX_TASKS);
+        }
+        // Still a sample, so the next attempt waits a full interval; CPU shares
+        // start over from the next complete one
+        tasksCount = 0;
+        lastRunTimesCount = 0;
+        sampleInterval = millis() - lastSample;
+        sampled = true;
+        return;
+    }
+
+#if configGENERATE_RUN_TIME_STATS
+    // Counters are 32-bit microseconds and wrap after ~71 min; unsigned deltas stay correct
+    uint32_t elapsed = totalRunTime - lastTotalRunTime;
+    uint32_t idle[portNUM_PROCESSORS] = {0};
+    bool baseline = lastRunTimesCount > 0;    // Counters from the previous complete sample
+#endif
+
+    tasksCount = 0;
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t& s = statusBuf[i];
+        TaskInfo& t = tasks[tasksCount++];
+        strncpy(t.name, s.pcTaskName, sizeof(t.name) - 1);
+        t.name[sizeof(t.name) - 1] = '\0';
+        t.priority = s.uxCurrentPriority;
+        t.state = stateChar(s.eCurrentState);
+        t.stackFreeBytes = s.usStackHighWaterMark;    // Stack units are bytes on the ESP32
+#if configTASKLIST_INCLUDE_COREID
+        t.core = (s.xCoreID >= 0 && s.xCoreID < portNUM_PROCESSORS) ? s.xCoreID : -1;
+#else
+        t.core = -1;
+#endif
+        t.cpuPermille = 0;
+
+#if configGENERATE_RUN_TIME_STATS
+        bool found;
+        uint32_t previous = previousRunTime(s.xTaskNumber, found);
+        if (baseline && found && elapsed > 0) {
+            uint32_t delta = s.ulRunTimeCounter - previous;
+            t.cpuPermille = (uint16_t)((uint64_t)delta * 1000 / elapsed);
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                if (s.xHandle == xTaskGetIdleTaskHandleForCPU(core)) {
+                    idle[core] = delta;
+                }
+            }
+        }
+#endif
+    }
+
+#if configGENERATE_RUN_TIME_STATS
+    if (baseline && elapsed > 0) {
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            uint32_t idlePermille = (uint32_t)((uint64_t)idle[core] * 1000 / elapsed);
+            coreLoad[core] = idlePermille < 1000 ? 1000 - idlePermille : 0;
+        }
+    }
+
+    lastRunTimesCount = n;
+    for (UBaseType_t i = 0; i < n; i++) {
+        lastRunTimes[i].number = statusBuf[i].xTaskNumber;
+        lastRunTimes[i].counter = statusBuf[i].ulRunTimeCounter;
+    }
+    lastTotalRunTime = totalRunTime;
+#endif
+
+    // Busiest first
+    for (size_t i = 1; i < tasksCount; i++) {
+        TaskInfo t = tasks[i];
+        size_t j = i;
+        while (j > 0 && tasks[j - 1].cpuPermille < t.cpuPermille) {
+            tasks[j] = tasks[j - 1];
+            j--;
+        }
+        tasks[j] = t;
+    }
+
+    sampleInterval = millis() - lastSample;
+    sampled = true;
+}
+
+void serviceTaskMonitor() {
+    if (sampled && millis() - lastSample < TASK_SAMPLE_INTERVAL_MS) {
+        return;
+    }
+    sampleTasks();
+    lastSample = millis();
+}
+
+size_t taskCount() {
+    return tasksCount;
+}
+
+const TaskInfo& taskAt(size_t i) {
+    return tasks[i < tasksCount ? i : 0];
+}
+
+uint16_t coreLoadPermille(int core) {
+    return (core >= 0 && core < portNUM_PROCESSORS) ? coreLoad[core] : 0;
+}
+
+unsigned long taskSampleIntervalMs() {
+    return sampleInterval;
+}
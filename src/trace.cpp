@@ -0,0 +1,160 @@
+#include "trace.h"
+#include "config.h"
+
+#include <esp_timer.h>
+#include <string.h>
+
+// Everything here runs on the loop task (handlers, queue, status reads), so no locking
+
+// One recorded event - name must be a string with static storage
+struct TraceEvent {
+    int64_t ts;               // esp_timer microseconds
+    const char* name;
+    TraceId trace;
+    uint16_t asyncId;
+    char phase;               // 'B'/'E' on the request track, 'b'/'e' async
+};
+
+static TraceEvent events[TRACE_BUFFER_EVENTS];
+static size_t eventHead = 0;
+static size_t eventCount = 0;
+static TraceId nextTraceId = 1;
+static uint16_t nextAsyncId = 1;
+static TraceId currentTrace = TRACE_NONE;
+static bool currentClaimed = false;
+
+static void record(TraceId id, const char* name, char phase, uint16_t asyncId = 0) {
+    if (id == TRACE_NONE) return;
+
+    TraceEvent& e = events[eventHead];
+    e.ts = esp_timer_get_time();
+    e.name = name;
+    e.trace = id;
+    e.asyncId = asyncId;
+    e.phase = phase;
+    eventHead = (eventHead + 1) % TRACE_BUFFER_EVENTS;
+    if (eventCount < TRACE_BUFFER_EVENTS) eventCount++;
+}
+
+TraceId traceStart(const char* name) {
+    TraceId id = nextTraceId++;
+    if (nextTraceId == TRACE_NONE) nextTraceId = 1;
+    record(id, name, 'B');
+    currentTrace = id;
+    currentClaimed = false;
+    return id;
+}
+
+void traceFinish(TraceId id) {
+    record(id, nullptr, 'E');
+}
+
+TraceId traceCurrent() {
+    return currentTrace;
+}
+
+void traceSetCurrent(TraceId id) {
+    currentTrace = id;
+}
+
+TraceId traceClaimCurrent() {
+    currentClaimed = currentTrace != TRACE_NONE;
+    return currentTrace;
+}
+
+void traceBegin(TraceId id, const char* name) {
+    record(id, name, 'B');
+}
+
+void traceEnd(TraceId id, const char* name) {
+    record(id, name, 'E');
+}
+
+uint16_t traceAsyncBegin(TraceId id, const char* name) {
+    if (id == TRACE_NONE) return 0;
+    uint16_t asyncId = nextAsyncId++;
+    if (nextAsyncId == 0) nextAsyncId = 1;
+    record(id, name, 'b', asyncId);
+    return asyncId;
+}
+
+void traceAsyncEnd(TraceId id, uint16_t asyncId, const char* name) {
+    if (asyncId == 0) return;
+    record(id, name, 'e', asyncId);
+}
+
+TraceScope::TraceScope(const char* name) {
+    id = traceStart(name);
+    traceBegin(id, "handler");
+}
+
+TraceScope::~TraceScope() {
+    traceEnd(id, "handler");
+    // Nothing was queued on behalf of this request, so nothing else will finish it
+    if (!currentClaimed) {
+        traceFinish(id);
+    }
+    currentTrace = TRACE_NONE;
+    currentClaimed = false;
+}
+
+void traceClear() {
+    eventHead = 0;
+    eventCount = 0;
+}
+
+size_t traceEventCount() {
+    return eventCount;
+}
+
+// One event as a Chrome trace-event object, with a leading comma unless first
+static int formatEvent(char* out, size_t size, const TraceEvent& e, bool first) {
+    const char* sep = first ? "" : ",";
+    if (e.phase == 'b' || e.phase == 'e') {
+        return snprintf(out, size,
+                        "%s{\"name\":\"%s\",\"cat\":\"queue\",\"ph\":\"%c\",\"id\":%u,\"ts\":%lld,\"pid\":1,\"tid\":%u}",
+                        sep, e.name ? e.name : "", e.phase, e.asyncId, (long long)e.ts, e.trace);
+    } else if (e.name) {
+        return snprintf(out, size, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u}",
+                        sep, e.name, e.phase, (long long)e.ts, e.trace);
+    }
+    return snprintf(out, size, "%s{\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u}",
+                    sep, e.phase, (long long)e.ts, e.trace);
+}
+
+// Chrome trace-event format: one track (tid) per request, async waits keyed by id
+size_t traceExport(char* buf, size_t size) {
+    static const char head[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    static const char tail[] = "]}";
+    if (size < sizeof(head) + sizeof(tail) - 1) {
+        if (size > 0) buf[0] = '\0';
+        return 0;
+    }
+
+    // Room for the events, keeping the tail and terminator
+    size_t limit = size - sizeof(tail);
+    size_t len = sizeof(head) - 1;
+    memcpy(buf, head, len);
+
+    // Newest events that fit, measured first so the oldest are the ones left out
+    size_t count = eventCount;
+    size_t start = (eventHead + TRACE_BUFFER_EVENTS - eventCount) % TRACE_BUFFER_EVENTS;
+    size_t skip = count;
+    size_t needed = len;
+    while (skip > 0) {
+        const TraceEvent& e = events[(start + skip - 1) % TRACE_BUFFER_EVENTS];
+        int n = formatEvent(nullptr, 0, e, false);
+        if (n < 0 || needed + n > limit) break;
+        needed += n;
+        skip--;
+    }
+
+    for (size_t i = skip; i < count; i++) {
+        const TraceEvent& e = events[(start + i) % TRACE_BUFFER_EVENTS];
+        int n = formatEvent(buf + len, limit - len + 1, e, i == skip);
+        if (n < 0 || len + n > limit) break;
+        len += n;
+    }
+    memcpy(buf + len, tail, sizeof(tail));
+    return len + sizeof(tail) - 1;
+}
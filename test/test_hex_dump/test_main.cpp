@@ -0,0 +1,93 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hex_dump.h"
+
+// The native env links with --wrap=malloc etc. (like esp32-heaptrace), so
+// every allocation from this test and the code under test is counted here
+static size_t allocs = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    allocs++;
+    return __real_realloc(ptr, size);
+}
+}
+
+// operator new lives in the shared libstdc++, out of reach of --wrap
+void* operator new(size_t size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+// A status reply as it comes off the link
+static const uint8_t frame[] = {0xCC, 0xAA, 0x0D, 0x05, 0x00, 0x01, 0x02, 0x10, 0x00, 0x00, 0x0A, 0x20, 0x00, 0x01, 0x00, 0x7F};
+
+void setUp() {
+    allocs = 0;
+}
+
+void tearDown() {}
+
+static void test_counter_sees_allocations() {
+    void* p = malloc(16);
+    char* s = new char[8];
+    TEST_ASSERT_EQUAL_UINT32(2, allocs);
+    delete[] s;
+    free(p);
+}
+
+static void test_dump_format() {
+    char hex[HEX_DUMP_SIZE(4)];
+    TEST_ASSERT_EQUAL_STRING("CC AA 0D 05", bytesToHex(frame, 4, hex, sizeof(hex)));
+    TEST_ASSERT_EQUAL_STRING("", bytesToHex(frame, 0, hex, sizeof(hex)));
+}
+
+static void test_full_frame_fits_and_does_not_allocate() {
+    char hex[HEX_DUMP_SIZE(64)];
+    const char* dump = bytesToHex(frame, sizeof(frame), hex, sizeof(hex));
+    TEST_ASSERT_EQUAL_UINT32(0, allocs);
+    TEST_ASSERT_EQUAL_PTR(hex, dump);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(frame) * 3 - 1, strlen(dump));
+    TEST_ASSERT_EQUAL_STRING("00 7F", dump + strlen(dump) - 5);
+}
+
+// Cut off at whole bytes, never past the given size
+static void test_short_buffer_truncates() {
+    char hex[12];
+    memset(hex, 'x', sizeof(hex));
+    TEST_ASSERT_EQUAL_STRING("CC AA", bytesToHex(frame, sizeof(frame), hex, 8));
+    TEST_ASSERT_EQUAL_INT('x', hex[6]);
+    TEST_ASSERT_EQUAL_STRING("CC AA 0D", bytesToHex(frame, sizeof(frame), hex, 9));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_counter_sees_allocations);
+    RUN_TEST(test_dump_format);
+    RUN_TEST(test_full_frame_fits_and_does_not_allocate);
+    RUN_TEST(test_short_buffer_truncates);
+    return UNITY_END();
+}
@@ -0,0 +1,97 @@
+#include <unity.h>
+#include "idle_learner.h"
+
+// Same values as config.h
+static const IdleLearnerParams params = {1000, 3, 20};
+
+static IdleLearner learner;
+
+void setUp() {
+    idleLearnerReset(learner, 0);
+}
+
+void tearDown() {}
+
+static void addAll(const uint32_t* idleMs, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        idleLearnerAdd(learner, params, idleMs[i]);
+    }
+}
+
+// Idle poll every 15 s, soundbar drops after 10 s: the drops cluster below the poll interval
+static void test_timeout_shorter_than_poll_is_learned() {
+    TEST_ASSERT_FALSE(idleLearnerAdd(learner, params, 10200));
+    TEST_ASSERT_FALSE(idleLearnerAdd(learner, params, 10050));
+    TEST_ASSERT_TRUE(idleLearnerAdd(learner, params, 10400));
+    TEST_ASSERT_EQUAL_UINT32(10050, learner.thresholdMs);
+}
+
+// Active poll every 5 s, soundbar drops after 4 s: the keepalive has to beat the poll
+static void test_keepalive_fires_before_active_poll() {
+    const uint32_t drops[] = {4100, 4000, 4300};
+    addAll(drops, 3);
+    TEST_ASSERT_EQUAL_UINT32(4000, learner.thresholdMs);
+    uint32_t interval = idleKeepaliveInterval(learner.thresholdMs, 75, 2000);
+    TEST_ASSERT_EQUAL_UINT32(3000, interval);
+    TEST_ASSERT_TRUE(interval < 5000);
+}
+
+// RF drops land anywhere between two polls and never agree
+static void test_scattered_drops_are_not_learned() {
+    const uint32_t drops[] = {1200, 4700, 2600, 3900, 1700, 3300, 2100, 4300};
+    addAll(drops, 8);
+    TEST_ASSERT_EQUAL_UINT32(0, learner.thresholdMs);
+}
+
+// A chance group of three is not enough while it is a minority of the history
+static void test_minority_group_is_not_learned() {
+    const uint32_t drops[] = {1200, 4700, 2600, 3900, 1700, 3000, 3100, 3200};
+    addAll(drops, 8);
+    TEST_ASSERT_EQUAL_UINT32(0, learner.thresholdMs);
+}
+
+// Drops right after traffic say nothing about an idle timeout
+static void test_short_quiet_is_ignored() {
+    const uint32_t drops[] = {300, 350, 320, 310};
+    addAll(drops, 4);
+    TEST_ASSERT_EQUAL_UINT32(0, learner.count);
+    TEST_ASSERT_EQUAL_UINT32(0, learner.thresholdMs);
+}
+
+// Idle timeouts with occasional RF drops mixed in are still found
+static void test_timeout_among_rf_drops() {
+    const uint32_t drops[] = {2300, 8000, 8300, 1500, 8100};
+    addAll(drops, 5);
+    TEST_ASSERT_EQUAL_UINT32(8000, learner.thresholdMs);
+}
+
+// A threshold restored from NVS stays until the history says otherwise
+static void test_restored_threshold_kept_and_replaced() {
+    idleLearnerReset(learner, 30000);
+    TEST_ASSERT_FALSE(idleLearnerAdd(learner, params, 12000));
+    TEST_ASSERT_EQUAL_UINT32(30000, learner.thresholdMs);
+    idleLearnerAdd(learner, params, 12500);
+    TEST_ASSERT_TRUE(idleLearnerAdd(learner, params, 12100));
+    TEST_ASSERT_EQUAL_UINT32(12000, learner.thresholdMs);
+}
+
+static void test_interval_limits() {
+    TEST_ASSERT_EQUAL_UINT32(0, idleKeepaliveInterval(0, 75, 2000));
+    TEST_ASSERT_EQUAL_UINT32(7500, idleKeepaliveInterval(10000, 75, 2000));
+    // Floor applies, but never at or past the threshold itself
+    TEST_ASSERT_EQUAL_UINT32(2000, idleKeepaliveInterval(2500, 75, 2000));
+    TEST_ASSERT_EQUAL_UINT32(1350, idleKeepaliveInterval(1500, 75, 2000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_timeout_shorter_than_poll_is_learned);
+    RUN_TEST(test_keepalive_fires_before_active_poll);
+    RUN_TEST(test_scattered_drops_are_not_learned);
+    RUN_TEST(test_minority_group_is_not_learned);
+    RUN_TEST(test_short_quiet_is_ignored);
+    RUN_TEST(test_timeout_among_rf_drops);
+    RUN_TEST(test_restored_threshold_kept_and_replaced);
+    RUN_TEST(test_interval_limits);
+    return UNITY_END();
+}
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Simple HTTP load test for the YAS Bluetooth bridge.
+
+Opens N concurrent keep-alive connections and issues GET requests back to
+back for a fixed duration, then reports throughput and latency percentiles.
+Uses only the Python standard library.
+
+    python3 tools/http_load_test.py 192.168.1.50 -c 4 -d 10 --path /status
+"""
+
+import argparse
+import asyncio
+import time
+
+
+async def worker(host, port, path, api_key, deadline, latencies, errors):
+    request = f"GET {path} HTTP/1.1\r\nHost: {host}\r\nConnection: keep-alive\r\n"
+    if api_key:
+        request += f"Authorization: Bearer {api_key}\r\n"
+    request = (request + "\r\n").encode()
+
+    reader = writer = None
+    while time.monotonic() < deadline:
+        try:
+            if writer is None:
+                reader, writer = await asyncio.open_connection(host, port)
+
+            start = time.perf_counter()
+            writer.write(request)
+            await writer.drain()
+
+            status_line = await reader.readline()
+            if not status_line:
+                raise ConnectionError("connection closed")
+            status = int(status_line.split()[1])
+
+            length = 0
+            keep_alive = status_line.startswith(b"HTTP/1.1")
+            while True:
+                line = await reader.readline()
+                if line in (b"\r\n", b""):
+                    break
+                name, _, value = line.decode().partition(":")
+                name = name.strip().lower()
+                if name == "content-length":
+                    length = int(value)
+                elif name == "connection" and value.strip().lower() == "close":
+                    keep_alive = False
+            if length:
+                await reader.readexactly(length)
+
+            latencies.append(time.perf_counter() - start)
+            if status >= 400:
+                errors[status] = errors.get(status, 0) + 1
+            if not keep_alive:
+                writer.close()
+                writer = None
+        except (OSError, ConnectionError, asyncio.IncompleteReadError, ValueError, IndexError) as e:
+            errors[type(e).__name__] = errors.get(type(e).__name__, 0) + 1
+            if writer is not None:
+                writer.close()
+                writer = None
+            await asyncio.sleep(0.1)
+
+    if writer is not None:
+        writer.close()
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(round(p / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[index]
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="HTTP load test for the YAS Bluetooth bridge")
+    parser.add_argument("host", help="Bridge IP address or hostname")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/status", help="Request path (default: /status)")
+    parser.add_argument("-c", "--connections", type=int, default=4, help="Concurrent connections")
+    parser.add_argument("-d", "--duration", type=float, default=10.0, help="Test duration in seconds")
+    parser.add_argument("--api-key", help="API_KEY configured on the bridge")
+    args = parser.parse_args()
+
+    latencies = []
+    errors = {}
+    start = time.monotonic()
+    deadline = start + args.duration
+    await asyncio.gather(*(
+        worker(args.host, args.port, args.path, args.api_key, deadline, latencies, errors)
+        for _ in range(args.connections)
+    ))
+    elapsed = time.monotonic() - start
+
+    latencies.sort()
+    print(f"{len(latencies)} requests in {elapsed:.1f}s over {args.connections} connections")
+    print(f"  requests/s: {len(latencies) / elapsed:.1f}")
+    print(f"  latency p50: {percentile(latencies, 50) * 1000:.1f} ms")
+    print(f"  latency p99: {percentile(latencies, 99) * 1000:.1f} ms")
+    print(f"  latency max: {(latencies[-1] if latencies else 0) * 1000:.1f} ms")
+    if errors:
+        print("  errors: " + ", ".join(f"{k}={v}" for k, v in sorted(errors.items(), key=str)))
+
+
+if __name__ == "__main__":
+    asyncio.run(main())